@@ -0,0 +1,371 @@
+//
+// project_base_bench: microbenchmarks of the CPU side of loading and rendering, see rg::MicroBench.
+//
+// The CPU group (ASSIMP import and image decode of the shipped assets, the camera, and the culling
+// and sort kernels of the frame on a generated scene) runs without a GL context. The GL group (full
+// Model and TextureFromFile loads with the upload, Shader::set* uniform paths, clustered light
+// binning) gets a hidden window and is skipped when there is none or with --cpu-only.
+//
+// Run it from the repository root like project_base, the asset paths are relative:
+//   ./project_base_bench --out bench.json
+//   ./project_base_bench --baseline bench.json --threshold 10
+//
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <learnopengl/camera.h>
+#include <learnopengl/model.h>
+#include <learnopengl/shader.h>
+
+#include <rg/Bounds.h>
+#include <rg/ClusteredLights.h>
+#include <rg/Eclipse.h>
+#include <rg/GLExt.h>
+#include <rg/JobSystem.h>
+#include <rg/MicroBench.h>
+#include <rg/Primitives.h>
+#include <rg/SceneGenerator.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <vector>
+
+namespace {
+
+const char *const ModelFiles[] = {
+        "resources/objects/Earth/Earth_2K.obj",
+        "resources/objects/moon/moon.obj",
+        "resources/objects/sun/Earth_2K.obj",
+        "resources/objects/cosmic_dust/Cloud_Polygon_Blender_1.obj",
+};
+
+const char *const TextureFiles[] = {
+        "resources/objects/Earth/Diffuse_2K.png",
+        "resources/objects/Earth/Bump_2K.png",
+        "resources/objects/Earth/Night_lights_2K.png",
+        "resources/objects/sun/13913_Sun_diff.jpg",
+};
+
+// the scene the culling and sort kernels run on, about the size where they start to matter
+const char *const KernelScene = "seed=1,planets=64,moons=4,asteroids=8000,lights=0,clouds=0";
+
+bool fileExists(const std::string &path) {
+    return (bool) std::ifstream(path);
+}
+
+std::string baseName(const std::string &path) {
+    return path.substr(path.find_last_of('/') + 1);
+}
+
+// world bounds of the generated bodies at some point of their orbits, as the frame sees them
+struct KernelData {
+    std::vector<rg::BoundingSphere> bodies;
+    std::vector<rg::BoundingSphere> casters;
+    std::vector<int> casterIndex;
+    std::vector<glm::mat4> transforms;
+
+    explicit KernelData(rg::SceneGenerator &generator) {
+        generator.update(12.5f);
+        for (unsigned int i = 0; i < generator.bodies().size(); i++) {
+            transforms.push_back(generator.bodyTransform(i, 1.0f));
+            bodies.push_back(rg::transformSphere(rg::BoundingSphere{glm::vec3(0.0f), 1.0f}, transforms.back()));
+            bool caster = generator.bodies()[i].kind != rg::SceneGenerator::Asteroid;
+            casterIndex.push_back(caster ? (int) casters.size() : -1);
+            if (caster)
+                casters.push_back(bodies.back());
+        }
+    }
+};
+
+void addCpuBenchmarks(rg::MicroBench &bench) {
+    for (const char *path : ModelFiles) {
+        std::string name = std::string("assimp import/") + baseName(path);
+        if (!fileExists(path)) {
+            bench.skip(name, "missing file");
+            continue;
+        }
+        // the part of the Model constructor before any GL object is created
+        bench.add(name, [path](unsigned long long n) {
+            for (unsigned long long i = 0; i < n; i++) {
+                Assimp::Importer importer;
+                rg::doNotOptimize(importer.ReadFile(path, Model::ImportFlags));
+            }
+        });
+    }
+    for (const char *path : TextureFiles) {
+        std::string name = std::string("image decode/") + baseName(path);
+        if (!fileExists(path)) {
+            bench.skip(name, "missing file");
+            continue;
+        }
+        // the part of TextureFromFile before the upload
+        bench.add(name, [path](unsigned long long n) {
+            for (unsigned long long i = 0; i < n; i++) {
+                int width, height, components;
+                unsigned char *data = stbi_load(path, &width, &height, &components, 0);
+                rg::doNotOptimize(data);
+                stbi_image_free(data);
+            }
+        });
+    }
+
+    bench.add("camera/mouse movement", [](unsigned long long n) {
+        Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+        for (unsigned long long i = 0; i < n; i++)
+            camera.ProcessMouseMovement((i & 1) ? 3.0f : -3.0f, (i & 2) ? 1.0f : -1.0f);
+        rg::doNotOptimize(camera.Front);
+    });
+    bench.add("camera/view matrix", [](unsigned long long n) {
+        Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+        for (unsigned long long i = 0; i < n; i++) {
+            camera.Position.x = (float) (i & 15);
+            rg::doNotOptimize(camera.GetViewMatrix());
+        }
+    });
+
+    // shared by the kernels below, built once
+    static rg::SceneGenerator::Settings settings;
+    rg::SceneGenerator::Settings::parse(KernelScene, settings);
+    static rg::SceneGenerator generator(settings, glm::vec3(-28.0f, 11.5f, 75.0f));
+    static KernelData data(generator);
+    const glm::vec3 lightPos(-3.0f, 14.5f, 35.0f);
+    const glm::mat4 view = glm::lookAt(glm::vec3(0.5f, 17.0f, 18.0f), glm::vec3(0.5f, 15.5f, 3.0f),
+                                       glm::vec3(0.0f, 1.0f, 0.0f));
+
+    std::string count = std::to_string(data.bodies.size());
+    bench.add("scene/orbits " + count, [](unsigned long long n) {
+        for (unsigned long long i = 0; i < n; i++)
+            generator.update(0.01f * i);
+        generator.update(12.5f);
+    });
+    bench.add("cull/transform bounds " + count, [](unsigned long long n) {
+        std::vector<rg::BoundingSphere> bounds(data.transforms.size());
+        for (unsigned long long i = 0; i < n; i++) {
+            for (unsigned int j = 0; j < data.transforms.size(); j++)
+                bounds[j] = rg::transformSphere(rg::BoundingSphere{glm::vec3(0.0f), 1.0f}, data.transforms[j]);
+            rg::doNotOptimize(bounds[0]);
+        }
+    });
+    bench.add("cull/eclipse occluders " + count, [lightPos](unsigned long long n) {
+        for (unsigned long long i = 0; i < n; i++) {
+            for (unsigned int j = 0; j < data.bodies.size(); j++)
+                rg::doNotOptimize(rg::selectOccluders(data.bodies[j], data.casters, data.casterIndex[j], lightPos, 2.0f));
+        }
+    });
+    // the front-to-back order of the opaque objects in main.cpp, from the same unsorted order every time
+    bench.add("sort/front to back " + count, [view](unsigned long long n) {
+        std::vector<float> depth(data.transforms.size());
+        for (unsigned int j = 0; j < depth.size(); j++)
+            depth[j] = -(view * data.transforms[j][3]).z;
+        std::vector<unsigned int> order(depth.size());
+        for (unsigned long long i = 0; i < n; i++) {
+            std::iota(order.begin(), order.end(), 0u);
+            std::sort(order.begin(), order.end(), [&depth](unsigned int a, unsigned int b) { return depth[a] < depth[b]; });
+            rg::doNotOptimize(order[0]);
+        }
+    });
+    bench.add("lights/range 4096", [](unsigned long long n) {
+        for (unsigned long long i = 0; i < n; i++) {
+            float sum = 0.0f;
+            for (int j = 0; j < 4096; j++)
+                sum += rg::lightRange(glm::vec3(0.25f + (j & 7) * 0.1f, 0.5f, 1.0f), 1.0f, 2.0f, 20.0f);
+            rg::doNotOptimize(sum);
+        }
+    });
+}
+
+void addGLBenchmarks(rg::MicroBench &bench, bool haveGL) {
+    // objects created here are released right away, inside the timed batch; the release is cheap
+    // next to the load
+    for (const char *path : ModelFiles) {
+        std::string name = std::string("model load/") + baseName(path);
+        if (!fileExists(path)) {
+            bench.skip(name, "missing file", true);
+            continue;
+        }
+        bench.add(name, [path](unsigned long long n) {
+            for (unsigned long long i = 0; i < n; i++) {
+                Model model(path);
+                model.Release();
+            }
+        }, true);
+    }
+    for (const char *path : TextureFiles) {
+        std::string name = std::string("texture load/") + baseName(path);
+        if (!fileExists(path)) {
+            bench.skip(name, "missing file", true);
+            continue;
+        }
+        std::string file = baseName(path);
+        std::string directory = std::string(path).substr(0, std::string(path).size() - file.size() - 1);
+        bench.add(name, [file, directory](unsigned long long n) {
+            for (unsigned long long i = 0; i < n; i++) {
+                unsigned int texture = TextureFromFile(file.c_str(), directory);
+                glDeleteTextures(1, &texture);
+            }
+        }, true);
+    }
+    bench.add("mesh/sphere 24x48", [](unsigned long long n) {
+        for (unsigned long long i = 0; i < n; i++) {
+            Mesh mesh = rg::makeSphereMesh(24, 48);
+            mesh.Release();
+        }
+    }, true);
+
+    // the uniform paths of the frame: Shader::set* looks the location up by name on every call
+    static Shader *shader = NULL;
+    if (haveGL && shader == NULL)
+        shader = new Shader("resources/shaders/earth.vs", "resources/shaders/earth.fs");
+    bench.add("shader/setMat4", [](unsigned long long n) {
+        shader->use();
+        glm::mat4 transform(1.0f);
+        for (unsigned long long i = 0; i < n; i++)
+            shader->setMat4("view", transform);
+    }, true);
+    bench.add("shader/setMat4 cached location", [](unsigned long long n) {
+        shader->use();
+        glm::mat4 transform(1.0f);
+        GLint location = glGetUniformLocation(shader->ID, "view");
+        for (unsigned long long i = 0; i < n; i++)
+            glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(transform));
+    }, true);
+    bench.add("shader/setVec3 struct member", [](unsigned long long n) {
+        shader->use();
+        for (unsigned long long i = 0; i < n; i++)
+            shader->setVec3("pointLight.position", glm::vec3(1.0f, 2.0f, 3.0f));
+    }, true);
+    bench.add("shader/setFloat", [](unsigned long long n) {
+        shader->use();
+        for (unsigned long long i = 0; i < n; i++)
+            shader->setFloat("material.shininess", 32.0f);
+    }, true);
+    bench.add("shader/setInt", [](unsigned long long n) {
+        shader->use();
+        for (unsigned long long i = 0; i < n; i++)
+            shader->setInt("occluderCount", 0);
+    }, true);
+
+    static rg::JobSystem *jobs = NULL;
+    static rg::ClusteredLights *clusters = NULL;
+    static std::vector<rg::ClusterLight> lights;
+    if (haveGL && clusters == NULL) {
+        jobs = new rg::JobSystem();
+        clusters = new rg::ClusteredLights(*jobs);
+        for (int i = 0; i < 4096; i++) {
+            float angle = 0.01f * i;
+            lights.push_back({glm::vec3(0.5f + 4.0f * std::cos(angle), 15.5f + 0.002f * i, 3.0f + 4.0f * std::sin(angle)),
+                              glm::vec3(1.0f), 1.0f, 2.0f, 20.0f});
+        }
+    }
+    bench.add("lights/cluster binning 4096", [](unsigned long long n) {
+        glm::mat4 view = glm::lookAt(glm::vec3(0.5f, 17.0f, 18.0f), glm::vec3(0.5f, 15.5f, 3.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 150.0f);
+        for (unsigned long long i = 0; i < n; i++)
+            clusters->update(lights, view, projection, 0.1f, 150.0f);
+        glFinish();
+    }, true);
+}
+
+}
+
+int main(int argc, char **argv) {
+    // --out <file> writes the results as JSON
+    // --baseline <file> compares with an earlier --out, exits with 1 on a regression
+    // --threshold <percent> slowdown that counts as a regression (default 10)
+    // --filter <text> runs only the benchmarks whose name contains it
+    // --batch-ms <ms> and --repeats <n> change how long each benchmark is timed
+    // --cpu-only doesn't create a GL context
+    std::string out;
+    std::string baseline;
+    double threshold = 10.0;
+    bool cpuOnly = false;
+    rg::MicroBench bench;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+            out = argv[++i];
+        else if (std::strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+            baseline = argv[++i];
+        else if (std::strcmp(argv[i], "--threshold") == 0 && i + 1 < argc)
+            threshold = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+            bench.settings.filter = argv[++i];
+        else if (std::strcmp(argv[i], "--batch-ms") == 0 && i + 1 < argc)
+            bench.settings.batchMs = std::max(std::atof(argv[++i]), 1.0);
+        else if (std::strcmp(argv[i], "--repeats") == 0 && i + 1 < argc)
+            bench.settings.repeats = std::max(std::atoi(argv[++i]), 1);
+        else if (std::strcmp(argv[i], "--cpu-only") == 0)
+            cpuOnly = true;
+        else {
+            std::cout << "Unknown argument " << argv[i] << '\n';
+            return 2;
+        }
+    }
+
+    // same as the program, so decode does the same work
+    stbi_set_flip_vertically_on_load(true);
+
+    GLFWwindow *window = NULL;
+    if (!cpuOnly && glfwInit()) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        window = glfwCreateWindow(64, 64, "project_base_bench", NULL, NULL);
+        if (window != NULL) {
+            glfwMakeContextCurrent(window);
+            if (gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) {
+                rg::loadGLExt((GLADloadproc) glfwGetProcAddress);
+                glfwSwapInterval(0);
+            } else {
+                glfwDestroyWindow(window);
+                window = NULL;
+            }
+        }
+    }
+    bool haveGL = window != NULL;
+    bench.addContext("gl_renderer", haveGL ? (const char *) glGetString(GL_RENDERER) : "none");
+    bench.addContext("build", __DATE__ " " __TIME__);
+#ifdef NDEBUG
+    bench.addContext("assertions", "off");
+#else
+    bench.addContext("assertions", "on");
+#endif
+
+    addCpuBenchmarks(bench);
+    addGLBenchmarks(bench, haveGL);
+    bench.run(haveGL);
+
+    int status = 0;
+    if (!out.empty()) {
+        if (bench.writeJson(out))
+            std::cout << "Results in " << out << '\n';
+        else {
+            std::cout << "Failed to write " << out << '\n';
+            status = 2;
+        }
+    }
+    if (!baseline.empty()) {
+        int regressions = bench.compare(baseline, threshold);
+        if (regressions < 0) {
+            std::cout << "Failed to read baseline " << baseline << '\n';
+            status = 2;
+        } else if (regressions > 0) {
+            std::cout << regressions << " regression(s) over " << threshold << "%\n";
+            status = status == 0 ? 1 : status;
+        }
+    }
+    if (haveGL)
+        glfwTerminate();
+    return status;
+}
@@ -112,6 +112,22 @@ public:
             Zoom = 45.0f; 
     }
 
+    // places the camera at position looking at target, for scripted camera paths
+    void LookAt(glm::vec3 position, glm::vec3 target)
+    {
+        Position = position;
+        glm::vec3 direction = glm::normalize(target - position);
+        SetOrientation(glm::degrees(atan2(direction.z, direction.x)), glm::degrees(asin(direction.y)));
+    }
+
+    // sets the Euler angles directly, e.g. when replaying a recorded camera
+    void SetOrientation(float yaw, float pitch)
+    {
+        Yaw = yaw;
+        Pitch = pitch;
+        updateCameraVectors();
+    }
+
 private:
     // calculates the front vector from the Camera's (updated) Euler Angles
     void updateCameraVectors()
@@ -7,6 +7,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <learnopengl/shader.h>
+#include <rg/DrawStats.h>
 
 #include <string>
 #include <vector>
@@ -41,16 +42,20 @@ public:
     vector<Texture>      textures;
 
     unsigned int VAO;
+    // positions only, for depth-only passes
+    unsigned int depthVAO;
     std::string glslIdentifierPrefix;
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    // constructor; without upload the mesh only keeps its data, for the software renderer
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, bool upload = true)
     {
         this->vertices = vertices;
         this->indices = indices;
         this->textures = textures;
+        VAO = depthVAO = VBO = EBO = depthVBO = 0;
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        if (upload)
+            setupMesh();
     }
 
     // render the mesh
@@ -88,14 +93,35 @@ public:
         glBindVertexArray(VAO);
         glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
         glBindVertexArray(0);
+        rg::countDraw(indices.size() / 3);
 
         // always good practice to set everything back to defaults once configured.
         glActiveTexture(GL_TEXTURE0);
     }
 
+    // render the mesh into the depth buffer only, no textures are bound
+    void DrawDepth()
+    {
+        glBindVertexArray(depthVAO);
+        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+        glBindVertexArray(0);
+        rg::countDraw(indices.size() / 3);
+    }
+
+    // deletes the vertex arrays and buffers, the textures belong to the model
+    void Release()
+    {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteVertexArrays(1, &depthVAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+        glDeleteBuffers(1, &depthVBO);
+        VAO = depthVAO = VBO = EBO = depthVBO = 0;
+    }
+
 private:
     // render data
-    unsigned int VBO, EBO;
+    unsigned int VBO, EBO, depthVBO;
 
     // initializes all the buffer objects/arrays
     void setupMesh()
@@ -134,6 +160,23 @@ private:
         glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
 
         glBindVertexArray(0);
+
+        // tightly packed positions sharing the same index buffer, so a depth-only pass
+        // doesn't pull the whole 56 byte vertex through the vertex fetch
+        vector<glm::vec3> positions(vertices.size());
+        for (unsigned int i = 0; i < vertices.size(); i++)
+            positions[i] = vertices[i].Position;
+        glGenVertexArrays(1, &depthVAO);
+        glGenBuffers(1, &depthVBO);
+
+        glBindVertexArray(depthVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, depthVBO);
+        glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), positions.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+
+        glBindVertexArray(0);
     }
 };
 #endif
\ No newline at end of file
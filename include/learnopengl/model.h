@@ -12,6 +12,8 @@
 
 #include <learnopengl/mesh.h>
 #include <learnopengl/shader.h>
+#include <rg/AssetLog.h>
+#include <rg/CpuProfiler.h>
 
 #include <string>
 #include <fstream>
@@ -33,20 +35,50 @@ public:
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    // false when the model was loaded without a GL context, its meshes and textures have no GL objects
+    bool uploaded;
+
+    // the ASSIMP post-processing every model goes through
+    static const unsigned int ImportFlags = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
 
     // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    Model(string const &path, bool gamma = false, bool upload = true) : gammaCorrection(gamma), uploaded(upload)
     {
+        CPU_ZONE("Model load");
+        rg::AssetLoadScope asset("model", path);
         loadModel(path);
     }
 
+    // constructor for geometry that is generated in code instead of loaded from a file
+    explicit Model(const vector<Mesh> &meshes) : meshes(meshes), gammaCorrection(false), uploaded(true)
+    {
+    }
+
     // draws the model, and thus all its meshes
     void Draw(Shader &shader)
     {
+        CPU_ZONE("Model::Draw");
         for(unsigned int i = 0; i < meshes.size(); i++)
             meshes[i].Draw(shader);
     }
 
+    // draws all meshes into the depth buffer only, with whatever depth shader is in use
+    void DrawDepth()
+    {
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].DrawDepth();
+    }
+
+    // deletes the GL objects of all meshes and the loaded textures; the model can't be drawn anymore
+    void Release()
+    {
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].Release();
+        for(unsigned int i = 0; i < textures_loaded.size(); i++)
+            glDeleteTextures(1, &textures_loaded[i].id);
+        textures_loaded.clear();
+    }
+
     void SetShaderTextureNamePrefix(std::string prefix) {
         for (Mesh& mesh: meshes) {
             mesh.glslIdentifierPrefix = prefix;
@@ -58,7 +90,7 @@ private:
     {
         // read file via ASSIMP
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        const aiScene* scene = importer.ReadFile(path, ImportFlags);
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
@@ -179,7 +211,7 @@ private:
 
 
         // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        return Mesh(vertices, indices, textures, uploaded);
     }
 
     // checks all material textures of a given type and loads the textures if they're not loaded yet.
@@ -205,7 +237,7 @@ private:
             if(!skip)
             {   // if texture hasn't been loaded already, load it
                 Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
+                texture.id = uploaded ? TextureFromFile(str.C_Str(), this->directory) : 0;
                 texture.type = typeName;
                 texture.path = str.C_Str();
                 textures.push_back(texture);
@@ -221,6 +253,7 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
 {
     string filename = string(path);
     filename = directory + '/' + filename;
+    rg::AssetLoadScope asset("texture", filename);
 
     unsigned int textureID;
     glGenTextures(1, &textureID);
@@ -9,6 +9,8 @@
 #include <sstream>
 #include <iostream>
 #include <common.h>
+#include <rg/AssetLog.h>
+#include <rg/CpuProfiler.h>
 class Shader
 {
 public:
@@ -17,8 +19,11 @@ public:
     // ------------------------------------------------------------------------
     Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
     {
+        CPU_ZONE("Shader compile");
+        rg::AssetLoadScope asset("shader", std::string(vertexPath) + " " + fragmentPath);
         std::string vertexPathString(vertexPath);
         std::string fragmentPathString(fragmentPath);
+        std::string geometryPathString(geometryPath != nullptr ? geometryPath : "");
 
         vertexPath = vertexPathString.c_str();
         fragmentPath= fragmentPathString.c_str();
@@ -51,7 +56,6 @@ public:
             // if geometry shader path is present, also load a geometry shader
             if(geometryPath != nullptr)
             {
-                std::string geometryPathString(geometryPath);
                 geometryPath = geometryPathString.c_str();
                 gShaderFile.open(geometryPath);
                 std::stringstream gShaderStream;
@@ -64,6 +68,10 @@ public:
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
         }
+        vertexCode = resolveIncludes(vertexCode, vertexPath);
+        fragmentCode = resolveIncludes(fragmentCode, fragmentPath);
+        if(geometryPath != nullptr)
+            geometryCode = resolveIncludes(geometryCode, geometryPath);
         const char* vShaderCode = vertexCode.c_str();
         const char * fShaderCode = fragmentCode.c_str();
         // 2. compile shaders
@@ -169,6 +177,35 @@ public:
     }
 
 private:
+    // replaces every '#include "file"' line with the contents of file, relative to the
+    // directory of the including shader; included files may include further files
+    // ------------------------------------------------------------------------
+    static std::string resolveIncludes(const std::string &code, const std::string &path, int depth = 0)
+    {
+        std::string directory = path.substr(0, path.find_last_of('/') + 1);
+        std::stringstream in(code);
+        std::string result, line;
+        while (std::getline(in, line))
+        {
+            size_t directive = line.find("#include");
+            size_t open = line.find('"');
+            size_t close = line.rfind('"');
+            if (directive != std::string::npos && open != std::string::npos && close > open && depth < 8)
+            {
+                std::string includePath = directory + line.substr(open + 1, close - open - 1);
+                std::ifstream includeFile(includePath);
+                if (!includeFile)
+                    std::cout << "ERROR::SHADER::INCLUDE_NOT_FOUND " << includePath << std::endl;
+                std::stringstream includeStream;
+                includeStream << includeFile.rdbuf();
+                result += resolveIncludes(includeStream.str(), includePath, depth + 1) + "\n";
+            }
+            else
+                result += line + "\n";
+        }
+        return result;
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
@@ -0,0 +1,92 @@
+//
+// Log of the last assets that were loaded (models, textures, shaders), with how long each took.
+// AssetLoadScope adds an entry when it goes out of scope. Kept for the flight recorder, so a hitch
+// dump shows whether something was loaded around the slow frame, and summed up per kind for the
+// benchmark report.
+//
+
+#ifndef PROJECT_BASE_ASSETLOG_H
+#define PROJECT_BASE_ASSETLOG_H
+
+#include <chrono>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+namespace rg {
+
+class AssetLog {
+public:
+    static const unsigned int MaxEvents = 64;
+
+    struct Event {
+        std::string kind;
+        std::string path;
+        double ms;
+        // seconds since the first logged load
+        double time;
+    };
+
+    struct Totals {
+        unsigned int count = 0;
+        double ms = 0.0;
+    };
+
+    static AssetLog &instance() {
+        static AssetLog log;
+        return log;
+    }
+
+    void add(const std::string &kind, const std::string &path, double ms) {
+        double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_Start).count();
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (m_Events.size() == MaxEvents)
+            m_Events.pop_front();
+        m_Events.push_back({kind, path, ms, time});
+        m_Total++;
+        m_Totals[kind].count++;
+        m_Totals[kind].ms += ms;
+    }
+
+    // every load since the start, by kind
+    std::map<std::string, Totals> totals() {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_Totals;
+    }
+
+    void write(std::ostream &out) {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        out << "# asset loads: " << m_Total << " total, last " << m_Events.size() << "\n";
+        for (const Event &event : m_Events)
+            out << event.time << " s " << event.kind << " " << event.path << " " << event.ms << " ms\n";
+    }
+
+private:
+    std::mutex m_Mutex;
+    std::deque<Event> m_Events;
+    unsigned long long m_Total = 0;
+    std::map<std::string, Totals> m_Totals;
+    std::chrono::steady_clock::time_point m_Start = std::chrono::steady_clock::now();
+};
+
+class AssetLoadScope {
+public:
+    AssetLoadScope(const char *kind, const std::string &path)
+            : m_Kind(kind), m_Path(path), m_Start(std::chrono::steady_clock::now()) {}
+
+    ~AssetLoadScope() {
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_Start).count();
+        AssetLog::instance().add(m_Kind, m_Path, ms);
+    }
+
+private:
+    const char *m_Kind;
+    std::string m_Path;
+    std::chrono::steady_clock::time_point m_Start;
+};
+
+}
+
+#endif //PROJECT_BASE_ASSETLOG_H
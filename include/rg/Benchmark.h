@@ -0,0 +1,290 @@
+//
+// Headless benchmark run (--bench): a fixed number of frames rendered offscreen at a fixed size,
+// with the scene animated by a simulation clock that advances 1 / FramesPerSecond per frame
+// instead of the wall clock, and the camera flown along a looping scripted path. Every run renders
+// exactly the same frames, however fast the machine is, so runs can be compared.
+//
+// The first warmupFrames frames (shader compilation in the driver, first use of the textures)
+// aren't measured. The report is JSON with percentiles of the CPU frame time, of the CPU submit
+// time (the frame without the swap) and of the GPU time of the scene, draw call and triangle
+// counts, memory use at the end and the asset load times of the startup.
+//
+// --camera-path <file> replaces the scripted path, one key per line, '#' starts a comment:
+//   key <time> <camera x y z> <target x y z>
+// The times start at 0 and grow, and the path loops back to its first key after the last one. A
+// path that doesn't end on its first key gets it appended, as long after the last key as the last
+// key is after the one before, so the curve runs smoothly through the closing segment too.
+//
+
+#ifndef PROJECT_BASE_BENCHMARK_H
+#define PROJECT_BASE_BENCHMARK_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/camera.h>
+#include <rg/AssetLog.h>
+#include <rg/MemoryStats.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+class Benchmark {
+public:
+    static constexpr double FramesPerSecond = 60.0;
+
+    struct Settings {
+        int frames = 600;
+        int warmupFrames = 60;
+        int width = 1280;
+        int height = 720;
+        // the workload on top of the base scene; the volumes and lights themselves are seeded
+        int clusteredLights = 512;
+        int translucentVolumes = 16;
+    };
+
+    // a point of the camera path, seconds into the loop
+    struct CameraKey {
+        float time;
+        glm::vec3 position;
+        glm::vec3 target;
+    };
+
+    Settings settings;
+
+    explicit Benchmark(const Settings &settings) : settings(settings), m_Path(defaultPath()) {
+        m_CpuMs.reserve(settings.frames);
+        m_SubmitMs.reserve(settings.frames);
+        m_DrawCalls.reserve(settings.frames);
+        m_Triangles.reserve(settings.frames);
+    }
+
+    // simulation time of the current frame in seconds
+    double time() const { return frameTime(m_Frame); }
+    static double frameTime(long long frame) { return frame / FramesPerSecond; }
+    float deltaTime() const { return (float) (1.0 / FramesPerSecond); }
+    bool measuring() const { return m_Frame >= settings.warmupFrames; }
+    bool finished() const { return m_Frame >= settings.warmupFrames + settings.frames; }
+
+    void placeCamera(Camera &camera) const { placeCamera(camera, time()); }
+
+    // Catmull-Rom through the keys; the last key repeats the first, which closes the loop, so the
+    // neighbours of the end segments are taken from the keys without it
+    void placeCamera(Camera &camera, double time) const {
+        float loop = m_Path.back().time;
+        float t = std::fmod((float) time, loop);
+        unsigned int count = m_Path.size() - 1;
+        unsigned int i = 0;
+        while (i + 1 < count && m_Path[i + 1].time <= t)
+            i++;
+        float s = (t - m_Path[i].time) / (m_Path[i + 1].time - m_Path[i].time);
+        const CameraKey &k0 = m_Path[(i + count - 1) % count], &k1 = m_Path[i], &k2 = m_Path[i + 1],
+                &k3 = m_Path[(i + 2) % count];
+        camera.LookAt(catmullRom(k0.position, k1.position, k2.position, k3.position, s),
+                      catmullRom(k0.target, k1.target, k2.target, k3.target, s));
+    }
+
+    // gpuMs is the latest scene GPU time, fresh when it is a new result
+    void endFrame(double cpuMs, double submitMs, double gpuMs, bool fresh, unsigned int drawCalls,
+                  unsigned long long triangles) {
+        if (measuring()) {
+            m_CpuMs.push_back(cpuMs);
+            m_SubmitMs.push_back(submitMs);
+            if (fresh)
+                m_GpuMs.push_back(gpuMs);
+            m_DrawCalls.push_back(drawCalls);
+            m_Triangles.push_back((double) triangles);
+            m_MeasuredMs += cpuMs;
+        }
+        m_Frame++;
+    }
+
+    // false, keeping the current path, when the file can't be read or isn't a path
+    bool loadPath(const std::string &path) {
+        std::ifstream in(path);
+        if (!in) {
+            std::cout << "Failed to read camera path " << path << '\n';
+            return false;
+        }
+        std::vector<CameraKey> keys;
+        std::string line;
+        for (int number = 1; std::getline(in, line); number++) {
+            line = line.substr(0, line.find('#'));
+            std::istringstream fields(line);
+            std::string keyword;
+            if (!(fields >> keyword))
+                continue;
+            CameraKey key;
+            if (keyword != "key"
+                || !(fields >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.target.x
+                     >> key.target.y >> key.target.z)
+                || (keys.empty() ? key.time != 0.0f : key.time <= keys.back().time)) {
+                std::cout << path << ":" << number << ": can't read \"" << line << "\"\n";
+                return false;
+            }
+            keys.push_back(key);
+        }
+        if (keys.size() < 2) {
+            std::cout << path << ": a camera path needs at least two keys\n";
+            return false;
+        }
+        const CameraKey &first = keys.front(), &last = keys.back();
+        if (last.position != first.position || last.target != first.target) {
+            CameraKey closing = first;
+            closing.time = last.time + (last.time - keys[keys.size() - 2].time);
+            keys.push_back(closing);
+        }
+        m_Path = keys;
+        return true;
+    }
+
+    // in the format loadPath reads, with enough digits to read back the same floats
+    void writePath(std::ostream &out) const {
+        std::streamsize precision = out.precision(9);
+        for (const CameraKey &key : m_Path)
+            out << "key " << key.time << ' ' << key.position.x << ' ' << key.position.y << ' ' << key.position.z << ' '
+                << key.target.x << ' ' << key.target.y << ' ' << key.target.z << '\n';
+        out.precision(precision);
+    }
+
+    // shows up under "info" in the report
+    void addInfo(const std::string &key, const std::string &value) { m_Info[key] = value; }
+
+    // false when the file can't be written; needs the context for the memory use
+    bool writeReport(const std::string &path, double startupMs) const {
+        std::ofstream out(path);
+        if (!out)
+            return false;
+        out << "{\n";
+        out << "  \"frames\": " << m_CpuMs.size() << ",\n";
+        out << "  \"warmup_frames\": " << settings.warmupFrames << ",\n";
+        out << "  \"width\": " << settings.width << ",\n";
+        out << "  \"height\": " << settings.height << ",\n";
+        out << "  \"simulated_fps\": " << FramesPerSecond << ",\n";
+        out << "  \"clustered_lights\": " << settings.clusteredLights << ",\n";
+        out << "  \"translucent_volumes\": " << settings.translucentVolumes << ",\n";
+        out << "  \"info\": {";
+        bool first = true;
+        for (const auto &info : m_Info) {
+            out << (first ? "\n" : ",\n") << "    ";
+            writeString(out, info.first);
+            out << ": ";
+            writeString(out, info.second);
+            first = false;
+        }
+        out << "\n  },\n";
+        out << "  \"measured_ms\": " << m_MeasuredMs << ",\n";
+        out << "  \"average_fps\": " << (m_MeasuredMs > 0.0 ? 1000.0 * m_CpuMs.size() / m_MeasuredMs : 0.0) << ",\n";
+        out << "  \"cpu_frame_ms\": ";
+        writeDistribution(out, m_CpuMs);
+        out << ",\n  \"cpu_submit_ms\": ";
+        writeDistribution(out, m_SubmitMs);
+        out << ",\n  \"gpu_scene_ms\": ";
+        writeDistribution(out, m_GpuMs);
+        out << ",\n  \"draw_calls\": ";
+        writeDistribution(out, m_DrawCalls);
+        out << ",\n  \"triangles\": ";
+        writeDistribution(out, m_Triangles);
+        out << ",\n  \"memory\": {\"resident_mb\": ";
+        writeMegabytes(out, residentBytes());
+        out << ", \"gpu_used_mb\": ";
+        writeMegabytes(out, gpuMemoryUsedBytes());
+        out << '}';
+        out << ",\n  \"load\": {\n    \"startup_ms\": " << startupMs;
+        for (const auto &kind : AssetLog::instance().totals()) {
+            out << ",\n    ";
+            writeString(out, kind.first);
+            out << ": {\"count\": " << kind.second.count << ", \"ms\": " << kind.second.ms << '}';
+        }
+        out << "\n  }\n}\n";
+        return (bool) out;
+    }
+
+    // nearest rank, p in [0, 100]
+    static double percentile(std::vector<double> sorted, double p) {
+        if (sorted.empty())
+            return 0.0;
+        std::sort(sorted.begin(), sorted.end());
+        int rank = (int) std::ceil(p / 100.0 * sorted.size());
+        return sorted[std::min(std::max(rank - 1, 0), (int) sorted.size() - 1)];
+    }
+
+    double cpuPercentile(double p) const { return percentile(m_CpuMs, p); }
+    double submitPercentile(double p) const { return percentile(m_SubmitMs, p); }
+    double gpuPercentile(double p) const { return percentile(m_GpuMs, p); }
+
+private:
+    std::vector<CameraKey> m_Path;
+    int m_Frame = 0;
+    std::vector<double> m_CpuMs;
+    std::vector<double> m_SubmitMs;
+    std::vector<double> m_GpuMs;
+    std::vector<double> m_DrawCalls;
+    std::vector<double> m_Triangles;
+    double m_MeasuredMs = 0.0;
+    std::map<std::string, std::string> m_Info;
+
+    // around the earth past the cosmic dust and the moon's orbit, then out towards the sun and back;
+    // the last key repeats the first one
+    static std::vector<CameraKey> defaultPath() {
+        const glm::vec3 earth(0.5f, 15.5f, 3.0f);
+        const glm::vec3 sun(-28.0f, 11.5f, 75.0f);
+        return {
+                {0.0f, glm::vec3(0.5f, 17.0f, 18.0f), earth},
+                {2.0f, glm::vec3(14.0f, 20.0f, 8.0f), earth},
+                {4.0f, glm::vec3(10.0f, 16.0f, -12.0f), earth},
+                {6.0f, glm::vec3(-12.0f, 15.0f, 0.0f), earth},
+                {8.0f, glm::vec3(-6.0f, 14.0f, 30.0f), sun},
+                {10.0f, glm::vec3(0.5f, 17.0f, 18.0f), earth},
+        };
+    }
+
+    static glm::vec3 catmullRom(const glm::vec3 &p0, const glm::vec3 &p1, const glm::vec3 &p2, const glm::vec3 &p3,
+                                float t) {
+        float t2 = t * t, t3 = t2 * t;
+        return 0.5f * (2.0f * p1 + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2
+                       + (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+    }
+
+    static void writeDistribution(std::ostream &out, const std::vector<double> &values) {
+        double sum = 0.0, minimum = 0.0, maximum = 0.0;
+        for (unsigned int i = 0; i < values.size(); i++) {
+            sum += values[i];
+            minimum = i == 0 ? values[i] : std::min(minimum, values[i]);
+            maximum = std::max(maximum, values[i]);
+        }
+        out << "{\"samples\": " << values.size() << ", \"mean\": " << (values.empty() ? 0.0 : sum / values.size())
+            << ", \"min\": " << minimum << ", \"p50\": " << percentile(values, 50) << ", \"p90\": "
+            << percentile(values, 90) << ", \"p95\": " << percentile(values, 95) << ", \"p99\": "
+            << percentile(values, 99) << ", \"max\": " << maximum << '}';
+    }
+
+    // null when unknown
+    static void writeMegabytes(std::ostream &out, long long bytes) {
+        if (bytes < 0)
+            out << "null";
+        else
+            out << bytes / (1024.0 * 1024.0);
+    }
+
+    static void writeString(std::ostream &out, const std::string &text) {
+        out << '"';
+        for (char c : text) {
+            if (c == '"' || c == '\\')
+                out << '\\';
+            out << c;
+        }
+        out << '"';
+    }
+};
+
+}
+
+#endif //PROJECT_BASE_BENCHMARK_H
@@ -0,0 +1,134 @@
+//
+// Bloom of the HDR scene with the dual filter (dual Kawase) chain: the bright parts of the scene
+// are downsampled through LevelCount levels, each half the size of the previous one, and blurred
+// back up to the size of the first level.
+//
+// The first level has a fixed height, independent of the window, so the whole chain costs the
+// same at any resolution. Only its pass reads the full resolution scene, with taps spread over
+// the footprint of one output texel.
+//
+// The levels are transient frame graph textures. Every upsample output has the size of a
+// downsample level that is no longer needed by then, so the up chain reuses their textures.
+//
+
+#ifndef PROJECT_BASE_BLOOM_H
+#define PROJECT_BASE_BLOOM_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+#include <rg/FrameGraph.h>
+#include <rg/GpuTimer.h>
+#include <rg/RenderTarget.h>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+namespace rg {
+
+class Bloom {
+public:
+    static const int LevelCount = 5;
+    // height of the first level; windows lower than twice this start at half resolution
+    static const int BaseHeight = 360;
+    // LevelCount down passes followed by LevelCount - 1 up passes
+    static const int PassCount = 2 * LevelCount - 1;
+
+    struct PassStats {
+        std::string name;
+        int width;
+        int height;
+        double gpuMs;
+    };
+
+    Bloom()
+            : m_Downsample("resources/shaders/fullscreen.vs", "resources/shaders/bloom_downsample.fs"),
+              m_Upsample("resources/shaders/fullscreen.vs", "resources/shaders/bloom_upsample.fs") {
+    }
+
+    // threshold is the scene brightness where bloom starts, knee the width of the soft transition
+    void setThreshold(float threshold, float knee) {
+        m_Threshold = threshold;
+        m_Knee = knee;
+    }
+
+    // declares the chain reading sceneColor, returns the blurred bright part at the first level's size
+    FrameGraph::Resource addPasses(FrameGraph &graph, FrameGraph::Resource sceneColor) {
+        const FrameGraph::TextureDesc &scene = graph.desc(sceneColor);
+        int levelHeight = std::max(std::min(BaseHeight, scene.height / 2), 1);
+        int levelWidth = std::max((int) std::lround((double) scene.width * levelHeight / scene.height), 1);
+        FrameGraph::Resource down[LevelCount];
+        for (int i = 0; i < LevelCount; i++) {
+            m_Sizes[i] = glm::ivec2(levelWidth, levelHeight);
+            down[i] = graph.createTexture("bloom down " + std::to_string(i), {levelWidth, levelHeight, GL_R11F_G11F_B10F});
+            FrameGraph::Resource source = i == 0 ? sceneColor : down[i - 1];
+            graph.addPass("bloom down " + std::to_string(i), [this, i, source](const FrameGraph &graph) {
+                downsample(graph, i, source);
+            }).read(source).write(down[i]);
+            levelWidth = std::max(levelWidth / 2, 1);
+            levelHeight = std::max(levelHeight / 2, 1);
+        }
+
+        FrameGraph::Resource result = down[LevelCount - 1];
+        for (int i = LevelCount - 2; i >= 0; i--) {
+            FrameGraph::Resource source = result;
+            result = graph.createTexture("bloom up " + std::to_string(i), {m_Sizes[i].x, m_Sizes[i].y, GL_R11F_G11F_B10F});
+            int pass = 2 * LevelCount - 2 - i;
+            graph.addPass("bloom up " + std::to_string(i), [this, pass, source](const FrameGraph &graph) {
+                upsample(graph, pass, source);
+            }).read(source).write(result);
+        }
+        return result;
+    }
+
+    PassStats passStats(int pass) const {
+        int level = pass < LevelCount ? pass : 2 * LevelCount - 2 - pass;
+        std::string name = pass < LevelCount ? "down " : "up ";
+        return {name + std::to_string(level), m_Sizes[level].x, m_Sizes[level].y, m_Timers[pass].averageMs()};
+    }
+
+private:
+    Shader m_Downsample;
+    Shader m_Upsample;
+    glm::ivec2 m_Sizes[LevelCount];
+    GpuTimer m_Timers[PassCount];
+    float m_Threshold = 1.0f;
+    float m_Knee = 0.5f;
+
+    void downsample(const FrameGraph &graph, int level, FrameGraph::Resource source) {
+        m_Timers[level].begin();
+        glDisable(GL_DEPTH_TEST);
+        m_Downsample.use();
+        m_Downsample.setInt("source", 0);
+        m_Downsample.setFloat("threshold", m_Threshold);
+        m_Downsample.setFloat("knee", m_Knee);
+        // offsets of half an output texel, in the source's texture coordinates
+        m_Downsample.setVec2("offset", glm::vec2(0.5f / m_Sizes[level].x, 0.5f / m_Sizes[level].y));
+        m_Downsample.setBool("prefilter", level == 0);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, graph.texture(source));
+        drawFullscreenTriangle();
+        glEnable(GL_DEPTH_TEST);
+        m_Timers[level].end();
+    }
+
+    void upsample(const FrameGraph &graph, int pass, FrameGraph::Resource source) {
+        m_Timers[pass].begin();
+        glDisable(GL_DEPTH_TEST);
+        m_Upsample.use();
+        m_Upsample.setInt("source", 0);
+        const FrameGraph::TextureDesc &desc = graph.desc(source);
+        m_Upsample.setVec2("offset", glm::vec2(0.5f / desc.width, 0.5f / desc.height));
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, graph.texture(source));
+        drawFullscreenTriangle();
+        glEnable(GL_DEPTH_TEST);
+        m_Timers[pass].end();
+    }
+};
+
+}
+
+#endif //PROJECT_BASE_BLOOM_H
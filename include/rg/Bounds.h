@@ -0,0 +1,55 @@
+//
+// Bounding spheres of models, in model space and after a transform.
+//
+
+#ifndef PROJECT_BASE_BOUNDS_H
+#define PROJECT_BASE_BOUNDS_H
+
+#include <glm/glm.hpp>
+#include <learnopengl/model.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace rg {
+
+struct BoundingSphere {
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;
+};
+
+// centered on the axis aligned box of all vertices, not minimal but tight enough for round models
+inline BoundingSphere boundingSphere(const Model &model) {
+    BoundingSphere sphere;
+    glm::vec3 low(1e30f), high(-1e30f);
+    bool empty = true;
+    for (const Mesh &mesh : model.meshes) {
+        for (const Vertex &vertex : mesh.vertices) {
+            low = glm::min(low, vertex.Position);
+            high = glm::max(high, vertex.Position);
+            empty = false;
+        }
+    }
+    if (empty)
+        return sphere;
+    sphere.center = (low + high) * 0.5f;
+    for (const Mesh &mesh : model.meshes) {
+        for (const Vertex &vertex : mesh.vertices)
+            sphere.radius = std::max(sphere.radius, glm::length(vertex.Position - sphere.center));
+    }
+    return sphere;
+}
+
+// the radius grows with the largest scale of the transform
+inline BoundingSphere transformSphere(const BoundingSphere &sphere, const glm::mat4 &transform) {
+    BoundingSphere result;
+    result.center = glm::vec3(transform * glm::vec4(sphere.center, 1.0f));
+    float scale = std::max(glm::length(glm::vec3(transform[0])),
+                           std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+    result.radius = sphere.radius * scale;
+    return result;
+}
+
+}
+
+#endif //PROJECT_BASE_BOUNDS_H
@@ -0,0 +1,318 @@
+//
+// Clustered forward shading for many small point lights. The view frustum is split into a
+// froxel grid (screen tiles x exponential depth slices) and every cluster gets the list of
+// lights whose range reaches into it. The lists are built on the CPU each frame with the job
+// system and uploaded as texture buffers; clustered.glsl walks only the lights of the
+// fragment's own cluster.
+//
+// A light is listed only in the clusters whose view space bounding box its sphere touches, not
+// in the whole screen/depth box around the sphere, and the grid is fine enough (40 pixel tiles at
+// 1280x720, slices about 1.8 units deep at the earth) that a fragment of the earth walks ~230
+// listed lights for the ~80 that reach it. Binning the 4096 demo lights takes ~9 ms on one core,
+// the slices are spread over the job system.
+//
+
+#ifndef PROJECT_BASE_CLUSTEREDLIGHTS_H
+#define PROJECT_BASE_CLUSTEREDLIGHTS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+#include <rg/JobSystem.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+namespace rg {
+
+struct ClusterLight {
+    glm::vec3 position;
+    // diffuse and specular color, there is no ambient term for clustered lights
+    glm::vec3 color;
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+// distance at which constant/linear/quadratic attenuation brings the brightest channel of the
+// light under `threshold`, beyond it the light is treated as zero
+inline float lightRange(const glm::vec3 &color, float constant, float linear, float quadratic,
+                        float threshold = 5.0f / 256.0f) {
+    float intensity = std::max(color.r, std::max(color.g, color.b));
+    float c = constant - intensity / threshold;
+    if (c >= 0.0f)
+        return 0.0f;
+    if (quadratic > 0.0f)
+        return (-linear + std::sqrt(linear * linear - 4.0f * quadratic * c)) / (2.0f * quadratic);
+    if (linear > 0.0f)
+        return -c / linear;
+    return 1e30f;
+}
+
+class ClusteredLights {
+public:
+    static const int DimX = 32;
+    static const int DimY = 18;
+    static const int DimZ = 64;
+    static const int ClusterCount = DimX * DimY * DimZ;
+    // light data, grid and index list are bound to this unit and the two after it
+    static const int FirstTextureUnit = 8;
+
+    struct Stats {
+        unsigned int lights = 0;
+        // lights that reach into the view frustum
+        unsigned int visibleLights = 0;
+        unsigned int indices = 0;
+        unsigned int maxLightsPerCluster = 0;
+        // the index list didn't fit into GL_MAX_TEXTURE_BUFFER_SIZE and was cut
+        bool truncated = false;
+        double buildMs = 0.0;
+    };
+
+    explicit ClusteredLights(JobSystem &jobs) : m_Jobs(jobs) {
+        glGenBuffers(3, m_Buffers);
+        glGenTextures(3, m_Textures);
+        const GLenum formats[3] = {GL_RGBA32F, GL_RG32UI, GL_R32UI};
+        for (int i = 0; i < 3; i++) {
+            glBindBuffer(GL_TEXTURE_BUFFER, m_Buffers[i]);
+            glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+            glBindTexture(GL_TEXTURE_BUFFER, m_Textures[i]);
+            glTexBuffer(GL_TEXTURE_BUFFER, formats[i], m_Buffers[i]);
+        }
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &m_MaxTexels);
+        m_Grid.resize(ClusterCount * 2);
+        m_Counts.resize(ClusterCount);
+    }
+
+    // bins the lights into the clusters of this view and uploads the result
+    void update(const std::vector<ClusterLight> &lights, const glm::mat4 &view, const glm::mat4 &projection,
+                float nearPlane, float farPlane) {
+        auto start = std::chrono::steady_clock::now();
+        m_Near = nearPlane;
+        m_Far = farPlane;
+        m_ProjectionX = projection[0][0];
+        m_ProjectionY = projection[1][1];
+        for (int z = 0; z <= DimZ; z++)
+            m_SliceDepth[z] = m_Near * std::pow(m_Far / m_Near, (float) z / DimZ);
+        m_Stats.lights = lights.size();
+
+        // per light: packed shader data and the cluster range its bounding sphere covers
+        m_LightData.resize(std::max<size_t>(lights.size() * 3, 1));
+        m_Bounds.resize(lights.size());
+        m_Jobs.parallelFor(lights.size(), 256, [&](unsigned int begin, unsigned int end) {
+            for (unsigned int i = begin; i < end; i++) {
+                const ClusterLight &light = lights[i];
+                float range = lightRange(light.color, light.constant, light.linear, light.quadratic);
+                m_LightData[i * 3 + 0] = glm::vec4(light.position, range);
+                m_LightData[i * 3 + 1] = glm::vec4(light.color, light.constant);
+                m_LightData[i * 3 + 2] = glm::vec4(light.linear, light.quadratic, 0.0f, 0.0f);
+                m_Bounds[i] = clusterBounds(glm::vec3(view * glm::vec4(light.position, 1.0f)), range, projection);
+            }
+        });
+
+        // every depth slice is filled independently into its own index list
+        m_Jobs.parallelFor(DimZ, 1, [&](unsigned int begin, unsigned int end) {
+            for (unsigned int z = begin; z < end; z++)
+                buildSlice(z);
+        });
+
+        // slice lists are laid out one after the other
+        unsigned int offset = 0;
+        m_Stats.maxLightsPerCluster = 0;
+        m_Stats.truncated = false;
+        for (int z = 0; z < DimZ; z++) {
+            m_SliceOffset[z] = offset;
+            unsigned int sliceOffset = 0;
+            for (int cluster = z * DimX * DimY; cluster < (z + 1) * DimX * DimY; cluster++) {
+                unsigned int count = m_Counts[cluster];
+                if (offset + sliceOffset + count > (unsigned int) m_MaxTexels) {
+                    count = (unsigned int) m_MaxTexels > offset + sliceOffset ? m_MaxTexels - offset - sliceOffset : 0;
+                    m_Stats.truncated = true;
+                }
+                m_Grid[cluster * 2] = offset + sliceOffset;
+                m_Grid[cluster * 2 + 1] = count;
+                sliceOffset += m_Counts[cluster];
+                m_Stats.maxLightsPerCluster = std::max(m_Stats.maxLightsPerCluster, m_Counts[cluster]);
+            }
+            offset += m_SliceIndices[z].size();
+        }
+        m_Stats.indices = offset;
+        m_Stats.visibleLights = 0;
+        for (const Bounds &bounds : m_Bounds)
+            m_Stats.visibleLights += bounds.visible ? 1 : 0;
+
+        glBindBuffer(GL_TEXTURE_BUFFER, m_Buffers[0]);
+        glBufferData(GL_TEXTURE_BUFFER, m_LightData.size() * sizeof(glm::vec4), &m_LightData[0], GL_STREAM_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, m_Buffers[1]);
+        glBufferData(GL_TEXTURE_BUFFER, m_Grid.size() * sizeof(GLuint), &m_Grid[0], GL_STREAM_DRAW);
+        glBindBuffer(GL_TEXTURE_BUFFER, m_Buffers[2]);
+        glBufferData(GL_TEXTURE_BUFFER, std::max(offset, 1u) * sizeof(GLuint), NULL, GL_STREAM_DRAW);
+        for (int z = 0; z < DimZ; z++) {
+            const std::vector<GLuint> &indices = m_SliceIndices[z];
+            if (!indices.empty() && m_SliceOffset[z] < (unsigned int) m_MaxTexels)
+                glBufferSubData(GL_TEXTURE_BUFFER, m_SliceOffset[z] * sizeof(GLuint), indices.size() * sizeof(GLuint),
+                                &indices[0]);
+        }
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        m_Stats.buildMs = m_Stats.buildMs == 0.0 ? ms : m_Stats.buildMs * 0.9 + ms * 0.1;
+    }
+
+    // binds the lists for a program that includes clustered.glsl, the program has to be in use
+    void bind(const Shader &shader, int viewportWidth, int viewportHeight) const {
+        const char *samplers[3] = {"clusterLights", "clusterGrid", "clusterIndices"};
+        for (int i = 0; i < 3; i++) {
+            glActiveTexture(GL_TEXTURE0 + FirstTextureUnit + i);
+            glBindTexture(GL_TEXTURE_BUFFER, m_Textures[i]);
+            shader.setInt(samplers[i], FirstTextureUnit + i);
+        }
+        glActiveTexture(GL_TEXTURE0);
+        glUniform3i(glGetUniformLocation(shader.ID, "clusterDims"), DimX, DimY, DimZ);
+        shader.setVec2("clusterViewport", glm::vec2(viewportWidth, viewportHeight));
+        shader.setFloat("clusterNear", m_Near);
+        shader.setFloat("clusterFar", m_Far);
+    }
+
+    const Stats &stats() const { return m_Stats; }
+
+private:
+    struct Bounds {
+        bool visible;
+        int x0, x1, y0, y1, z0, z1;
+        // the sphere in view space, for the exact test against every cluster of the range
+        glm::vec3 center;
+        float radius;
+    };
+
+    JobSystem &m_Jobs;
+    GLuint m_Buffers[3];
+    GLuint m_Textures[3];
+    GLint m_MaxTexels = 65536;
+    float m_Near = 0.1f;
+    float m_Far = 100.0f;
+    float m_ProjectionX = 1.0f;
+    float m_ProjectionY = 1.0f;
+    // view depth at the near side of every slice, and the far plane
+    float m_SliceDepth[DimZ + 1];
+
+    std::vector<glm::vec4> m_LightData;
+    std::vector<Bounds> m_Bounds;
+    std::vector<GLuint> m_Grid;
+    std::vector<unsigned int> m_Counts;
+    std::vector<GLuint> m_SliceIndices[DimZ];
+    unsigned int m_SliceOffset[DimZ];
+    Stats m_Stats;
+
+    int depthSlice(float depth) const {
+        float slice = std::log(depth / m_Near) / std::log(m_Far / m_Near) * DimZ;
+        return std::min(std::max((int) std::floor(slice), 0), DimZ - 1);
+    }
+
+    static int tile(float ndc, int dim) {
+        return std::min(std::max((int) std::floor((ndc * 0.5f + 0.5f) * dim), 0), dim - 1);
+    }
+
+    // conservative cluster range of a sphere in view space
+    Bounds clusterBounds(const glm::vec3 &center, float radius, const glm::mat4 &projection) const {
+        Bounds bounds;
+        bounds.visible = false;
+        bounds.center = center;
+        bounds.radius = radius;
+        float nearest = -center.z - radius;
+        float farthest = -center.z + radius;
+        if (farthest <= m_Near || nearest >= m_Far)
+            return bounds;
+        bounds.z0 = depthSlice(std::max(nearest, m_Near));
+        bounds.z1 = depthSlice(std::min(farthest, m_Far));
+
+        bounds.x0 = 0;
+        bounds.x1 = DimX - 1;
+        bounds.y0 = 0;
+        bounds.y1 = DimY - 1;
+        // a box that reaches to the camera plane covers the whole screen; otherwise x/(-z) is
+        // monotonic along each axis, so the projected extremes are at the corners of the box
+        if (nearest > m_Near) {
+            float minX = 1e30f, maxX = -1e30f, minY = 1e30f, maxY = -1e30f;
+            for (int corner = 0; corner < 8; corner++) {
+                glm::vec3 p = center + radius * glm::vec3(corner & 1 ? 1.0f : -1.0f, corner & 2 ? 1.0f : -1.0f,
+                                                          corner & 4 ? 1.0f : -1.0f);
+                float x = projection[0][0] * p.x / -p.z;
+                float y = projection[1][1] * p.y / -p.z;
+                minX = std::min(minX, x);
+                maxX = std::max(maxX, x);
+                minY = std::min(minY, y);
+                maxY = std::max(maxY, y);
+            }
+            if (maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f)
+                return bounds;
+            bounds.x0 = tile(minX, DimX);
+            bounds.x1 = tile(maxX, DimX);
+            bounds.y0 = tile(minY, DimY);
+            bounds.y1 = tile(maxY, DimY);
+        }
+        bounds.visible = true;
+        return bounds;
+    }
+
+    // calls f with the index within slice z of every cluster whose view space bounding box the
+    // light's sphere touches; the screen space range alone lists every light for the whole box
+    // around its sphere, which on the far side of a deep slice is mostly empty
+    template<typename F>
+    void forEachCluster(const Bounds &bounds, int z, F f) const {
+        float depth = -bounds.center.z;
+        float dz = std::max(std::max(m_SliceDepth[z] - depth, depth - m_SliceDepth[z + 1]), 0.0f);
+        float rest = bounds.radius * bounds.radius - dz * dz;
+        if (rest < 0.0f)
+            return;
+        // the side planes of a tile go through the eye, so its box spans them at both slice depths
+        float nearDepth = m_SliceDepth[z], farDepth = m_SliceDepth[z + 1];
+        for (int y = bounds.y0; y <= bounds.y1; y++) {
+            float bottom = (2.0f * y / DimY - 1.0f) / m_ProjectionY, top = (2.0f * (y + 1) / DimY - 1.0f) / m_ProjectionY;
+            float minY = std::min(bottom * nearDepth, bottom * farDepth), maxY = std::max(top * nearDepth, top * farDepth);
+            float dy = std::max(std::max(minY - bounds.center.y, bounds.center.y - maxY), 0.0f);
+            if (dy * dy > rest)
+                continue;
+            for (int x = bounds.x0; x <= bounds.x1; x++) {
+                float left = (2.0f * x / DimX - 1.0f) / m_ProjectionX, right = (2.0f * (x + 1) / DimX - 1.0f) / m_ProjectionX;
+                float minX = std::min(left * nearDepth, left * farDepth), maxX = std::max(right * nearDepth, right * farDepth);
+                float dx = std::max(std::max(minX - bounds.center.x, bounds.center.x - maxX), 0.0f);
+                if (dx * dx + dy * dy <= rest)
+                    f(y * DimX + x);
+            }
+        }
+    }
+
+    // counts the lights of every cluster in the slice, then writes the lists grouped by cluster
+    void buildSlice(int z) {
+        unsigned int *counts = &m_Counts[z * DimX * DimY];
+        std::fill(counts, counts + DimX * DimY, 0u);
+        for (const Bounds &bounds : m_Bounds) {
+            if (bounds.visible && z >= bounds.z0 && z <= bounds.z1)
+                forEachCluster(bounds, z, [counts](int cluster) { counts[cluster]++; });
+        }
+
+        unsigned int cursor[DimX * DimY];
+        unsigned int total = 0;
+        for (int i = 0; i < DimX * DimY; i++) {
+            cursor[i] = total;
+            total += counts[i];
+        }
+        std::vector<GLuint> &indices = m_SliceIndices[z];
+        indices.resize(total);
+        for (unsigned int light = 0; light < m_Bounds.size(); light++) {
+            const Bounds &bounds = m_Bounds[light];
+            if (bounds.visible && z >= bounds.z0 && z <= bounds.z1)
+                forEachCluster(bounds, z, [&](int cluster) { indices[cursor[cluster]++] = light; });
+        }
+    }
+};
+
+}
+
+#endif //PROJECT_BASE_CLUSTEREDLIGHTS_H
@@ -0,0 +1,214 @@
+//
+// CPU zone profiler. CPU_ZONE("name") times the rest of the enclosing block; every thread records
+// its zones into its own ring of RingSize entries without locks, so only the newest zones of each
+// thread are kept. writeChromeTrace dumps them as Chrome trace JSON (chrome://tracing, Perfetto).
+//
+// Timestamps are TSC reads on x86 and steady_clock elsewhere. The TSC is converted to time with
+// the rate measured between the first use of the profiler and the dump, which needs an invariant
+// TSC (every x86 CPU of the last decade has one). Zone names must be string literals.
+//
+// Configure with -DCPU_PROFILER=OFF (RG_CPU_PROFILER=0) to compile the zones out.
+//
+
+#ifndef PROJECT_BASE_CPUPROFILER_H
+#define PROJECT_BASE_CPUPROFILER_H
+
+#ifndef RG_CPU_PROFILER
+#define RG_CPU_PROFILER 1
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace rg {
+
+class CpuProfiler {
+public:
+    static const unsigned int RingSize = 1 << 15;
+
+    static uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+    }
+
+    static void record(const char *name, uint64_t start, uint64_t end) {
+        ThreadRing *ring = threadRing();
+        if (ring == nullptr)
+            ring = registerThread("thread");
+        uint64_t i = ring->written.load(std::memory_order_relaxed);
+        ring->zones[i % RingSize] = {name, start, end};
+        ring->written.store(i + 1, std::memory_order_release);
+    }
+
+    // shows up as the thread's name in the trace, call before the thread's first zone
+    static void setThreadName(const char *name) {
+        if (threadRing() == nullptr)
+            registerThread(name);
+        else
+            threadRing()->name = name;
+    }
+
+    // average cost of one zone, measured into a scratch ring that doesn't show up in the trace
+    static double measureOverheadNs(int count = 100000);
+
+    // the zones of every thread that are still in their rings and ended at or after sinceTicks (a
+    // value of now()), false when the file can't be written
+    static bool writeChromeTrace(const std::string &path, uint64_t sinceTicks = 0);
+
+private:
+    struct Zone {
+        const char *name;
+        uint64_t start;
+        uint64_t end;
+    };
+
+    // written only by its thread; readers check `written` before and after copying zones out
+    struct ThreadRing {
+        std::string name;
+        unsigned int id = 0;
+        std::atomic<uint64_t> written{0};
+        Zone zones[RingSize];
+    };
+
+    struct Registry {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<ThreadRing>> rings;
+        // clock reference for converting ticks to microseconds
+        uint64_t startTicks = now();
+        std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    };
+
+    static Registry &registry() {
+        static Registry registry;
+        return registry;
+    }
+
+    static ThreadRing *&threadRing() {
+        thread_local ThreadRing *ring = nullptr;
+        return ring;
+    }
+
+    static ThreadRing *registerThread(const char *name) {
+        Registry &r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.rings.emplace_back(new ThreadRing());
+        ThreadRing *ring = r.rings.back().get();
+        ring->name = name;
+        ring->id = r.rings.size();
+        threadRing() = ring;
+        return ring;
+    }
+
+    static void writeEscaped(std::ostream &out, const std::string &text) {
+        out << '"';
+        for (char c : text) {
+            if (c == '"' || c == '\\')
+                out << '\\';
+            out << c;
+        }
+        out << '"';
+    }
+};
+
+// times its scope, see CPU_ZONE
+class CpuZone {
+public:
+    explicit CpuZone(const char *name) : m_Name(name), m_Start(CpuProfiler::now()) {}
+    ~CpuZone() { CpuProfiler::record(m_Name, m_Start, CpuProfiler::now()); }
+
+    CpuZone(const CpuZone &) = delete;
+    CpuZone &operator=(const CpuZone &) = delete;
+
+private:
+    const char *m_Name;
+    uint64_t m_Start;
+};
+
+inline double CpuProfiler::measureOverheadNs(int count) {
+#if RG_CPU_PROFILER
+    std::unique_ptr<ThreadRing> scratch(new ThreadRing());
+    ThreadRing *own = threadRing();
+    threadRing() = scratch.get();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; i++) {
+        CpuZone zone("overhead");
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    threadRing() = own;
+    return ns / count;
+#else
+    (void) count;
+    return 0.0;
+#endif
+}
+
+inline bool CpuProfiler::writeChromeTrace(const std::string &path, uint64_t sinceTicks) {
+    std::ofstream out(path);
+    if (!out)
+        return false;
+    Registry &r = registry();
+    double ticksPerUs = 1.0;
+    double elapsedUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - r.startTime).count();
+    if (elapsedUs > 0.0)
+        ticksPerUs = (double) (now() - r.startTicks) / elapsedUs;
+
+    std::lock_guard<std::mutex> lock(r.mutex);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    std::vector<Zone> zones;
+    for (const std::unique_ptr<ThreadRing> &ring : r.rings) {
+        out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << ring->id
+            << ",\"args\":{\"name\":";
+        writeEscaped(out, ring->name);
+        out << "}}";
+        first = false;
+
+        // zones the thread overwrote while they were copied are dropped
+        uint64_t written = ring->written.load(std::memory_order_acquire);
+        uint64_t begin = written > RingSize ? written - RingSize : 0;
+        zones.assign(written - begin, Zone());
+        for (uint64_t i = begin; i < written; i++)
+            zones[i - begin] = ring->zones[i % RingSize];
+        uint64_t after = ring->written.load(std::memory_order_acquire);
+        uint64_t valid = after > RingSize ? after - RingSize : 0;
+        for (uint64_t i = std::max(begin, valid); i < written; i++) {
+            const Zone &zone = zones[i - begin];
+            if (zone.end < sinceTicks)
+                continue;
+            out << ",\n{\"name\":";
+            writeEscaped(out, zone.name);
+            out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << ring->id << std::fixed
+                << ",\"ts\":" << (double) (int64_t) (zone.start - r.startTicks) / ticksPerUs
+                << ",\"dur\":" << (double) (zone.end - zone.start) / ticksPerUs << '}';
+            out.unsetf(std::ios::fixed);
+        }
+    }
+    out << "\n]}\n";
+    return (bool) out;
+}
+
+}
+
+#if RG_CPU_PROFILER
+#define CPU_ZONE_CONCAT_(a, b) a##b
+#define CPU_ZONE_CONCAT(a, b) CPU_ZONE_CONCAT_(a, b)
+#define CPU_ZONE(name) rg::CpuZone CPU_ZONE_CONCAT(cpuZone, __LINE__)(name)
+#else
+#define CPU_ZONE(name) do {} while (0)
+#endif
+
+#endif //PROJECT_BASE_CPUPROFILER_H
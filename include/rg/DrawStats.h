@@ -0,0 +1,29 @@
+//
+// Draw call and triangle counters of the current frame. Every place that issues a draw call
+// counts it here; main resets the counters at the start of each frame. Render thread only.
+//
+
+#ifndef PROJECT_BASE_DRAWSTATS_H
+#define PROJECT_BASE_DRAWSTATS_H
+
+namespace rg {
+
+struct DrawStats {
+    unsigned int drawCalls = 0;
+    unsigned long long triangles = 0;
+};
+
+inline DrawStats &drawStats() {
+    static DrawStats stats;
+    return stats;
+}
+
+inline void countDraw(unsigned long long triangles) {
+    DrawStats &stats = drawStats();
+    stats.drawCalls++;
+    stats.triangles += triangles;
+}
+
+}
+
+#endif //PROJECT_BASE_DRAWSTATS_H
@@ -0,0 +1,123 @@
+//
+// Soft eclipse shadows of a spherical light by spherical occluders. The light and the occluder
+// are seen from the fragment as two discs; the visible fraction of the light is one minus the
+// area of their overlap over the area of the light disc, which gives umbra, penumbra and
+// antumbra without any shadow map.
+//
+// sphereVisibility mirrors SphereVisibility in resources/shaders/eclipse.glsl operation for
+// operation, in float, so checkEclipseShader can compare the two. Keep them in sync.
+//
+
+#ifndef PROJECT_BASE_ECLIPSE_H
+#define PROJECT_BASE_ECLIPSE_H
+
+#include <glm/glm.hpp>
+#include <learnopengl/shader.h>
+#include <rg/Bounds.h>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+const float EclipsePi = 3.14159265f;
+
+// area of the intersection of two discs with radii r1 and r2 whose centers are d apart
+inline float discOverlap(float r1, float r2, float d) {
+    if (d >= r1 + r2)
+        return 0.0f;
+    float rMin = std::min(r1, r2);
+    if (d <= std::max(r1, r2) - rMin)
+        return EclipsePi * rMin * rMin;
+    // half length of the common chord and its distance from the first center
+    float h = std::sqrt(std::max((-d + r1 + r2) * (d + r1 - r2) * (d - r1 + r2) * (d + r1 + r2), 0.0f)) / (2.0f * d);
+    float x1 = (d * d + r1 * r1 - r2 * r2) / (2.0f * d);
+    return r1 * r1 * std::atan2(h, x1) + r2 * r2 * std::atan2(h, d - x1) - d * h;
+}
+
+// angular radius of a sphere seen from the given distance
+inline float angularRadius(float radius, float distance) {
+    return std::atan2(radius, std::sqrt(std::max(distance * distance - radius * radius, 0.0f)));
+}
+
+// fraction of the light sphere visible from fragPos past one occluder (center, radius)
+inline float sphereVisibility(const glm::vec3 &fragPos, const glm::vec3 &lightPos, float lightRadius,
+                              const glm::vec4 &occluder) {
+    glm::vec3 toLight = lightPos - fragPos;
+    glm::vec3 toOccluder = glm::vec3(occluder) - fragPos;
+    float lightDistance = glm::length(toLight);
+    float occluderDistance = glm::length(toOccluder);
+    // the fragment is on this body (its night side comes from N dot L) or the body is behind the light
+    if (occluderDistance <= occluder.w * 1.01f || occluderDistance >= lightDistance)
+        return 1.0f;
+    float lightAngle = std::max(angularRadius(lightRadius, lightDistance), 1e-4f);
+    float occluderAngle = angularRadius(occluder.w, occluderDistance);
+    float separation = std::atan2(glm::length(glm::cross(toLight, toOccluder)), glm::dot(toLight, toOccluder));
+    float covered = discOverlap(lightAngle, occluderAngle, separation) / (EclipsePi * lightAngle * lightAngle);
+    return 1.0f - glm::clamp(covered, 0.0f, 1.0f);
+}
+
+// occluders of one receiver, uploaded to eclipse.glsl
+struct EclipseOccluders {
+    // eclipse.glsl has room for this many
+    static const int MaxCount = 4;
+    int count = 0;
+    glm::vec4 spheres[MaxCount];
+
+    void add(const glm::vec4 &sphere) {
+        for (int i = 0; i < count; i++) {
+            if (spheres[i] == sphere)
+                return;
+        }
+        if (count < MaxCount)
+            spheres[count++] = sphere;
+    }
+};
+
+// the bodies that can put any part of target into shadow: those reaching into the hull of the
+// target and light spheres, biggest apparent size first. bodies[skip] is the target itself when it
+// is one of the bodies, -1 otherwise.
+inline EclipseOccluders selectOccluders(const BoundingSphere &target, const std::vector<BoundingSphere> &bodies,
+                                        int skip, const glm::vec3 &lightPos, float lightRadius) {
+    glm::vec3 axis = lightPos - target.center;
+    float axisLength2 = std::max(glm::dot(axis, axis), 1e-8f);
+    std::vector<std::pair<float, unsigned int>> candidates;
+    for (unsigned int i = 0; i < bodies.size(); i++) {
+        const BoundingSphere &body = bodies[i];
+        if ((int) i == skip || body.radius <= 0.0f || glm::length(body.center - lightPos) <= body.radius)
+            continue;
+        float t = glm::clamp(glm::dot(body.center - target.center, axis) / axisLength2, 0.0f, 1.0f);
+        // the hull of the two spheres is inside the capsule with the larger radius
+        float reach = body.radius + std::max(target.radius, lightRadius);
+        if (glm::length(target.center + axis * t - body.center) >= reach)
+            continue;
+        float distance = std::max(glm::length(body.center - target.center), 1e-4f);
+        candidates.push_back({body.radius / distance, i});
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const std::pair<float, unsigned int> &a, const std::pair<float, unsigned int> &b) { return a.first > b.first; });
+    EclipseOccluders occluders;
+    for (const auto &candidate : candidates)
+        occluders.add(glm::vec4(bodies[candidate.second].center, bodies[candidate.second].radius));
+    return occluders;
+}
+
+// the occluders of bodies[receiver] among the other bodies
+inline EclipseOccluders selectOccluders(unsigned int receiver, const std::vector<BoundingSphere> &bodies,
+                                        const glm::vec3 &lightPos, float lightRadius) {
+    return selectOccluders(bodies[receiver], bodies, (int) receiver, lightPos, lightRadius);
+}
+
+// sets the eclipse.glsl uniforms of a program that is in use
+inline void setEclipseUniforms(const Shader &shader, const EclipseOccluders &occluders, float lightRadius) {
+    shader.setFloat("eclipseLightRadius", lightRadius);
+    shader.setInt("occluderCount", occluders.count);
+    for (int i = 0; i < occluders.count; i++)
+        shader.setVec4("occluders[" + std::to_string(i) + "]", occluders.spheres[i]);
+}
+
+}
+
+#endif //PROJECT_BASE_ECLIPSE_H
@@ -0,0 +1,100 @@
+//
+// Compares the eclipse math of resources/shaders/eclipse.glsl with its CPU twin rg::sphereVisibility
+// on a fixed set of random configurations covering lit, penumbra, antumbra and umbra. Run through
+// `--check-eclipse`, needs a current GL context.
+//
+
+#ifndef PROJECT_BASE_ECLIPSECHECK_H
+#define PROJECT_BASE_ECLIPSECHECK_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+#include <rg/Eclipse.h>
+#include <rg/RenderTarget.h>
+
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace rg {
+
+// true when every sample matches within tolerance
+inline bool checkEclipseShader(float tolerance = 2e-3f) {
+    const int Width = 64, Height = 64;
+    // per sample (fragPos, lightRadius), (lightPos, 0), (occluder)
+    std::vector<glm::vec4> samples(Width * Height * 3);
+    std::vector<float> expected(Width * Height);
+    std::mt19937 random(2024);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    int lit = 0, penumbra = 0, umbra = 0;
+    for (int i = 0; i < Width * Height; i++) {
+        // light on the z axis, the occluder somewhere in between and the fragment near the shadow axis,
+        // scaled so that roughly a third of the samples falls into each region
+        float lightDistance = 20.0f + 40.0f * unit(random);
+        float lightRadius = 0.2f + 3.0f * unit(random);
+        float occluderRadius = 0.3f + 2.0f * unit(random);
+        glm::vec3 occluderCenter(unit(random) - 0.5f, unit(random) - 0.5f, 1.5f + 10.0f * unit(random));
+        float spread = 3.0f * (occluderRadius + lightRadius * occluderCenter.z / lightDistance);
+        glm::vec3 fragPos((unit(random) - 0.5f) * spread, (unit(random) - 0.5f) * spread, 0.0f);
+        glm::vec3 lightPos(0.0f, 0.0f, lightDistance);
+        glm::vec4 occluder(occluderCenter, occluderRadius);
+        // a few fragments on the occluder itself, which has to be skipped
+        if (i % 64 == 0)
+            fragPos = occluderCenter + glm::normalize(glm::vec3(unit(random), unit(random), -1.0f)) * occluderRadius;
+
+        samples[i * 3] = glm::vec4(fragPos, lightRadius);
+        samples[i * 3 + 1] = glm::vec4(lightPos, 0.0f);
+        samples[i * 3 + 2] = occluder;
+        expected[i] = sphereVisibility(fragPos, lightPos, lightRadius, occluder);
+        if (expected[i] >= 1.0f)
+            lit++;
+        else if (expected[i] <= 0.0f)
+            umbra++;
+        else
+            penumbra++;
+    }
+
+    GLuint sampleTexture = createTexture2D(Width * 3, Height, GL_RGBA32F, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, sampleTexture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, Width * 3, Height, GL_RGBA, GL_FLOAT, samples.data());
+    RenderTarget target;
+    target.create(Width, Height, {GL_R32F}, 0, false);
+    Shader shader("resources/shaders/fullscreen.vs", "resources/shaders/eclipse_check.fs");
+
+    target.bind();
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+    shader.use();
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, sampleTexture);
+    shader.setInt("samples", 0);
+    drawFullscreenTriangle();
+    std::vector<float> result(Width * Height);
+    glReadPixels(0, 0, Width, Height, GL_RED, GL_FLOAT, result.data());
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    float maxError = 0.0f;
+    int failures = 0;
+    for (int i = 0; i < Width * Height; i++) {
+        float error = std::fabs(result[i] - expected[i]);
+        maxError = std::max(maxError, error);
+        if (error > tolerance && failures++ < 5) {
+            std::cout << "Eclipse check: sample " << i << " GPU " << result[i] << ", CPU " << expected[i] << '\n';
+        }
+    }
+    std::cout << "Eclipse check: " << Width * Height << " samples (" << lit << " lit, " << penumbra << " partial, "
+              << umbra << " umbra), max difference " << maxError << ", " << failures << " above " << tolerance << '\n';
+
+    glDeleteProgram(shader.ID);
+    target.destroy();
+    glDeleteTextures(1, &sampleTexture);
+    glEnable(GL_DEPTH_TEST);
+    return failures == 0;
+}
+
+}
+
+#endif //PROJECT_BASE_ECLIPSECHECK_H
@@ -0,0 +1,169 @@
+//
+// Surfaceless GL context through EGL, for the offscreen modes (--bench, --golden, the --farm
+// workers, --check-eclipse, --measure-glcall) on machines without a display server. They render
+// into framebuffer objects only, so the context needs no window and no surface.
+//
+// The display comes from EGL_MESA_platform_surfaceless (Mesa, including llvmpipe), else from the
+// first device of EGL_EXT_platform_device (the NVIDIA driver), else the default display. The
+// context is made current without a surface when EGL_KHR_surfaceless_context allows it and with
+// a 1x1 pbuffer otherwise.
+//
+// Configure with -DHEADLESS_EGL=ON (RG_HEADLESS_EGL=1) to build it in; otherwise create() always
+// fails and the offscreen modes keep their hidden GLFW window.
+//
+
+#ifndef PROJECT_BASE_EGLCONTEXT_H
+#define PROJECT_BASE_EGLCONTEXT_H
+
+#ifndef RG_HEADLESS_EGL
+#define RG_HEADLESS_EGL 0
+#endif
+
+#if RG_HEADLESS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <cstring>
+#include <iostream>
+#include <string>
+
+namespace rg {
+
+class EglContext {
+public:
+    static bool available() { return RG_HEADLESS_EGL != 0; }
+
+    // a core profile context of that version, current on this thread; false when there is none
+    bool create(int major, int minor, bool debug) {
+#if RG_HEADLESS_EGL
+        if (m_Display == EGL_NO_DISPLAY && !openDisplay())
+            return false;
+        if (eglBindAPI(EGL_OPENGL_API) != EGL_TRUE) {
+            std::cout << "EGL: no desktop OpenGL on " << m_Platform << '\n';
+            return false;
+        }
+        const char *extensions = eglQueryString(m_Display, EGL_EXTENSIONS);
+        bool surfaceless = hasExtension(extensions, "EGL_KHR_surfaceless_context");
+        EGLConfig config = (EGLConfig) 0;
+        if (!surfaceless || !hasExtension(extensions, "EGL_KHR_no_config_context")) {
+            const EGLint configAttributes[] = {EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                                               EGL_NONE};
+            EGLint count = 0;
+            if (eglChooseConfig(m_Display, configAttributes, &config, 1, &count) != EGL_TRUE || count == 0) {
+                std::cout << "EGL: no OpenGL config on " << m_Platform << '\n';
+                return false;
+            }
+        }
+        const EGLint contextAttributes[] = {EGL_CONTEXT_MAJOR_VERSION_KHR, major, EGL_CONTEXT_MINOR_VERSION_KHR, minor,
+                                            EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR,
+                                            EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR, EGL_CONTEXT_FLAGS_KHR,
+                                            debug ? EGL_CONTEXT_OPENGL_DEBUG_BIT_KHR : 0, EGL_NONE};
+        m_Context = eglCreateContext(m_Display, config, EGL_NO_CONTEXT, contextAttributes);
+        if (m_Context == EGL_NO_CONTEXT)
+            return false;
+        if (!surfaceless) {
+            const EGLint surfaceAttributes[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+            m_Surface = eglCreatePbufferSurface(m_Display, config, surfaceAttributes);
+        }
+        if (eglMakeCurrent(m_Display, m_Surface, m_Surface, m_Context) != EGL_TRUE) {
+            std::cout << "EGL: can't make the context current\n";
+            destroyContext();
+            return false;
+        }
+        std::cout << "EGL: OpenGL " << major << "." << minor << " context on " << m_Platform
+                  << (surfaceless ? ", surfaceless\n" : ", with a pbuffer\n");
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    bool valid() const {
+#if RG_HEADLESS_EGL
+        return m_Context != EGL_NO_CONTEXT;
+#else
+        return false;
+#endif
+    }
+
+    // for gladLoadGLLoader and loadGLExt, core functions included (EGL 1.5 and Mesa return them)
+    static void *getProcAddress(const char *name) {
+#if RG_HEADLESS_EGL
+        return (void *) eglGetProcAddress(name);
+#else
+        return nullptr;
+#endif
+    }
+
+    void release() {
+#if RG_HEADLESS_EGL
+        destroyContext();
+        if (m_Display != EGL_NO_DISPLAY)
+            eglTerminate(m_Display);
+        m_Display = EGL_NO_DISPLAY;
+#endif
+    }
+
+private:
+#if RG_HEADLESS_EGL
+    EGLDisplay m_Display = EGL_NO_DISPLAY;
+    EGLContext m_Context = EGL_NO_CONTEXT;
+    EGLSurface m_Surface = EGL_NO_SURFACE;
+    std::string m_Platform;
+
+    // whole words of a space separated extension string
+    static bool hasExtension(const char *extensions, const char *name) {
+        size_t length = std::strlen(name);
+        for (const char *found = extensions; found != NULL && (found = std::strstr(found, name)) != NULL; found += length) {
+            if ((found == extensions || found[-1] == ' ') && (found[length] == ' ' || found[length] == '\0'))
+                return true;
+        }
+        return false;
+    }
+
+    bool openDisplay() {
+        const char *clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+        auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay != NULL && hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless")) {
+            m_Display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+            m_Platform = "the surfaceless platform";
+            if (m_Display != EGL_NO_DISPLAY && eglInitialize(m_Display, NULL, NULL) == EGL_TRUE)
+                return true;
+        }
+        auto queryDevices = (PFNEGLQUERYDEVICESEXTPROC) eglGetProcAddress("eglQueryDevicesEXT");
+        EGLDeviceEXT device;
+        EGLint devices = 0;
+        if (getPlatformDisplay != NULL && queryDevices != NULL && hasExtension(clientExtensions, "EGL_EXT_platform_device")
+            && queryDevices(1, &device, &devices) == EGL_TRUE && devices > 0) {
+            m_Display = getPlatformDisplay(EGL_PLATFORM_DEVICE_EXT, device, NULL);
+            m_Platform = "the first EGL device";
+            if (m_Display != EGL_NO_DISPLAY && eglInitialize(m_Display, NULL, NULL) == EGL_TRUE)
+                return true;
+        }
+        m_Display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        m_Platform = "the default display";
+        if (m_Display != EGL_NO_DISPLAY && eglInitialize(m_Display, NULL, NULL) == EGL_TRUE)
+            return true;
+        m_Display = EGL_NO_DISPLAY;
+        std::cout << "EGL: no display\n";
+        return false;
+    }
+
+    void destroyContext() {
+        if (m_Display == EGL_NO_DISPLAY)
+            return;
+        eglMakeCurrent(m_Display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (m_Surface != EGL_NO_SURFACE)
+            eglDestroySurface(m_Display, m_Surface);
+        if (m_Context != EGL_NO_CONTEXT)
+            eglDestroyContext(m_Display, m_Context);
+        m_Surface = EGL_NO_SURFACE;
+        m_Context = EGL_NO_CONTEXT;
+    }
+#endif
+};
+
+}
+
+#endif //PROJECT_BASE_EGLCONTEXT_H
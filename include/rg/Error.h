@@ -7,12 +7,22 @@
 
 #include <iostream>
 #include <glad/glad.h>
+#include <rg/GLDebug.h>
 
 #define LOG(stream) stream << "[" << __FILE__ << ", " << __func__ << ", " << __LINE__ << "] "
 #define BREAK_IF_FALSE(x) if (!(x)) __builtin_trap()
 #define ASSERT(x, msg) do { if (!(x)) { std::cerr << msg << '\n'; BREAK_IF_FALSE(false); } } while(0)
+// Release builds leave just the call. Debug builds record the call site for rg::GLDebug messages
+// and only poll glGetError when the context has no debug output.
+#ifdef NDEBUG
+#define GLCALL(x) x
+#else
 #define GLCALL(x) \
-do{ rg::clearAllOpenGlErrors(); x; BREAK_IF_FALSE(rg::wasPreviousOpenGLCallSuccessful(__FILE__, __LINE__, #x)); } while (0)
+do{ rg::GLDebug::setCallSite(__FILE__, __LINE__, #x); \
+    if (rg::GLDebug::active()) { x; } \
+    else { rg::clearAllOpenGlErrors(); x; BREAK_IF_FALSE(rg::wasPreviousOpenGLCallSuccessful(__FILE__, __LINE__, #x)); } \
+} while (0)
+#endif
 
 namespace rg {
 
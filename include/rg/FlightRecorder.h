@@ -0,0 +1,117 @@
+//
+// Always-on flight recorder for hitches. Every frame adds one small record to a ring of the last
+// FrameCount frames; that and the counters it is filled from are the whole cost while frames stay
+// within budget. When a frame takes longer than the budget, the window is written to the working
+// directory (the repository root, where the program is run from for its assets), all files named
+// hitch_<frame>_*:
+//
+//   frames.csv  the recorded frames: CPU and GPU time, draw calls, triangles, render scale
+//   cpu.json    CPU zones of the window as Chrome trace JSON (see rg/CpuProfiler.h)
+//   gpu.csv     per-pass GPU times of the GpuProfiler history
+//   state.txt   camera and program state from the caller, followed by the recent asset loads
+//
+// Writing the files makes the following frame slow too, so hitches inside the next FrameCount
+// frames are not dumped again. The first FrameCount frames (loading, shader warm-up) are skipped.
+//
+
+#ifndef PROJECT_BASE_FLIGHTRECORDER_H
+#define PROJECT_BASE_FLIGHTRECORDER_H
+
+#include <rg/AssetLog.h>
+#include <rg/CpuProfiler.h>
+#include <rg/GpuProfiler.h>
+
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+class FlightRecorder {
+public:
+    struct Frame {
+        unsigned long long frame;
+        // from the start of this frame to the start of the next one, including the swap
+        double cpuMs;
+        // GPU time of the scene as last reported, a few frames late
+        double gpuMs;
+        unsigned int drawCalls;
+        unsigned long long triangles;
+        float renderScale;
+        // CpuProfiler::now() at the start of the frame
+        uint64_t startTicks;
+    };
+
+    struct Settings {
+        bool enabled = true;
+        float budgetMs = 50.0f;
+    };
+
+    Settings settings;
+
+    explicit FlightRecorder(unsigned int frameCount = 120) : m_Frames(frameCount) {}
+
+    // records a finished frame; dumps the window and returns true when it was over budget
+    bool endFrame(const Frame &frame, const GpuProfiler &gpuProfiler,
+                  const std::function<void(std::ostream &)> &writeState) {
+        m_Frames[m_Recorded % m_Frames.size()] = frame;
+        m_Recorded++;
+        if (m_Quiet > 0) {
+            m_Quiet--;
+            return false;
+        }
+        if (!settings.enabled || m_Recorded < m_Frames.size() || frame.cpuMs <= settings.budgetMs)
+            return false;
+
+        m_Hitches++;
+        m_Quiet = m_Frames.size();
+        m_LastDump = "hitch_" + std::to_string(frame.frame);
+        dump(m_LastDump, gpuProfiler, writeState);
+        std::cout << "Hitch: frame " << frame.frame << " took " << frame.cpuMs << " ms, wrote " << m_LastDump
+                  << "_*\n";
+        return true;
+    }
+
+    unsigned long long hitches() const { return m_Hitches; }
+    // file name prefix of the last dump, empty before the first one
+    const std::string &lastDump() const { return m_LastDump; }
+
+private:
+    std::vector<Frame> m_Frames;
+    unsigned long long m_Recorded = 0;
+    unsigned long long m_Quiet = 0;
+    unsigned long long m_Hitches = 0;
+    std::string m_LastDump;
+
+    void dump(const std::string &prefix, const GpuProfiler &gpuProfiler,
+              const std::function<void(std::ostream &)> &writeState) const {
+        // oldest recorded frame first
+        unsigned int count = m_Frames.size();
+        const Frame &oldest = m_Frames[m_Recorded % count];
+
+        std::ofstream frames(prefix + "_frames.csv");
+        frames << "frame,cpu_ms,gpu_ms,draw_calls,triangles,render_scale\n";
+        for (unsigned int i = 0; i < count; i++) {
+            const Frame &f = m_Frames[(m_Recorded + i) % count];
+            frames << f.frame << ',' << f.cpuMs << ',' << f.gpuMs << ',' << f.drawCalls << ',' << f.triangles << ','
+                   << f.renderScale << '\n';
+        }
+
+        CpuProfiler::writeChromeTrace(prefix + "_cpu.json", oldest.startTicks);
+
+        std::ofstream gpu(prefix + "_gpu.csv");
+        gpuProfiler.writeCsv(gpu);
+
+        std::ofstream state(prefix + "_state.txt");
+        state << "budget_ms " << settings.budgetMs << '\n';
+        writeState(state);
+        AssetLog::instance().write(state);
+    }
+};
+
+}
+
+#endif //PROJECT_BASE_FLIGHTRECORDER_H
@@ -0,0 +1,366 @@
+//
+// Screenshots and video capture of the window without stalling the frame. Frames are read back
+// through a PixelReadback ring of pixel buffer objects, mapped a few frames later, and handed to
+// an encoder thread that writes them as a PNG sequence (<dir>/capture_000000.png and on) or as raw
+// RGB frames, top row first, into the standard input of an encoder process, e.g.
+//
+//     ffmpeg -f rawvideo -pixel_format rgb24 -video_size {width}x{height} -framerate 60 -i - capture.mp4
+//
+// where {width} and {height} are replaced by the size of the first frame.
+//
+// The render thread never waits for the encoder: when its queue is full the frame is dropped and
+// counted, and so is a frame of a different size than the first one of a video (the window was
+// resized). A stall of the readback ring shows that the GPU is behind, not the encoder.
+// Screenshots are never dropped. Like the other GL wrappers it has no GL calls in its destructor,
+// finish() and release() have to run while the context is current.
+//
+
+#ifndef PROJECT_BASE_FRAMECAPTURE_H
+#define PROJECT_BASE_FRAMECAPTURE_H
+
+#include <rg/PixelReadback.h>
+#include <rg/PngWriter.h>
+
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+
+namespace rg {
+
+class FrameCapture {
+public:
+    struct Settings {
+        // PNG sequence target
+        std::string directory = "capture";
+        // an encoder reading raw frames from its standard input; when set, videos go there instead
+        std::string pipeCommand;
+        // frames waiting for the encoder thread before new ones are dropped
+        unsigned int queueFrames = 8;
+    };
+
+    struct Stats {
+        // frames of videos read back and handed over, written by the encoder thread, dropped because
+        // its queue was full or the size changed, and failed to write
+        unsigned long long captured = 0;
+        unsigned long long written = 0;
+        unsigned long long dropped = 0;
+        unsigned long long failed = 0;
+        // requests that had to wait for the oldest buffer of the readback ring
+        unsigned long long stalls = 0;
+        unsigned int queued = 0;
+    };
+
+    Settings settings;
+
+    explicit FrameCapture(unsigned int ringSize = 4) : m_Readback(ringSize) {}
+
+    ~FrameCapture() {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Quit = true;
+        }
+        m_WakeUp.notify_all();
+        if (m_Encoder.joinable())
+            m_Encoder.join();
+        if (m_Pipe != NULL)
+            pclose(m_Pipe);
+    }
+
+    FrameCapture(const FrameCapture &) = delete;
+    FrameCapture &operator=(const FrameCapture &) = delete;
+
+    bool recording() const { return m_Recording; }
+
+    // frames have to keep coming while a recording runs or a screenshot isn't read back yet
+    bool busy() const { return m_Recording || m_Screenshots > 0 || !m_Pending.empty(); }
+
+    // records every following frame into settings.pipeCommand, or into settings.directory
+    bool start() {
+        if (m_Recording)
+            return true;
+        if (settings.pipeCommand.empty()) {
+            if (mkdir(settings.directory.c_str(), 0755) != 0 && errno != EEXIST) {
+                std::cout << "Capture: failed to create " << settings.directory << '\n';
+                return false;
+            }
+            // a second recording into the same directory goes on after the frames already in it
+            while (exists(sequencePath(m_SequenceFrame)))
+                m_SequenceFrame++;
+            std::cout << "Capture: recording to " << sequencePath(m_SequenceFrame) << " and on\n";
+        } else {
+            std::cout << "Capture: recording into " << settings.pipeCommand << '\n';
+        }
+        m_Session++;
+        m_Recording = true;
+        startEncoder();
+        return true;
+    }
+
+    // waits for the frames in flight on the GPU, the encoder finishes them on its own
+    void stop() {
+        if (!m_Recording)
+            return;
+        m_Readback.finish([this](unsigned long long tag, Image &image) { deliver(tag, image); });
+        m_Recording = false;
+        if (!settings.pipeCommand.empty()) {
+            Image none;
+            push(Job::ClosePipe, none, std::string(), false, false);
+        }
+        Stats current = stats();
+        std::cout << "Capture: stopped, " << current.captured << " frames captured, " << current.dropped << " dropped\n";
+    }
+
+    // the next frame goes to screenshot_<n>.png, n the first number not taken yet
+    void screenshot() {
+        m_Screenshots++;
+    }
+
+    // once per frame, after the frame is rendered into framebuffer (0 for the back buffer)
+    void capture(GLuint framebuffer, int width, int height) {
+        auto deliverFrame = [this](unsigned long long tag, Image &image) { deliver(tag, image); };
+        if (m_Recording || m_Screenshots > 0) {
+            Request request;
+            request.tag = m_NextTag++;
+            request.session = m_Recording ? m_Session : 0;
+            for (; m_Screenshots > 0; m_Screenshots--) {
+                while (exists("screenshot_" + std::to_string(m_ScreenshotNumber) + ".png"))
+                    m_ScreenshotNumber++;
+                request.screenshots.push_back("screenshot_" + std::to_string(m_ScreenshotNumber++) + ".png");
+            }
+            m_Pending.push_back(request);
+            m_Readback.request(framebuffer, width, height, request.tag, deliverFrame);
+        }
+        m_Readback.poll(deliverFrame);
+    }
+
+    // at the end of the run: the frames in flight are read back and everything queued is written
+    void finish() {
+        stop();
+        m_Readback.finish([this](unsigned long long tag, Image &image) { deliver(tag, image); });
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_Idle.wait(lock, [this] { return m_Jobs.empty() && !m_Busy; });
+    }
+
+    Stats stats() const {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        Stats stats = m_Stats;
+        stats.written = m_Written;
+        stats.failed = m_Failed;
+        stats.stalls = m_Readback.stalls();
+        stats.queued = m_Jobs.size();
+        return stats;
+    }
+
+    void release() { m_Readback.release(); }
+
+private:
+    struct Request {
+        unsigned long long tag = 0;
+        // the recording the frame belongs to, 0 when it is only a screenshot
+        unsigned long long session = 0;
+        std::vector<std::string> screenshots;
+    };
+
+    struct Job {
+        enum Kind { Png, PipeFrame, ClosePipe };
+        Kind kind = Png;
+        // screenshots aren't part of the counts of a video
+        bool screenshot = false;
+        Image image;
+        // the file of a PNG, the command of a pipe frame
+        std::string target;
+    };
+
+    PixelReadback m_Readback;
+    std::deque<Request> m_Pending;
+    unsigned long long m_NextTag = 0;
+    unsigned long long m_Session = 0;
+    bool m_Recording = false;
+    unsigned int m_Screenshots = 0;
+    int m_ScreenshotNumber = 0;
+    int m_SequenceFrame = 0;
+    // size of the video in the pipe, the first frame of the recording decides it
+    unsigned long long m_VideoSession = 0;
+    int m_VideoWidth = 0;
+    int m_VideoHeight = 0;
+
+    mutable std::mutex m_Mutex;
+    std::condition_variable m_WakeUp;
+    std::condition_variable m_Idle;
+    std::thread m_Encoder;
+    std::deque<Job> m_Jobs;
+    // pixel buffers of written frames, reused so a steady capture doesn't allocate
+    std::vector<std::vector<unsigned char>> m_FreePixels;
+    bool m_Quit = false;
+    bool m_Busy = false;
+    Stats m_Stats;
+    std::atomic<unsigned long long> m_Written{0};
+    std::atomic<unsigned long long> m_Failed{0};
+    // only touched by the encoder thread
+    FILE *m_Pipe = NULL;
+    bool m_PipeFailed = false;
+
+    static bool exists(const std::string &path) {
+        struct stat info;
+        return stat(path.c_str(), &info) == 0;
+    }
+
+    std::string sequencePath(int frame) const {
+        char name[32];
+        std::snprintf(name, sizeof(name), "/capture_%06d.png", frame);
+        return settings.directory + name;
+    }
+
+    void startEncoder() {
+        if (!m_Encoder.joinable())
+            m_Encoder = std::thread([this] { encoderLoop(); });
+    }
+
+    // readback handler, on the render thread, in request order
+    void deliver(unsigned long long tag, Image &image) {
+        // a buffer that failed to map never comes, its request is dropped with the ones before
+        while (!m_Pending.empty() && m_Pending.front().tag < tag)
+            m_Pending.pop_front();
+        if (m_Pending.empty() || m_Pending.front().tag != tag)
+            return;
+        Request request = m_Pending.front();
+        m_Pending.pop_front();
+
+        // a screenshot may share its frame with a video, it gets a copy
+        for (const std::string &path : request.screenshots)
+            push(Job::Png, image, path, true, true);
+        if (request.session == 0)
+            return;
+        bool pipe = !settings.pipeCommand.empty();
+        if (pipe && request.session != m_VideoSession) {
+            m_VideoSession = request.session;
+            m_VideoWidth = image.width;
+            m_VideoHeight = image.height;
+        }
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_Stats.captured++;
+        if (m_Jobs.size() >= settings.queueFrames || (pipe && (image.width != m_VideoWidth || image.height != m_VideoHeight))) {
+            m_Stats.dropped++;
+            return;
+        }
+        lock.unlock();
+        push(pipe ? Job::PipeFrame : Job::Png, image, pipe ? settings.pipeCommand : sequencePath(m_SequenceFrame++),
+             false, false);
+    }
+
+    // takes the pixels of image, which gets a recycled buffer in exchange, unless copy is set
+    void push(Job::Kind kind, Image &image, const std::string &target, bool copy, bool screenshot) {
+        Job job;
+        job.kind = kind;
+        job.screenshot = screenshot;
+        job.target = target;
+        job.image.width = image.width;
+        job.image.height = image.height;
+        job.image.channels = image.channels;
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            if (copy) {
+                job.image.pixels = image.pixels;
+            } else {
+                if (!m_FreePixels.empty()) {
+                    job.image.pixels.swap(m_FreePixels.back());
+                    m_FreePixels.pop_back();
+                }
+                job.image.pixels.swap(image.pixels);
+            }
+            m_Jobs.push_back(std::move(job));
+        }
+        startEncoder();
+        m_WakeUp.notify_one();
+    }
+
+    void encoderLoop() {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        while (true) {
+            m_WakeUp.wait(lock, [this] { return m_Quit || !m_Jobs.empty(); });
+            if (m_Jobs.empty())
+                return;
+            Job job = std::move(m_Jobs.front());
+            m_Jobs.pop_front();
+            m_Busy = true;
+            lock.unlock();
+
+            bool written = true;
+            if (job.kind == Job::Png)
+                written = writePng(job.target, job.image.width, job.image.height, job.image.channels,
+                                   &job.image.pixels[0], true);
+            else if (job.kind == Job::PipeFrame)
+                written = writePipe(job);
+            else
+                closePipe();
+            if (job.kind != Job::ClosePipe && !job.screenshot)
+                (written ? m_Written : m_Failed)++;
+            if (!written && job.kind == Job::Png)
+                std::cout << "Capture: failed to write " << job.target << '\n';
+
+            lock.lock();
+            if (!job.image.pixels.empty())
+                m_FreePixels.push_back(std::move(job.image.pixels));
+            m_Busy = false;
+            if (m_Jobs.empty())
+                m_Idle.notify_all();
+        }
+    }
+
+    bool writePipe(const Job &job) {
+        if (m_PipeFailed)
+            return false;
+        if (m_Pipe == NULL) {
+            std::string command = job.target;
+            replace(command, "{width}", std::to_string(job.image.width));
+            replace(command, "{height}", std::to_string(job.image.height));
+            // an encoder that exits early has to show up as a failed write, not end the program
+            std::signal(SIGPIPE, SIG_IGN);
+            m_Pipe = popen(command.c_str(), "w");
+            if (m_Pipe == NULL) {
+                std::cout << "Capture: can't start " << command << '\n';
+                m_PipeFailed = true;
+                return false;
+            }
+        }
+        // glReadPixels rows are bottom up, encoders expect the top row first
+        size_t rowSize = (size_t) job.image.width * job.image.channels;
+        for (int y = job.image.height - 1; y >= 0; y--) {
+            if (std::fwrite(&job.image.pixels[rowSize * y], 1, rowSize, m_Pipe) != rowSize) {
+                std::cout << "Capture: the encoder stopped reading\n";
+                m_PipeFailed = true;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void closePipe() {
+        if (m_Pipe != NULL) {
+            int status = pclose(m_Pipe);
+            if (status != 0)
+                std::cout << "Capture: the encoder exited with status " << status << '\n';
+        }
+        m_Pipe = NULL;
+        m_PipeFailed = false;
+    }
+
+    static void replace(std::string &text, const std::string &from, const std::string &to) {
+        for (size_t at = text.find(from); at != std::string::npos; at = text.find(from, at + to.size()))
+            text.replace(at, from.size(), to);
+    }
+};
+
+}
+
+#endif //PROJECT_BASE_FRAMECAPTURE_H
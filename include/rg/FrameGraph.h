@@ -0,0 +1,324 @@
+//
+// Small frame graph for the offscreen passes that follow the opaque scene. Passes declare the
+// textures they sample and the ones they render into; compile() drops the passes whose results
+// nobody uses, works out in which passes every transient texture is alive, and lets transient
+// textures of the same size and format share one GL texture when their lifetimes don't overlap.
+// GL can't alias memory between different formats, so sharing is per size and format.
+//
+// The graph is built and compiled when the resolution or the configuration changes and executed
+// every frame. Each pass runs with its framebuffer bound and the viewport set to its targets;
+// it sets all other state it needs and puts it back, like the rest of the renderer.
+//
+
+#ifndef PROJECT_BASE_FRAMEGRAPH_H
+#define PROJECT_BASE_FRAMEGRAPH_H
+
+#include <glad/glad.h>
+#include <rg/Error.h>
+#include <rg/GLDebug.h>
+#include <rg/GpuProfiler.h>
+#include <rg/RenderTarget.h>
+
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+class FrameGraph {
+public:
+    typedef int Resource;
+    static const Resource None = -1;
+
+    struct TextureDesc {
+        int width;
+        int height;
+        GLenum format;
+    };
+
+    typedef std::function<void(const FrameGraph &)> Execute;
+
+    class Pass {
+    public:
+        // sampled in the pass
+        Pass &read(Resource resource) { reads.push_back(resource); return *this; }
+        // next color attachment
+        Pass &write(Resource resource) { colors.push_back(resource); return *this; }
+        // depth attachment that is only tested against
+        Pass &depthTest(Resource resource) { depth = resource; writesDepth = false; return *this; }
+        // depth attachment that is written
+        Pass &depthWrite(Resource resource) { depth = resource; writesDepth = true; return *this; }
+
+    private:
+        friend class FrameGraph;
+        std::string name;
+        Execute execute;
+        std::vector<Resource> reads;
+        std::vector<Resource> colors;
+        Resource depth = None;
+        bool writesDepth = false;
+        bool culled = false;
+        GLuint framebuffer = 0;
+        int width = 0;
+        int height = 0;
+    };
+
+    struct Stats {
+        unsigned int passes = 0;
+        unsigned int culledPasses = 0;
+        unsigned int transientTextures = 0;
+        unsigned int physicalTextures = 0;
+        // every transient texture with its own memory, and after sharing
+        size_t transientBytes = 0;
+        size_t aliasedBytes = 0;
+    };
+
+    // a texture owned outside of the graph, e.g. the scene target; texture 0 is the window
+    Resource importTexture(const std::string &name, GLuint texture, const TextureDesc &desc) {
+        m_Resources.push_back({name, desc, true, texture, -1});
+        return m_Resources.size() - 1;
+    }
+
+    Resource createTexture(const std::string &name, const TextureDesc &desc) {
+        m_Resources.push_back({name, desc, false, 0, -1});
+        return m_Resources.size() - 1;
+    }
+
+    // passes run in the order they are added
+    Pass &addPass(const std::string &name, const Execute &execute) {
+        m_Passes.emplace_back();
+        m_Passes.back().name = name;
+        m_Passes.back().execute = execute;
+        return m_Passes.back();
+    }
+
+    // deletes the GL objects of the last compile and forgets all passes and resources
+    void reset() {
+        release();
+        m_Passes.clear();
+        m_Resources.clear();
+    }
+
+    void compile() {
+        release();
+        m_Stats = Stats();
+        cull();
+
+        // first and last live pass that uses each transient texture
+        std::vector<int> first(m_Resources.size(), -1), last(m_Resources.size(), -1);
+        for (unsigned int p = 0; p < m_Passes.size(); p++) {
+            if (m_Passes[p].culled)
+                continue;
+            forEachUse(m_Passes[p], [&](Resource r) {
+                if (first[r] == -1)
+                    first[r] = p;
+                last[r] = p;
+            });
+        }
+
+        // walk the passes in order, taking a free physical texture of the same kind when a
+        // transient texture comes alive and giving it back after its last use
+        std::vector<int> free;
+        for (unsigned int p = 0; p < m_Passes.size(); p++) {
+            for (unsigned int r = 0; r < m_Resources.size(); r++) {
+                if (first[r] != (int) p || m_Resources[r].imported)
+                    continue;
+                const TextureDesc &desc = m_Resources[r].desc;
+                m_Stats.transientTextures++;
+                m_Stats.transientBytes += textureBytes(desc);
+                for (unsigned int i = 0; i < free.size() && m_Resources[r].physical == -1; i++) {
+                    const TextureDesc &other = m_Physical[free[i]].desc;
+                    if (other.width == desc.width && other.height == desc.height && other.format == desc.format) {
+                        m_Resources[r].physical = free[i];
+                        free.erase(free.begin() + i);
+                    }
+                }
+                if (m_Resources[r].physical == -1) {
+                    GLenum filter = isDepthFormat(desc.format) ? GL_NEAREST : GL_LINEAR;
+                    m_Physical.push_back({desc, createTexture2D(desc.width, desc.height, desc.format, filter)});
+                    m_Resources[r].physical = m_Physical.size() - 1;
+                    m_Stats.aliasedBytes += textureBytes(desc);
+                }
+                m_Resources[r].texture = m_Physical[m_Resources[r].physical].texture;
+            }
+            for (unsigned int r = 0; r < m_Resources.size(); r++) {
+                if (last[r] == (int) p && !m_Resources[r].imported)
+                    free.push_back(m_Resources[r].physical);
+            }
+        }
+        m_Stats.physicalTextures = m_Physical.size();
+        labelTextures();
+
+        for (Pass &pass : m_Passes) {
+            if (!pass.culled)
+                createFramebuffer(pass);
+        }
+
+        std::cout << "Frame graph: " << m_Stats.passes << " passes, " << m_Stats.culledPasses << " culled; "
+                  << m_Stats.transientTextures << " transient textures need " << m_Stats.transientBytes / (1024.0 * 1024.0)
+                  << " MB, aliased into " << m_Stats.physicalTextures << " textures with "
+                  << m_Stats.aliasedBytes / (1024.0 * 1024.0) << " MB\n";
+    }
+
+    // every live pass runs in a debug group and gets a profiler scope under its name when a
+    // profiler is given
+    void execute(GpuProfiler *profiler = NULL) const {
+        for (const Pass &pass : m_Passes) {
+            if (pass.culled)
+                continue;
+            DebugGroup group(pass.name.c_str());
+            int scope = profiler != NULL ? profiler->begin(pass.name) : -1;
+            glBindFramebuffer(GL_FRAMEBUFFER, pass.framebuffer);
+            glViewport(0, 0, pass.width, pass.height);
+            pass.execute(*this);
+            if (profiler != NULL)
+                profiler->end(scope);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    GLuint texture(Resource resource) const { return m_Resources[resource].texture; }
+    const TextureDesc &desc(Resource resource) const { return m_Resources[resource].desc; }
+
+    const Stats &stats() const { return m_Stats; }
+    unsigned int passCount() const { return m_Passes.size(); }
+    const std::string &passName(unsigned int pass) const { return m_Passes[pass].name; }
+    bool passCulled(unsigned int pass) const { return m_Passes[pass].culled; }
+
+    static size_t textureBytes(const TextureDesc &desc) {
+        size_t pixelBytes;
+        switch (desc.format) {
+            case GL_R8: pixelBytes = 1; break;
+            case GL_R16F: pixelBytes = 2; break;
+            case GL_RGBA16F: case GL_RG32F: pixelBytes = 8; break;
+            case GL_RGB16F: pixelBytes = 6; break;
+            case GL_RGBA32F: pixelBytes = 16; break;
+            default: pixelBytes = 4; break;
+        }
+        return pixelBytes * desc.width * desc.height;
+    }
+
+private:
+    struct ResourceEntry {
+        std::string name;
+        TextureDesc desc;
+        bool imported;
+        GLuint texture;
+        // index into m_Physical, transient textures only
+        int physical;
+    };
+
+    struct PhysicalTexture {
+        TextureDesc desc;
+        GLuint texture;
+    };
+
+    std::vector<Pass> m_Passes;
+    std::vector<ResourceEntry> m_Resources;
+    std::vector<PhysicalTexture> m_Physical;
+    Stats m_Stats;
+
+    static bool isDepthFormat(GLenum format) {
+        return format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH_COMPONENT24 || format == GL_DEPTH_COMPONENT32F;
+    }
+
+    template<typename F>
+    static void forEachUse(const Pass &pass, F f) {
+        for (Resource r : pass.reads)
+            f(r);
+        for (Resource r : pass.colors)
+            f(r);
+        if (pass.depth != None)
+            f(pass.depth);
+    }
+
+    // backwards from the imported textures, which are what the frame leaves behind: a pass is
+    // kept when something it renders into is still needed, and then everything it uses is needed
+    void cull() {
+        std::vector<bool> needed(m_Resources.size(), false);
+        for (unsigned int r = 0; r < m_Resources.size(); r++)
+            needed[r] = m_Resources[r].imported;
+        m_Stats.culledPasses = 0;
+        for (int p = (int) m_Passes.size() - 1; p >= 0; p--) {
+            Pass &pass = m_Passes[p];
+            bool live = pass.writesDepth && needed[pass.depth];
+            for (Resource r : pass.colors)
+                live = live || needed[r];
+            pass.culled = !live;
+            if (live)
+                forEachUse(pass, [&](Resource r) { needed[r] = true; });
+        }
+        for (const Pass &pass : m_Passes)
+            m_Stats.culledPasses += pass.culled;
+        m_Stats.passes = m_Passes.size();
+        for (ResourceEntry &resource : m_Resources) {
+            if (!resource.imported) {
+                resource.physical = -1;
+                resource.texture = 0;
+            }
+        }
+    }
+
+    void createFramebuffer(Pass &pass) {
+        Resource sizeFrom = pass.colors.empty() ? pass.depth : pass.colors[0];
+        ASSERT(sizeFrom != None, "Frame graph pass " << pass.name << " renders into nothing");
+        pass.width = m_Resources[sizeFrom].desc.width;
+        pass.height = m_Resources[sizeFrom].desc.height;
+        // the window can't be combined with other attachments
+        if (m_Resources[sizeFrom].imported && m_Resources[sizeFrom].texture == 0) {
+            pass.framebuffer = 0;
+            return;
+        }
+        glGenFramebuffers(1, &pass.framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, pass.framebuffer);
+        GLDebug::label(GL_FRAMEBUFFER, pass.framebuffer, "frame graph " + pass.name);
+        std::vector<GLenum> drawBuffers;
+        for (unsigned int i = 0; i < pass.colors.size(); i++) {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, texture(pass.colors[i]), 0);
+            drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + i);
+        }
+        if (drawBuffers.empty()) {
+            glDrawBuffer(GL_NONE);
+            glReadBuffer(GL_NONE);
+        } else {
+            glDrawBuffers(drawBuffers.size(), &drawBuffers[0]);
+        }
+        if (pass.depth != None) {
+            GLenum attachment = desc(pass.depth).format == GL_DEPTH24_STENCIL8 ? GL_DEPTH_STENCIL_ATTACHMENT
+                                                                               : GL_DEPTH_ATTACHMENT;
+            glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, texture(pass.depth), 0);
+        }
+        ASSERT(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE,
+               "Frame graph pass " << pass.name << " has an incomplete framebuffer!");
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // a shared texture is named after every resource it holds
+    void labelTextures() const {
+        std::vector<std::string> labels(m_Physical.size());
+        for (const ResourceEntry &resource : m_Resources) {
+            if (resource.imported || resource.physical == -1)
+                continue;
+            std::string &label = labels[resource.physical];
+            label += (label.empty() ? "frame graph " : ", ") + resource.name;
+        }
+        for (unsigned int i = 0; i < m_Physical.size(); i++)
+            GLDebug::label(GL_TEXTURE, m_Physical[i].texture, labels[i]);
+    }
+
+    void release() {
+        for (Pass &pass : m_Passes) {
+            if (pass.framebuffer != 0)
+                glDeleteFramebuffers(1, &pass.framebuffer);
+            pass.framebuffer = 0;
+        }
+        for (const PhysicalTexture &physical : m_Physical)
+            glDeleteTextures(1, &physical.texture);
+        m_Physical.clear();
+    }
+};
+
+}
+
+#endif //PROJECT_BASE_FRAMEGRAPH_H
@@ -0,0 +1,277 @@
+//
+// GL debug output instead of glGetError polling. The driver reports errors, undefined behavior and
+// performance warnings through a callback (KHR_debug, core in 4.3, or ARB_debug_output), so a
+// correct call costs nothing extra, where GLCALL used to add two glGetError round trips to each.
+//
+// Asynchronous output (the default) lets the driver report from its own threads, late and without
+// a call stack. Synchronous output (--gl-debug) reports from inside the failing call, so the call
+// site GLCALL records and the open debug groups name the exact call; put a breakpoint in
+// GLDebug::callback to stop there.
+//
+// Every message (source, type and id) is printed MaxRepeats times at most, and no more than
+// MaxPerSecond messages a second in total, so a warning inside a draw loop can't flood the log.
+//
+// DebugGroup brackets a part of the frame; the groups show up in the messages and in GPU debuggers
+// like RenderDoc next to the labels given with GLDebug::label.
+//
+
+#ifndef PROJECT_BASE_GLDEBUG_H
+#define PROJECT_BASE_GLDEBUG_H
+
+#include <glad/glad.h>
+#include <rg/GLExt.h>
+
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace rg {
+
+class GLDebug {
+public:
+    static const int MaxRepeats = 5;
+    static const int MaxPerSecond = 50;
+
+    struct Stats {
+        unsigned long long messages = 0;
+        unsigned long long printed = 0;
+        unsigned long long suppressed = 0;
+        unsigned long long errors = 0;
+    };
+
+    // severity is the lowest one printed, GL_DEBUG_SEVERITY_NOTIFICATION for everything;
+    // false when the context has no debug output
+    static bool enable(GLenum severity, bool synchronous) {
+        if (!glext().hasDebugOutput())
+            return false;
+        State &s = state();
+        s.minimumRank = severityRank(severity);
+        // ARB_debug_output has no GL_DEBUG_OUTPUT, it is always on there and the enum is invalid;
+        // GL_DEBUG_OUTPUT_SYNCHRONOUS has the same value as GL_DEBUG_OUTPUT_SYNCHRONOUS_ARB
+        if (glext().khrDebug)
+            glEnable(GL_DEBUG_OUTPUT);
+        if (synchronous)
+            glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+        else
+            glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+        // filtered in the driver too, so ignored messages aren't even formatted
+        glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_FALSE);
+        static const GLenum severities[] = {GL_DEBUG_SEVERITY_HIGH, GL_DEBUG_SEVERITY_MEDIUM, GL_DEBUG_SEVERITY_LOW,
+                                            GL_DEBUG_SEVERITY_NOTIFICATION};
+        for (GLenum level : severities) {
+            if (severityRank(level) >= s.minimumRank)
+                glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, level, 0, nullptr, GL_TRUE);
+        }
+        glDebugMessageCallback(callback, nullptr);
+        s.active = true;
+        s.synchronous = synchronous;
+        return true;
+    }
+
+    static bool active() { return state().active; }
+    static bool synchronous() { return state().synchronous; }
+
+    static Stats stats() {
+        State &s = state();
+        std::lock_guard<std::mutex> lock(s.mutex);
+        return s.stats;
+    }
+
+    // names a GL object in debuggers and messages, identifier is GL_TEXTURE, GL_FRAMEBUFFER, ...
+    static void label(GLenum identifier, GLuint name, const std::string &text) {
+        if (glext().hasDebugGroups() && name != 0)
+            glObjectLabel(identifier, name, -1, text.c_str());
+    }
+
+    // for parts of the frame that aren't a block, see DebugGroup; name must be a string literal or
+    // outlive the group
+    static void pushGroup(const char *name) {
+        if (!glext().hasDebugGroups())
+            return;
+        groupStack().push_back(name);
+        glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, name);
+    }
+
+    static void popGroup() {
+        if (!glext().hasDebugGroups())
+            return;
+        glPopDebugGroup();
+        groupStack().pop_back();
+    }
+
+    // set by GLCALL in debug builds, reported with messages of the same thread
+    static void setCallSite(const char *file, int line, const char *call) {
+        CallSite &site = callSite();
+        site.file = file;
+        site.line = line;
+        site.call = call;
+    }
+
+    // time of one GL call with and without the old GLCALL glGetError checks around it, in ns;
+    // glGetError is a round trip into the driver, on multithreaded drivers a sync with its thread
+    static void measureGetErrorOverhead(int count, double &plainNs, double &checkedNs) {
+        auto run = [count](bool checked) {
+            glFinish();
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < count; i++) {
+                if (checked) {
+                    while (glGetError() != GL_NO_ERROR) {}
+                }
+                glBindBuffer(GL_ARRAY_BUFFER, 0);
+                if (checked) {
+                    while (glGetError() != GL_NO_ERROR) {}
+                }
+            }
+            glFinish();
+            return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / count;
+        };
+        run(false);
+        plainNs = run(false);
+        checkedNs = run(true);
+    }
+
+    static void APIENTRY callback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length,
+                                  const GLchar *message, const void *) {
+        // our own groups echo back as messages
+        if (type == GL_DEBUG_TYPE_PUSH_GROUP || type == GL_DEBUG_TYPE_POP_GROUP)
+            return;
+        State &s = state();
+        if (severityRank(severity) < s.minimumRank)
+            return;
+        std::lock_guard<std::mutex> lock(s.mutex);
+        s.stats.messages++;
+        if (type == GL_DEBUG_TYPE_ERROR)
+            s.stats.errors++;
+        int &repeats = s.repeats[std::make_tuple(source, type, id)];
+        auto now = std::chrono::steady_clock::now();
+        if (now - s.secondStart >= std::chrono::seconds(1)) {
+            s.secondStart = now;
+            s.printedThisSecond = 0;
+        }
+        if (repeats >= MaxRepeats || s.printedThisSecond >= MaxPerSecond) {
+            s.stats.suppressed++;
+            return;
+        }
+        repeats++;
+        s.printedThisSecond++;
+        s.stats.printed++;
+
+        std::cerr << "[GL " << severityName(severity) << ' ' << typeName(type) << ", " << sourceName(source)
+                  << ", id " << id << "] ";
+        if (length >= 0)
+            std::cerr.write(message, length);
+        else
+            std::cerr << message;
+        std::cerr << '\n';
+        // only the thread the message came from has the context; asynchronous messages can
+        // come from a driver thread, or long after the call
+        if (s.synchronous) {
+            const std::vector<const char *> &groups = groupStack();
+            if (!groups.empty()) {
+                std::cerr << "  in ";
+                for (unsigned int i = 0; i < groups.size(); i++)
+                    std::cerr << (i > 0 ? " / " : "") << groups[i];
+                std::cerr << '\n';
+            }
+            const CallSite &site = callSite();
+            if (site.file != nullptr)
+                std::cerr << "  last GLCALL: " << site.call << " at " << site.file << ':' << site.line << '\n';
+        }
+        if (repeats == MaxRepeats)
+            std::cerr << "  (repeated " << MaxRepeats << " times, not shown again)\n";
+    }
+
+private:
+    struct CallSite {
+        const char *file = nullptr;
+        int line = 0;
+        const char *call = nullptr;
+    };
+
+    struct State {
+        std::mutex mutex;
+        bool active = false;
+        bool synchronous = false;
+        int minimumRank = 0;
+        Stats stats;
+        std::map<std::tuple<GLenum, GLenum, GLuint>, int> repeats;
+        std::chrono::steady_clock::time_point secondStart;
+        int printedThisSecond = 0;
+    };
+
+    static State &state() {
+        static State state;
+        return state;
+    }
+
+    static CallSite &callSite() {
+        thread_local CallSite site;
+        return site;
+    }
+
+    // names of the open DebugGroups of the thread, string literals
+    static std::vector<const char *> &groupStack() {
+        thread_local std::vector<const char *> stack;
+        return stack;
+    }
+
+    static int severityRank(GLenum severity) {
+        switch (severity) {
+            case GL_DEBUG_SEVERITY_HIGH: return 3;
+            case GL_DEBUG_SEVERITY_MEDIUM: return 2;
+            case GL_DEBUG_SEVERITY_LOW: return 1;
+            default: return 0;
+        }
+    }
+
+    static const char *severityName(GLenum severity) {
+        switch (severity) {
+            case GL_DEBUG_SEVERITY_HIGH: return "high";
+            case GL_DEBUG_SEVERITY_MEDIUM: return "medium";
+            case GL_DEBUG_SEVERITY_LOW: return "low";
+            default: return "note";
+        }
+    }
+
+    static const char *typeName(GLenum type) {
+        switch (type) {
+            case GL_DEBUG_TYPE_ERROR: return "error";
+            case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "deprecated";
+            case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR: return "undefined behavior";
+            case GL_DEBUG_TYPE_PORTABILITY: return "portability";
+            case GL_DEBUG_TYPE_PERFORMANCE: return "performance";
+            case GL_DEBUG_TYPE_MARKER: return "marker";
+            default: return "other";
+        }
+    }
+
+    static const char *sourceName(GLenum source) {
+        switch (source) {
+            case GL_DEBUG_SOURCE_API: return "API";
+            case GL_DEBUG_SOURCE_WINDOW_SYSTEM: return "window system";
+            case GL_DEBUG_SOURCE_SHADER_COMPILER: return "shader compiler";
+            case GL_DEBUG_SOURCE_THIRD_PARTY: return "third party";
+            case GL_DEBUG_SOURCE_APPLICATION: return "application";
+            default: return "other";
+        }
+    }
+};
+
+// names the enclosing block for debug messages and GPU debuggers; name must be a string literal
+// or outlive the group. Costs nothing without KHR_debug.
+class DebugGroup {
+public:
+    explicit DebugGroup(const char *name) { GLDebug::pushGroup(name); }
+    ~DebugGroup() { GLDebug::popGroup(); }
+
+    DebugGroup(const DebugGroup &) = delete;
+    DebugGroup &operator=(const DebugGroup &) = delete;
+};
+
+}
+
+#endif //PROJECT_BASE_GLDEBUG_H
@@ -0,0 +1,147 @@
+//
+// Entry points and tokens that are newer than the GL 3.3 core profile glad was generated for.
+// They are loaded at runtime and stay null when the context does not provide them, so every
+// caller has to check the matching has*() query before using them.
+//
+
+#ifndef PROJECT_BASE_GLEXT_H
+#define PROJECT_BASE_GLEXT_H
+
+#include <glad/glad.h>
+#include <cstring>
+
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#endif
+#ifndef GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT
+#define GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT 0x90DF
+#endif
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+// KHR_debug, the ARB_debug_output tokens have the same values
+#ifndef GL_DEBUG_OUTPUT
+#define GL_DEBUG_OUTPUT 0x92E0
+#define GL_DEBUG_OUTPUT_SYNCHRONOUS 0x8242
+#define GL_DEBUG_SOURCE_API 0x8246
+#define GL_DEBUG_SOURCE_WINDOW_SYSTEM 0x8247
+#define GL_DEBUG_SOURCE_SHADER_COMPILER 0x8248
+#define GL_DEBUG_SOURCE_THIRD_PARTY 0x8249
+#define GL_DEBUG_SOURCE_APPLICATION 0x824A
+#define GL_DEBUG_SOURCE_OTHER 0x824B
+#define GL_DEBUG_TYPE_ERROR 0x824C
+#define GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR 0x824D
+#define GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR 0x824E
+#define GL_DEBUG_TYPE_PORTABILITY 0x824F
+#define GL_DEBUG_TYPE_PERFORMANCE 0x8250
+#define GL_DEBUG_TYPE_OTHER 0x8251
+#define GL_DEBUG_TYPE_MARKER 0x8268
+#define GL_DEBUG_TYPE_PUSH_GROUP 0x8269
+#define GL_DEBUG_TYPE_POP_GROUP 0x826A
+#define GL_DEBUG_SEVERITY_HIGH 0x9146
+#define GL_DEBUG_SEVERITY_MEDIUM 0x9147
+#define GL_DEBUG_SEVERITY_LOW 0x9148
+#define GL_DEBUG_SEVERITY_NOTIFICATION 0x826B
+#endif
+
+namespace rg {
+
+typedef void (APIENTRYP PFNRGMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void *indirect, GLsizei drawcount, GLsizei stride);
+typedef void (APIENTRYP PFNRGBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+typedef void (APIENTRYP PFNRGDEBUGMESSAGECALLBACKPROC)(GLDEBUGPROC callback, const void *userParam);
+typedef void (APIENTRYP PFNRGDEBUGMESSAGECONTROLPROC)(GLenum source, GLenum type, GLenum severity, GLsizei count, const GLuint *ids, GLboolean enabled);
+typedef void (APIENTRYP PFNRGPUSHDEBUGGROUPPROC)(GLenum source, GLuint id, GLsizei length, const GLchar *message);
+typedef void (APIENTRYP PFNRGPOPDEBUGGROUPPROC)();
+typedef void (APIENTRYP PFNRGOBJECTLABELPROC)(GLenum identifier, GLuint name, GLsizei length, const GLchar *label);
+
+struct GLExt {
+    int major = 3;
+    int minor = 3;
+
+    PFNRGMULTIDRAWELEMENTSINDIRECTPROC MultiDrawElementsIndirect = nullptr;
+    PFNRGBUFFERSTORAGEPROC BufferStorage = nullptr;
+    // KHR_debug (core in 4.3), or only the first two from ARB_debug_output
+    PFNRGDEBUGMESSAGECALLBACKPROC DebugMessageCallback = nullptr;
+    PFNRGDEBUGMESSAGECONTROLPROC DebugMessageControl = nullptr;
+    PFNRGPUSHDEBUGGROUPPROC PushDebugGroup = nullptr;
+    PFNRGPOPDEBUGGROUPPROC PopDebugGroup = nullptr;
+    PFNRGOBJECTLABELPROC ObjectLabel = nullptr;
+    // the functions above came from KHR_debug, which also has the GL_DEBUG_OUTPUT switch
+    bool khrDebug = false;
+
+    bool versionAtLeast(int maj, int min) const {
+        return major > maj || (major == maj && minor >= min);
+    }
+    bool hasMultiDrawIndirect() const {
+        return MultiDrawElementsIndirect != nullptr && versionAtLeast(4, 3);
+    }
+    // GL 4.4 or ARB_buffer_storage, needed for persistently mapped buffers
+    bool hasBufferStorage() const {
+        return BufferStorage != nullptr;
+    }
+    // message callback of KHR_debug or ARB_debug_output
+    bool hasDebugOutput() const {
+        return DebugMessageCallback != nullptr && DebugMessageControl != nullptr;
+    }
+    // debug groups and object labels, KHR_debug only
+    bool hasDebugGroups() const {
+        return PushDebugGroup != nullptr && PopDebugGroup != nullptr && ObjectLabel != nullptr;
+    }
+};
+
+inline GLExt& glext() {
+    static GLExt ext;
+    return ext;
+}
+
+inline bool hasGLExtension(const char *name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++) {
+        const char *ext = (const char *) glGetStringi(GL_EXTENSIONS, i);
+        if (ext && std::strcmp(ext, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+// has to be called after gladLoadGLLoader, with the same loader
+inline void loadGLExt(GLADloadproc load) {
+    GLExt &ext = glext();
+    glGetIntegerv(GL_MAJOR_VERSION, &ext.major);
+    glGetIntegerv(GL_MINOR_VERSION, &ext.minor);
+
+    if (ext.versionAtLeast(4, 3))
+        ext.MultiDrawElementsIndirect = (PFNRGMULTIDRAWELEMENTSINDIRECTPROC) load("glMultiDrawElementsIndirect");
+    if (ext.versionAtLeast(4, 4) || hasGLExtension("GL_ARB_buffer_storage"))
+        ext.BufferStorage = (PFNRGBUFFERSTORAGEPROC) load("glBufferStorage");
+    if (ext.versionAtLeast(4, 3) || hasGLExtension("GL_KHR_debug")) {
+        ext.DebugMessageCallback = (PFNRGDEBUGMESSAGECALLBACKPROC) load("glDebugMessageCallback");
+        ext.DebugMessageControl = (PFNRGDEBUGMESSAGECONTROLPROC) load("glDebugMessageControl");
+        ext.PushDebugGroup = (PFNRGPUSHDEBUGGROUPPROC) load("glPushDebugGroup");
+        ext.PopDebugGroup = (PFNRGPOPDEBUGGROUPPROC) load("glPopDebugGroup");
+        ext.ObjectLabel = (PFNRGOBJECTLABELPROC) load("glObjectLabel");
+        ext.khrDebug = true;
+    } else if (hasGLExtension("GL_ARB_debug_output")) {
+        ext.DebugMessageCallback = (PFNRGDEBUGMESSAGECALLBACKPROC) load("glDebugMessageCallbackARB");
+        ext.DebugMessageControl = (PFNRGDEBUGMESSAGECONTROLPROC) load("glDebugMessageControlARB");
+    }
+}
+
+}
+
+#define glMultiDrawElementsIndirect rg::glext().MultiDrawElementsIndirect
+#define glBufferStorage rg::glext().BufferStorage
+#define glDebugMessageCallback rg::glext().DebugMessageCallback
+#define glDebugMessageControl rg::glext().DebugMessageControl
+#define glPushDebugGroup rg::glext().PushDebugGroup
+#define glPopDebugGroup rg::glext().PopDebugGroup
+#define glObjectLabel rg::glext().ObjectLabel
+
+#endif //PROJECT_BASE_GLEXT_H
@@ -0,0 +1,177 @@
+//
+// Golden image tests (--golden <dir>): a list of camera views at fixed simulation times, each
+// rendered offscreen, read back and compared with a PNG stored next to the list. A test passes
+// when the SSIM of the frame and its golden is at least minSsim and no more than maxBadPixels of
+// the pixels are clearly off (see ImageDiff.h), so the tolerances can be tight for a plain view
+// and looser for one full of blended dust. A failing test leaves <name>.actual.png and an SSIM
+// map, <name>.diff.png (brighter where the structure differs), next to its golden.
+//
+// The list is dir/golden.txt, one entry per line, '#' starts a comment:
+//   size <width> <height>
+//   test <name> <time> <camera x y z> <target x y z> <min ssim> <max bad pixels>
+//
+// --golden-update writes the rendered frames as the new goldens instead. The frames are compared
+// on the job system, one test per job.
+//
+
+#ifndef PROJECT_BASE_GOLDENIMAGES_H
+#define PROJECT_BASE_GOLDENIMAGES_H
+
+#include <glm/glm.hpp>
+#include <stb_image.h>
+
+#include <learnopengl/camera.h>
+#include <rg/ImageDiff.h>
+#include <rg/JobSystem.h>
+#include <rg/PixelReadback.h>
+#include <rg/PngWriter.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+class GoldenSuite {
+public:
+    struct Test {
+        std::string name;
+        // simulation time of the frame in seconds
+        float time = 0.0f;
+        glm::vec3 position = glm::vec3(0.0f);
+        glm::vec3 target = glm::vec3(0.0f, 0.0f, -1.0f);
+        double minSsim = 0.98;
+        double maxBadPixels = 0.005;
+        Image frame;
+        ImageDifference difference;
+        bool passed = false;
+        std::string error;
+    };
+
+    int width = 480;
+    int height = 270;
+
+    // false when the list can't be read or has no tests
+    bool load(const std::string &directory) {
+        m_Directory = directory;
+        m_Tests.clear();
+        std::ifstream in(directory + "/golden.txt");
+        if (!in) {
+            std::cout << "Failed to read " << directory << "/golden.txt\n";
+            return false;
+        }
+        std::string line;
+        for (int number = 1; std::getline(in, line); number++) {
+            line = line.substr(0, line.find('#'));
+            std::istringstream fields(line);
+            std::string keyword;
+            if (!(fields >> keyword))
+                continue;
+            Test test;
+            bool valid = false;
+            if (keyword == "size")
+                valid = (bool) (fields >> width >> height) && width >= SsimWindow && height >= SsimWindow;
+            else if (keyword == "test")
+                valid = (bool) (fields >> test.name >> test.time >> test.position.x >> test.position.y >> test.position.z
+                                >> test.target.x >> test.target.y >> test.target.z >> test.minSsim >> test.maxBadPixels);
+            if (!valid) {
+                std::cout << directory << "/golden.txt:" << number << ": can't read \"" << line << "\"\n";
+                return false;
+            }
+            if (keyword == "test")
+                m_Tests.push_back(test);
+        }
+        return !m_Tests.empty();
+    }
+
+    unsigned int size() const { return m_Tests.size(); }
+    const Test &test(unsigned int i) const { return m_Tests[i]; }
+
+    void placeCamera(unsigned int i, Camera &camera) const { camera.LookAt(m_Tests[i].position, m_Tests[i].target); }
+
+    // the rendered frame of test i, rows bottom up as read back
+    void setFrame(unsigned int i, const Image &frame) { m_Tests[i].frame = frame; }
+
+    // compares every frame with its golden, or writes the frames as the new goldens; prints a line
+    // per test and returns the number of failed ones
+    int check(JobSystem &jobSystem, bool update) {
+        // the goldens are stored top row first, the frames are bottom up
+        stbi_set_flip_vertically_on_load(true);
+        jobSystem.parallelFor(m_Tests.size(), 1, [this, update](unsigned int begin, unsigned int end) {
+            for (unsigned int i = begin; i < end; i++)
+                checkTest(m_Tests[i], update);
+        });
+        int failed = 0;
+        for (const Test &test : m_Tests) {
+            failed += test.passed ? 0 : 1;
+            std::cout << (test.passed ? "PASS " : "FAIL ") << std::left << std::setw(16) << test.name << std::right;
+            if (!test.error.empty())
+                std::cout << test.error;
+            else if (!update)
+                std::cout << std::fixed << std::setprecision(4) << "ssim " << test.difference.ssim << " (min "
+                          << test.minSsim << ", worst window " << test.difference.minSsim << "), bad pixels "
+                          << 100.0 * test.difference.badPixels << "% (max " << 100.0 * test.maxBadPixels
+                          << "%), max delta " << test.difference.maxDelta << std::defaultfloat << std::setprecision(6);
+            else
+                std::cout << "updated";
+            std::cout << '\n';
+        }
+        std::cout << "Golden images: " << m_Tests.size() - failed << " of " << m_Tests.size() << " passed\n";
+        return failed;
+    }
+
+private:
+    std::string m_Directory;
+    std::vector<Test> m_Tests;
+
+    std::string path(const Test &test, const char *suffix) const { return m_Directory + "/" + test.name + suffix; }
+
+    void checkTest(Test &test, bool update) const {
+        if (test.frame.pixels.empty()) {
+            test.error = "not rendered";
+            return;
+        }
+        if (update) {
+            test.passed = writePng(path(test, ".png"), test.frame.width, test.frame.height, test.frame.channels,
+                                   &test.frame.pixels[0], true);
+            if (!test.passed)
+                test.error = "can't write " + path(test, ".png");
+            return;
+        }
+
+        Image golden;
+        unsigned char *pixels = stbi_load(path(test, ".png").c_str(), &golden.width, &golden.height, NULL, 3);
+        if (pixels == NULL) {
+            test.error = "no golden " + path(test, ".png") + ", run with --golden-update";
+            return;
+        }
+        golden.pixels.assign(pixels, pixels + golden.width * golden.height * 3);
+        stbi_image_free(pixels);
+
+        std::vector<float> ssimMap;
+        test.difference = compareImages(test.frame, golden, &ssimMap);
+        test.passed = test.difference.ssim >= test.minSsim && test.difference.badPixels <= test.maxBadPixels;
+        if (test.passed)
+            return;
+        if (golden.width != test.frame.width || golden.height != test.frame.height)
+            test.error = "golden is " + std::to_string(golden.width) + "x" + std::to_string(golden.height) + ", frame is "
+                         + std::to_string(test.frame.width) + "x" + std::to_string(test.frame.height) + "; ";
+        writePng(path(test, ".actual.png"), test.frame.width, test.frame.height, test.frame.channels,
+                 &test.frame.pixels[0], true);
+        if (!ssimMap.empty()) {
+            std::vector<unsigned char> map(ssimMap.size());
+            for (unsigned int i = 0; i < ssimMap.size(); i++)
+                map[i] = (unsigned char) (255.0f * std::min(std::max(1.0f - ssimMap[i], 0.0f), 1.0f));
+            writePng(path(test, ".diff.png"), test.frame.width - SsimWindow + 1, test.frame.height - SsimWindow + 1, 1,
+                     &map[0], true);
+        }
+    }
+};
+
+}
+
+#endif //PROJECT_BASE_GOLDENIMAGES_H
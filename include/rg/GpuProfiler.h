@@ -0,0 +1,203 @@
+//
+// Per-pass GPU profiler. Scopes put a GL_TIMESTAMP query at their start and end, so unlike
+// GL_TIME_ELAPSED timers they can nest and can wrap passes that have their own GpuTimer.
+//
+// Queries go into FrameLatency sets used round robin; a frame's results are read when its set
+// comes around again, FrameLatency frames later. A frame whose results still aren't there is
+// dropped instead of waiting, so the profiler never stalls the pipeline. Software rasterizers like
+// llvmpipe answer immediately; a context without timestamp support (zero counter bits) leaves the
+// profiler disabled, all scopes then cost nothing.
+//
+// Every pass keeps the times of the last HistorySize profiled frames, summed when its name shows
+// up more than once in a frame.
+//
+
+#ifndef PROJECT_BASE_GPUPROFILER_H
+#define PROJECT_BASE_GPUPROFILER_H
+
+#include <glad/glad.h>
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+class GpuProfiler {
+public:
+    static const int FrameLatency = 3;
+    static const int MaxScopes = 64;
+    static const int HistorySize = 240;
+
+    struct PassHistory {
+        std::string name;
+        // nesting level of the scope when it first showed up
+        int depth;
+        // indexed by frame % HistorySize, 0 in frames the pass didn't run
+        std::vector<float> ms;
+    };
+
+    // times the enclosing block
+    class Scope {
+    public:
+        Scope(GpuProfiler &profiler, const std::string &name) : m_Profiler(profiler), m_Scope(profiler.begin(name)) {}
+        ~Scope() { m_Profiler.end(m_Scope); }
+
+    private:
+        GpuProfiler &m_Profiler;
+        int m_Scope;
+    };
+
+    GpuProfiler() {
+        GLint bits = 0;
+        glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+        m_Available = bits > 0;
+        if (!m_Available)
+            return;
+        for (FrameQueries &frame : m_Frames) {
+            glGenQueries(2 * MaxScopes, frame.queries);
+            frame.scopes.reserve(MaxScopes);
+        }
+    }
+
+    bool available() const { return m_Available; }
+
+    void beginFrame() {
+        m_Frame++;
+        FrameQueries &frame = m_Frames[m_Frame % FrameLatency];
+        if (frame.pending)
+            collect(frame);
+        frame.scopes.clear();
+        frame.frame = m_Frame;
+        m_Depth = 0;
+    }
+
+    void endFrame() {
+        m_Frames[m_Frame % FrameLatency].pending = m_Available;
+    }
+
+    // returns the scope to end, -1 when nothing is recorded
+    int begin(const std::string &name) {
+        FrameQueries &frame = m_Frames[m_Frame % FrameLatency];
+        if (!m_Available || frame.scopes.size() >= (size_t) MaxScopes) {
+            m_Depth++;
+            return -1;
+        }
+        int scope = frame.scopes.size();
+        frame.scopes.push_back(findPass(name, m_Depth));
+        m_Depth++;
+        glQueryCounter(frame.queries[2 * scope], GL_TIMESTAMP);
+        return scope;
+    }
+
+    void end(int scope) {
+        m_Depth--;
+        if (scope >= 0)
+            glQueryCounter(m_Frames[m_Frame % FrameLatency].queries[2 * scope + 1], GL_TIMESTAMP);
+    }
+
+    // passes in the order they first ran
+    const std::vector<PassHistory> &passes() const { return m_Passes; }
+    // slot in PassHistory::ms of the newest profiled frame, the oldest one follows it
+    int latestSlot() const { return m_LatestFrame % HistorySize; }
+    unsigned long long profiledFrames() const { return m_Profiled; }
+    unsigned long long droppedFrames() const { return m_Dropped; }
+
+    // average over the profiled frames in the history
+    float averageMs(const PassHistory &pass) const {
+        int count = 0;
+        float sum = 0.0f;
+        for (int i = 0; i < HistorySize; i++) {
+            if (m_SlotFrames[i] != 0) {
+                sum += pass.ms[i];
+                count++;
+            }
+        }
+        return count > 0 ? sum / count : 0.0f;
+    }
+
+    // one row per profiled frame in the history, one column per pass
+    void writeCsv(std::ostream &out) const {
+        out << "frame";
+        for (const PassHistory &pass : m_Passes)
+            out << ',' << pass.name;
+        out << '\n';
+        for (int i = 0; i < HistorySize; i++) {
+            int slot = (latestSlot() + 1 + i) % HistorySize;
+            if (m_SlotFrames[slot] == 0)
+                continue;
+            out << m_SlotFrames[slot];
+            for (const PassHistory &pass : m_Passes)
+                out << ',' << pass.ms[slot];
+            out << '\n';
+        }
+    }
+
+private:
+    struct FrameQueries {
+        GLuint queries[2 * MaxScopes];
+        // pass of every scope, in the order they began
+        std::vector<int> scopes;
+        unsigned long long frame = 0;
+        bool pending = false;
+    };
+
+    bool m_Available = false;
+    FrameQueries m_Frames[FrameLatency];
+    std::vector<PassHistory> m_Passes;
+    // frame number in every history slot, 0 for slots without a profiled frame
+    unsigned long long m_SlotFrames[HistorySize] = {};
+    unsigned long long m_Frame = 0;
+    unsigned long long m_LatestFrame = 0;
+    unsigned long long m_Profiled = 0;
+    unsigned long long m_Dropped = 0;
+    int m_Depth = 0;
+
+    int findPass(const std::string &name, int depth) {
+        for (unsigned int i = 0; i < m_Passes.size(); i++) {
+            if (m_Passes[i].name == name)
+                return i;
+        }
+        m_Passes.push_back({name, depth, std::vector<float>(HistorySize, 0.0f)});
+        return m_Passes.size() - 1;
+    }
+
+    void collect(FrameQueries &frame) {
+        frame.pending = false;
+        if (frame.scopes.empty())
+            return;
+        // outer scopes end after the ones nested in them, so every end has to be checked
+        for (unsigned int i = 0; i < frame.scopes.size(); i++) {
+            GLint available = 0;
+            glGetQueryObjectiv(frame.queries[2 * i + 1], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) {
+                m_Dropped++;
+                return;
+            }
+        }
+        // dropped frames since the last result leave empty slots
+        unsigned long long from = m_LatestFrame + 1;
+        if (frame.frame - from >= (unsigned long long) HistorySize)
+            from = frame.frame + 1 - HistorySize;
+        for (unsigned long long f = from; f <= frame.frame; f++) {
+            int slot = f % HistorySize;
+            m_SlotFrames[slot] = 0;
+            for (PassHistory &pass : m_Passes)
+                pass.ms[slot] = 0.0f;
+        }
+        int slot = frame.frame % HistorySize;
+        for (unsigned int i = 0; i < frame.scopes.size(); i++) {
+            GLuint64 start = 0, end = 0;
+            glGetQueryObjectui64v(frame.queries[2 * i], GL_QUERY_RESULT, &start);
+            glGetQueryObjectui64v(frame.queries[2 * i + 1], GL_QUERY_RESULT, &end);
+            m_Passes[frame.scopes[i]].ms[slot] += (end - start) / 1.0e6f;
+        }
+        m_SlotFrames[slot] = frame.frame;
+        m_LatestFrame = frame.frame;
+        m_Profiled++;
+    }
+};
+
+}
+
+#endif //PROJECT_BASE_GPUPROFILER_H
@@ -0,0 +1,157 @@
+//
+// GL_TIME_ELAPSED timer that never stalls: results are read back a few frames late from a
+// small ring of query objects, and a result that is still not available is dropped.
+//
+
+#ifndef PROJECT_BASE_GPUTIMER_H
+#define PROJECT_BASE_GPUTIMER_H
+
+#include <glad/glad.h>
+
+namespace rg {
+
+class GpuTimer {
+public:
+    static const int QueryCount = 4;
+
+    GpuTimer() {
+        glGenQueries(QueryCount, m_Queries);
+        for (int i = 0; i < QueryCount; i++)
+            m_Pending[i] = false;
+    }
+
+    void begin() {
+        if (m_Pending[m_Index])
+            collect(m_Index);
+        glBeginQuery(GL_TIME_ELAPSED, m_Queries[m_Index]);
+    }
+
+    void end() {
+        glEndQuery(GL_TIME_ELAPSED);
+        m_Pending[m_Index] = true;
+        m_Index = (m_Index + 1) % QueryCount;
+    }
+
+    // last result that came back, in milliseconds
+    double lastMs() const { return m_LastMs; }
+    // exponential moving average, smooths out the per frame noise for display
+    double averageMs() const { return m_AverageMs; }
+    unsigned int droppedResults() const { return m_Dropped; }
+
+private:
+    GLuint m_Queries[QueryCount];
+    bool m_Pending[QueryCount];
+    int m_Index = 0;
+    double m_LastMs = 0.0;
+    double m_AverageMs = 0.0;
+    unsigned int m_Dropped = 0;
+
+    void collect(int i) {
+        m_Pending[i] = false;
+        GLint available = 0;
+        glGetQueryObjectiv(m_Queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            m_Dropped++;
+            return;
+        }
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(m_Queries[i], GL_QUERY_RESULT, &ns);
+        m_LastMs = ns / 1.0e6;
+        m_AverageMs = m_AverageMs == 0.0 ? m_LastMs : m_AverageMs * 0.9 + m_LastMs * 0.1;
+    }
+};
+
+// GPU time between two GL_TIMESTAMP marks, with the same non-stalling ring as GpuTimer. Unlike
+// GL_TIME_ELAPSED queries these can enclose other timers, e.g. to time a whole frame.
+class GpuSpanTimer {
+public:
+    static const int QueryCount = 4;
+
+    GpuSpanTimer() {
+        glGenQueries(2 * QueryCount, m_Queries);
+        for (int i = 0; i < QueryCount; i++)
+            m_Pending[i] = false;
+    }
+
+    void begin() {
+        if (m_Pending[m_Index])
+            collect(m_Index);
+        glQueryCounter(m_Queries[2 * m_Index], GL_TIMESTAMP);
+    }
+
+    void end() {
+        glQueryCounter(m_Queries[2 * m_Index + 1], GL_TIMESTAMP);
+        m_Pending[m_Index] = true;
+        m_Index = (m_Index + 1) % QueryCount;
+    }
+
+    // last result that came back, in milliseconds
+    double lastMs() const { return m_LastMs; }
+    // counts the results that came back, a caller can tell a fresh result from the previous one
+    unsigned long long results() const { return m_Results; }
+
+private:
+    GLuint m_Queries[2 * QueryCount];
+    bool m_Pending[QueryCount];
+    int m_Index = 0;
+    double m_LastMs = 0.0;
+    unsigned long long m_Results = 0;
+
+    void collect(int i) {
+        m_Pending[i] = false;
+        GLint available = 0;
+        glGetQueryObjectiv(m_Queries[2 * i + 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            return;
+        GLuint64 start = 0, end = 0;
+        glGetQueryObjectui64v(m_Queries[2 * i], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(m_Queries[2 * i + 1], GL_QUERY_RESULT, &end);
+        m_LastMs = (end - start) / 1.0e6;
+        m_Results++;
+    }
+};
+
+// GL_SAMPLES_PASSED counter with the same non-stalling ring as GpuTimer, counts the fragments
+// that pass the depth test between begin() and end()
+class SampleCounter {
+public:
+    static const int QueryCount = 4;
+
+    SampleCounter() {
+        glGenQueries(QueryCount, m_Queries);
+        for (int i = 0; i < QueryCount; i++)
+            m_Pending[i] = false;
+    }
+
+    void begin() {
+        if (m_Pending[m_Index])
+            collect(m_Index);
+        glBeginQuery(GL_SAMPLES_PASSED, m_Queries[m_Index]);
+    }
+
+    void end() {
+        glEndQuery(GL_SAMPLES_PASSED);
+        m_Pending[m_Index] = true;
+        m_Index = (m_Index + 1) % QueryCount;
+    }
+
+    GLuint64 lastSamples() const { return m_LastSamples; }
+
+private:
+    GLuint m_Queries[QueryCount];
+    bool m_Pending[QueryCount];
+    int m_Index = 0;
+    GLuint64 m_LastSamples = 0;
+
+    void collect(int i) {
+        m_Pending[i] = false;
+        GLint available = 0;
+        glGetQueryObjectiv(m_Queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available)
+            glGetQueryObjectui64v(m_Queries[i], GL_QUERY_RESULT, &m_LastSamples);
+    }
+};
+
+}
+
+#endif //PROJECT_BASE_GPUTIMER_H
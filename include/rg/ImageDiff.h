@@ -0,0 +1,192 @@
+//
+// Perceptual comparison of two frames for the golden image tests. SSIM compares local structure
+// (mean, contrast and correlation of the luma in 8x8 windows) instead of single pixels, so the
+// small rounding differences between drivers score close to 1 while a missing shadow or a broken
+// texture drops it. The share of pixels with a channel off by more than BadPixelDelta catches
+// small but strong errors that the mean SSIM of a large frame would hide.
+//
+// The window sums are recomputed for every window (no running sums that drift in float): first
+// the sums over 8 rows of every column, then for every window the sum of its 8 columns. With AVX2
+// (checked at runtime) the windows are computed 8 side by side, the sums added in the same order
+// as the scalar loop; without it, GCC 12 at -O3 unrolls the 8 columns of the scalar loop and
+// vectorizes it over the windows with SSE, 4 at a time. -fopt-info-vec reports both row loops.
+//
+
+#ifndef PROJECT_BASE_IMAGEDIFF_H
+#define PROJECT_BASE_IMAGEDIFF_H
+
+#include <rg/PixelReadback.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define RG_IMAGEDIFF_AVX2 1
+#endif
+
+namespace rg {
+
+struct ImageDifference {
+    // mean SSIM over all windows, 1 for identical images
+    double ssim = 1.0;
+    // the worst window
+    double minSsim = 1.0;
+    // share of pixels with a channel off by more than BadPixelDelta
+    double badPixels = 0.0;
+    int maxDelta = 0;
+};
+
+const int SsimWindow = 8;
+const int BadPixelDelta = 16;
+
+namespace ssim {
+
+const float C1 = 0.01f * 0.01f, C2 = 0.03f * 0.03f;
+const float N = SsimWindow * SsimWindow;
+
+// row[wx] for the windows from first on, out of the column sums of their rows
+inline void windowRow(const float *sx, const float *sy, const float *sxx, const float *syy, const float *sxy,
+                      int first, int windowsX, float *row) {
+    for (int wx = first; wx < windowsX; wx++) {
+        float mx = 0.0f, my = 0.0f, mxx = 0.0f, myy = 0.0f, mxy = 0.0f;
+        for (int k = 0; k < SsimWindow; k++) {
+            mx += sx[wx + k];
+            my += sy[wx + k];
+            mxx += sxx[wx + k];
+            myy += syy[wx + k];
+            mxy += sxy[wx + k];
+        }
+        mx /= N;
+        my /= N;
+        // not clamped at 0: identical windows have to round the same way in all three
+        float vx = mxx / N - mx * mx;
+        float vy = myy / N - my * my;
+        float cov = mxy / N - mx * my;
+        row[wx] = (2.0f * mx * my + C1) * (2.0f * cov + C2) / ((mx * mx + my * my + C1) * (vx + vy + C2));
+    }
+}
+
+#ifdef RG_IMAGEDIFF_AVX2
+// the same operations in the same order as windowRow, 8 windows at a time; the windows left over
+// at the end of the row go through windowRow
+__attribute__((target("avx2"))) inline void windowRowAvx2(const float *sx, const float *sy, const float *sxx,
+                                                           const float *syy, const float *sxy, int windowsX,
+                                                           float *row) {
+    const __m256 c1 = _mm256_set1_ps(C1), c2 = _mm256_set1_ps(C2), n = _mm256_set1_ps(N);
+    const __m256 two = _mm256_set1_ps(2.0f);
+    int wx = 0;
+    for (; wx + 8 <= windowsX; wx += 8) {
+        __m256 mx = _mm256_loadu_ps(sx + wx), my = _mm256_loadu_ps(sy + wx);
+        __m256 mxx = _mm256_loadu_ps(sxx + wx), myy = _mm256_loadu_ps(syy + wx), mxy = _mm256_loadu_ps(sxy + wx);
+        for (int k = 1; k < SsimWindow; k++) {
+            mx = _mm256_add_ps(mx, _mm256_loadu_ps(sx + wx + k));
+            my = _mm256_add_ps(my, _mm256_loadu_ps(sy + wx + k));
+            mxx = _mm256_add_ps(mxx, _mm256_loadu_ps(sxx + wx + k));
+            myy = _mm256_add_ps(myy, _mm256_loadu_ps(syy + wx + k));
+            mxy = _mm256_add_ps(mxy, _mm256_loadu_ps(sxy + wx + k));
+        }
+        mx = _mm256_div_ps(mx, n);
+        my = _mm256_div_ps(my, n);
+        __m256 vx = _mm256_sub_ps(_mm256_div_ps(mxx, n), _mm256_mul_ps(mx, mx));
+        __m256 vy = _mm256_sub_ps(_mm256_div_ps(myy, n), _mm256_mul_ps(my, my));
+        __m256 cov = _mm256_sub_ps(_mm256_div_ps(mxy, n), _mm256_mul_ps(mx, my));
+        __m256 numerator = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(two, mx), my), c1),
+                                         _mm256_add_ps(_mm256_mul_ps(two, cov), c2));
+        __m256 denominator =
+                _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(mx, mx), _mm256_mul_ps(my, my)), c1),
+                              _mm256_add_ps(_mm256_add_ps(vx, vy), c2));
+        _mm256_storeu_ps(row + wx, _mm256_div_ps(numerator, denominator));
+    }
+    windowRow(sx, sy, sxx, syy, sxy, wx, windowsX, row);
+}
+#endif
+
+}
+
+// images of different sizes are completely different; ssimMap, when given, gets the SSIM of every
+// window, (width - 7) x (height - 7) values with rows in the order of the images
+inline ImageDifference compareImages(const Image &a, const Image &b, std::vector<float> *ssimMap = nullptr) {
+    ImageDifference result;
+    if (a.width != b.width || a.height != b.height || a.channels != b.channels || a.width < SsimWindow
+        || a.height < SsimWindow) {
+        result.ssim = result.minSsim = 0.0;
+        result.badPixels = 1.0;
+        return result;
+    }
+    int width = a.width, height = a.height, channels = a.channels;
+
+    unsigned long long bad = 0;
+    for (int i = 0; i < width * height; i++) {
+        int delta = 0;
+        for (int c = 0; c < channels; c++)
+            delta = std::max(delta, std::abs(a.pixels[i * channels + c] - b.pixels[i * channels + c]));
+        result.maxDelta = std::max(result.maxDelta, delta);
+        bad += delta > BadPixelDelta ? 1 : 0;
+    }
+    result.badPixels = (double) bad / (width * height);
+
+    // Rec. 601 luma in [0, 1]
+    std::vector<float> x(width * height), y(width * height);
+    const float weights[3] = {0.299f / 255.0f, 0.587f / 255.0f, 0.114f / 255.0f};
+    for (int i = 0; i < width * height; i++) {
+        if (channels >= 3) {
+            x[i] = a.pixels[i * channels] * weights[0] + a.pixels[i * channels + 1] * weights[1]
+                   + a.pixels[i * channels + 2] * weights[2];
+            y[i] = b.pixels[i * channels] * weights[0] + b.pixels[i * channels + 1] * weights[1]
+                   + b.pixels[i * channels + 2] * weights[2];
+        } else {
+            x[i] = a.pixels[i * channels] / 255.0f;
+            y[i] = b.pixels[i * channels] / 255.0f;
+        }
+    }
+
+    int windowsX = width - SsimWindow + 1, windowsY = height - SsimWindow + 1;
+    if (ssimMap != nullptr)
+        ssimMap->resize(windowsX * windowsY);
+    // sums over SsimWindow rows of every column, then over SsimWindow columns
+    std::vector<float> sx(width), sy(width), sxx(width), syy(width), sxy(width), row(windowsX);
+    double sum = 0.0;
+    float minimum = 1.0f;
+#ifdef RG_IMAGEDIFF_AVX2
+    const bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+    for (int wy = 0; wy < windowsY; wy++) {
+        std::fill(sx.begin(), sx.end(), 0.0f);
+        std::fill(sy.begin(), sy.end(), 0.0f);
+        std::fill(sxx.begin(), sxx.end(), 0.0f);
+        std::fill(syy.begin(), syy.end(), 0.0f);
+        std::fill(sxy.begin(), sxy.end(), 0.0f);
+        for (int r = wy; r < wy + SsimWindow; r++) {
+            const float *px = &x[r * width];
+            const float *py = &y[r * width];
+            for (int i = 0; i < width; i++) {
+                sx[i] += px[i];
+                sy[i] += py[i];
+                sxx[i] += px[i] * px[i];
+                syy[i] += py[i] * py[i];
+                sxy[i] += px[i] * py[i];
+            }
+        }
+#ifdef RG_IMAGEDIFF_AVX2
+        if (avx2)
+            ssim::windowRowAvx2(&sx[0], &sy[0], &sxx[0], &syy[0], &sxy[0], windowsX, &row[0]);
+        else
+#endif
+            ssim::windowRow(&sx[0], &sy[0], &sxx[0], &syy[0], &sxy[0], 0, windowsX, &row[0]);
+        for (int wx = 0; wx < windowsX; wx++) {
+            sum += row[wx];
+            minimum = std::min(minimum, row[wx]);
+        }
+        if (ssimMap != nullptr)
+            std::copy(row.begin(), row.end(), ssimMap->begin() + wy * windowsX);
+    }
+    result.ssim = sum / ((double) windowsX * windowsY);
+    result.minSsim = minimum;
+    return result;
+}
+
+}
+
+#endif //PROJECT_BASE_IMAGEDIFF_H
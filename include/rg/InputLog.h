@@ -0,0 +1,140 @@
+//
+// Recording of a session's input for reproducible runs (--record, --play). Every frame stores the
+// camera as it was rendered (position, yaw, pitch, zoom), the frame time, and the key events that
+// reached the program before it. Storing the camera instead of the raw mouse and keyboard input
+// makes the replay exact: it doesn't depend on frame times, and sets the camera to the same floats.
+// The rest of the program state isn't logged: recording and replay both start from the defaults,
+// and only the keys change modes in between (the ImGui window stays closed on both sides).
+//
+// The log is binary: a header (magic, version) followed by one record per frame, 29 bytes plus 4
+// per key event, in the byte order of the machine that wrote it.
+//
+
+#ifndef PROJECT_BASE_INPUTLOG_H
+#define PROJECT_BASE_INPUTLOG_H
+
+#include <learnopengl/camera.h>
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+struct InputFrame {
+    struct Key {
+        uint16_t key;
+        uint8_t action;
+        uint8_t mods;
+    };
+
+    // wall clock time of the recorded frame, the replay runs on a fixed timestep instead
+    float deltaTime;
+    float position[3];
+    float yaw;
+    float pitch;
+    float zoom;
+    std::vector<Key> keys;
+};
+
+static const char InputLogMagic[4] = {'R', 'G', 'I', 'L'};
+static const uint32_t InputLogVersion = 1;
+
+class InputRecorder {
+public:
+    // false when the file can't be created
+    bool open(const std::string &path) {
+        m_Out.open(path, std::ios::binary);
+        if (!m_Out)
+            return false;
+        m_Out.write(InputLogMagic, sizeof(InputLogMagic));
+        m_Out.write((const char *) &InputLogVersion, sizeof(InputLogVersion));
+        return (bool) m_Out;
+    }
+
+    bool recording() const { return m_Out.is_open(); }
+
+    // a key event from the window, stored with the next frame
+    void addKey(int key, int action, int mods) {
+        m_Keys.push_back({(uint16_t) key, (uint8_t) action, (uint8_t) mods});
+    }
+
+    void recordFrame(float deltaTime, const Camera &camera) {
+        if (!recording())
+            return;
+        // events past 255 in one frame can't be stored, they are left for the next one
+        uint8_t keyCount = m_Keys.size() < 255 ? m_Keys.size() : 255;
+        float values[7] = {deltaTime, camera.Position.x, camera.Position.y, camera.Position.z,
+                           camera.Yaw, camera.Pitch, camera.Zoom};
+        m_Out.write((const char *) values, sizeof(values));
+        m_Out.write((const char *) &keyCount, 1);
+        if (keyCount > 0)
+            m_Out.write((const char *) &m_Keys[0], keyCount * sizeof(InputFrame::Key));
+        m_Keys.erase(m_Keys.begin(), m_Keys.begin() + keyCount);
+        m_Frames++;
+    }
+
+    unsigned long long frames() const { return m_Frames; }
+
+private:
+    std::ofstream m_Out;
+    std::vector<InputFrame::Key> m_Keys;
+    unsigned long long m_Frames = 0;
+};
+
+class InputPlayback {
+public:
+    // false when the file can't be read or isn't an input log; a cut off last frame is dropped
+    bool load(const std::string &path) {
+        std::ifstream in(path, std::ios::binary);
+        char magic[4];
+        uint32_t version = 0;
+        in.read(magic, sizeof(magic));
+        in.read((char *) &version, sizeof(version));
+        if (!in || std::memcmp(magic, InputLogMagic, sizeof(magic)) != 0 || version != InputLogVersion)
+            return false;
+        m_Frames.clear();
+        InputFrame frame;
+        float values[7];
+        uint8_t keyCount;
+        while (in.read((char *) values, sizeof(values)) && in.read((char *) &keyCount, 1)) {
+            frame.deltaTime = values[0];
+            std::memcpy(frame.position, &values[1], 3 * sizeof(float));
+            frame.yaw = values[4];
+            frame.pitch = values[5];
+            frame.zoom = values[6];
+            frame.keys.resize(keyCount);
+            if (keyCount > 0 && !in.read((char *) &frame.keys[0], keyCount * sizeof(InputFrame::Key)))
+                break;
+            m_Frames.push_back(frame);
+        }
+        return true;
+    }
+
+    unsigned int frameCount() const { return m_Frames.size(); }
+    const InputFrame &frame(unsigned int i) const { return m_Frames[i]; }
+
+    // sets exactly the recorded camera
+    static void applyCamera(const InputFrame &frame, Camera &camera) {
+        camera.Position = glm::vec3(frame.position[0], frame.position[1], frame.position[2]);
+        camera.Zoom = frame.zoom;
+        camera.SetOrientation(frame.yaw, frame.pitch);
+    }
+
+    // average frame time of the recording
+    double recordedMs() const {
+        double sum = 0.0;
+        for (const InputFrame &frame : m_Frames)
+            sum += frame.deltaTime;
+        return m_Frames.empty() ? 0.0 : 1000.0 * sum / m_Frames.size();
+    }
+
+private:
+    std::vector<InputFrame> m_Frames;
+};
+
+}
+
+#endif //PROJECT_BASE_INPUTLOG_H
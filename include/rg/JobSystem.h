@@ -0,0 +1,119 @@
+//
+// Fixed pool of worker threads for data parallel CPU work inside a frame. parallelFor splits
+// [0, count) into chunks of `grain` items that the workers and the calling thread pull from a
+// shared counter, and returns once every chunk is done. Only one thread (the render thread)
+// may call parallelFor at a time.
+//
+
+#ifndef PROJECT_BASE_JOBSYSTEM_H
+#define PROJECT_BASE_JOBSYSTEM_H
+
+#include <rg/CpuProfiler.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rg {
+
+class JobSystem {
+public:
+    // 0 picks one worker less than there are hardware threads, the caller is the last one
+    explicit JobSystem(unsigned int workerCount = 0) {
+        if (workerCount == 0) {
+            unsigned int hardware = std::thread::hardware_concurrency();
+            workerCount = hardware > 1 ? hardware - 1 : 0;
+        }
+        for (unsigned int i = 0; i < workerCount; i++)
+            m_Workers.emplace_back([this] { workerLoop(); });
+    }
+
+    ~JobSystem() {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Quit = true;
+        }
+        m_WakeUp.notify_all();
+        for (std::thread &worker : m_Workers)
+            worker.join();
+    }
+
+    JobSystem(const JobSystem &) = delete;
+    JobSystem &operator=(const JobSystem &) = delete;
+
+    void parallelFor(unsigned int count, unsigned int grain, const std::function<void(unsigned int, unsigned int)> &job) {
+        if (count == 0)
+            return;
+        grain = std::max(grain, 1u);
+        if (m_Workers.empty() || count <= grain) {
+            job(0, count);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Job = &job;
+            m_Count = count;
+            m_Grain = grain;
+            m_Next = 0;
+            m_Active = m_Workers.size();
+            m_Generation++;
+        }
+        m_WakeUp.notify_all();
+        runChunks();
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_Done.wait(lock, [this] { return m_Active == 0; });
+        m_Job = nullptr;
+    }
+
+    // threads that take part in a parallelFor, including the caller
+    unsigned int threadCount() const { return m_Workers.size() + 1; }
+
+private:
+    std::vector<std::thread> m_Workers;
+    std::mutex m_Mutex;
+    std::condition_variable m_WakeUp;
+    std::condition_variable m_Done;
+    const std::function<void(unsigned int, unsigned int)> *m_Job = nullptr;
+    unsigned int m_Count = 0;
+    unsigned int m_Grain = 1;
+    std::atomic<unsigned int> m_Next{0};
+    unsigned int m_Active = 0;
+    unsigned int m_Generation = 0;
+    bool m_Quit = false;
+
+    void runChunks() {
+        for (;;) {
+            unsigned int begin = m_Next.fetch_add(m_Grain);
+            if (begin >= m_Count)
+                return;
+            CPU_ZONE("job chunk");
+            (*m_Job)(begin, std::min(begin + m_Grain, m_Count));
+        }
+    }
+
+    void workerLoop() {
+        CpuProfiler::setThreadName("job worker");
+        unsigned int seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(m_Mutex);
+                m_WakeUp.wait(lock, [&] { return m_Quit || m_Generation != seen; });
+                if (m_Quit)
+                    return;
+                seen = m_Generation;
+            }
+            runChunks();
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            if (--m_Active == 0)
+                m_Done.notify_one();
+        }
+    }
+};
+
+}
+
+#endif //PROJECT_BASE_JOBSYSTEM_H
@@ -0,0 +1,49 @@
+//
+// Memory use for benchmark reports: resident memory of the process and, where the driver tells,
+// video memory in use. Both return -1 when they can't be measured (other systems than Linux,
+// drivers without GL_NVX_gpu_memory_info such as Mesa).
+//
+
+#ifndef PROJECT_BASE_MEMORYSTATS_H
+#define PROJECT_BASE_MEMORYSTATS_H
+
+#include <glad/glad.h>
+#include <rg/GLExt.h>
+
+#include <fstream>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+#ifndef GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX
+#define GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX 0x9048
+#define GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX 0x9049
+#endif
+
+namespace rg {
+
+inline long long residentBytes() {
+#ifdef __linux__
+    // pages: total program size, then resident
+    std::ifstream statm("/proc/self/statm");
+    long long size = 0, resident = 0;
+    if (statm >> size >> resident)
+        return resident * sysconf(_SC_PAGESIZE);
+#endif
+    return -1;
+}
+
+// needs a current context; includes what other programs use
+inline long long gpuMemoryUsedBytes() {
+    if (!hasGLExtension("GL_NVX_gpu_memory_info"))
+        return -1;
+    GLint totalKb = 0, availableKb = 0;
+    glGetIntegerv(GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX, &totalKb);
+    glGetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, &availableKb);
+    return (long long) (totalKb - availableKb) * 1024;
+}
+
+}
+
+#endif //PROJECT_BASE_MEMORYSTATS_H
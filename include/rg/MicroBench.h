@@ -0,0 +1,239 @@
+//
+// A small microbenchmark harness for project_base_bench. Each benchmark is a function that runs
+// its operation a given number of times; the harness grows that number until one batch takes
+// long enough to time, then times `repeats` batches and keeps the median, minimum and maximum time
+// per operation. The calibration batches double as the warm-up.
+//
+// Benchmarks that need a GL context are marked and reported as skipped without one, so the CPU
+// ones run anywhere. Results are written as JSON and can be compared with an earlier run: an
+// operation that got slower than the threshold counts as a regression.
+//
+
+#ifndef PROJECT_BASE_MICROBENCH_H
+#define PROJECT_BASE_MICROBENCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+// keeps the compiler from dropping a computation whose result is otherwise unused
+template<typename T>
+inline void doNotOptimize(const T &value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+class MicroBench {
+public:
+    struct Settings {
+        // a timed batch takes at least this long, the operation runs as many times as needed
+        double batchMs = 50.0;
+        int repeats = 5;
+        // only benchmarks whose name contains it
+        std::string filter;
+    };
+
+    struct Result {
+        std::string name;
+        bool needsGL = false;
+        // why it didn't run, empty when it did
+        std::string skipped;
+        unsigned long long iterations = 0;
+        double medianNs = 0.0;
+        double minNs = 0.0;
+        double maxNs = 0.0;
+    };
+
+    // runs the operation `iterations` times
+    typedef std::function<void(unsigned long long iterations)> Body;
+
+    Settings settings;
+
+    void add(const std::string &name, const Body &body, bool needsGL = false) {
+        m_Benchmarks.push_back({name, body, needsGL, std::string()});
+    }
+
+    // a benchmark that can't run here, for example because its input file is missing
+    void skip(const std::string &name, const std::string &reason, bool needsGL = false) {
+        m_Benchmarks.push_back({name, Body(), needsGL, reason});
+    }
+
+    // shows up under "context" in the JSON
+    void addContext(const std::string &key, const std::string &value) { m_Context[key] = value; }
+
+    void run(bool haveGL) {
+        m_Results.clear();
+        for (const Benchmark &benchmark : m_Benchmarks) {
+            if (benchmark.name.find(settings.filter) == std::string::npos)
+                continue;
+            Result result;
+            result.name = benchmark.name;
+            result.needsGL = benchmark.needsGL;
+            if (!benchmark.skipped.empty())
+                result.skipped = benchmark.skipped;
+            else if (benchmark.needsGL && !haveGL)
+                result.skipped = "no GL context";
+            else
+                measure(benchmark.body, result);
+            print(result);
+            m_Results.push_back(result);
+        }
+    }
+
+    const std::vector<Result> &results() const { return m_Results; }
+
+    bool writeJson(const std::string &path) const {
+        std::ofstream out(path);
+        if (!out)
+            return false;
+        out << "{\n  \"context\": {";
+        bool first = true;
+        for (const auto &entry : m_Context) {
+            out << (first ? "\n" : ",\n") << "    \"" << escape(entry.first) << "\": \"" << escape(entry.second) << '"';
+            first = false;
+        }
+        out << "\n  },\n  \"benchmarks\": [";
+        for (unsigned int i = 0; i < m_Results.size(); i++) {
+            const Result &r = m_Results[i];
+            out << (i > 0 ? ",\n" : "\n") << "    {\"name\": \"" << escape(r.name) << "\", \"needs_gl\": "
+                << (r.needsGL ? "true" : "false");
+            if (!r.skipped.empty())
+                out << ", \"skipped\": \"" << escape(r.skipped) << '"';
+            else
+                out << ", \"iterations\": " << r.iterations << ", \"ns_per_op\": " << r.medianNs << ", \"min_ns\": "
+                    << r.minNs << ", \"max_ns\": " << r.maxNs;
+            out << '}';
+        }
+        out << "\n  ]\n}\n";
+        return (bool) out;
+    }
+
+    // prints the change of every benchmark that ran in both, returns the number that got slower
+    // by more than thresholdPercent, or -1 when the baseline can't be read
+    int compare(const std::string &baselinePath, double thresholdPercent) const {
+        std::map<std::string, double> baseline;
+        if (!readBaseline(baselinePath, baseline))
+            return -1;
+        int regressions = 0;
+        std::cout << "\nAgainst " << baselinePath << " (threshold " << thresholdPercent << "%):\n";
+        for (const Result &result : m_Results) {
+            auto found = baseline.find(result.name);
+            if (!result.skipped.empty() || found == baseline.end() || found->second <= 0.0)
+                continue;
+            double change = 100.0 * (result.medianNs - found->second) / found->second;
+            bool regression = change > thresholdPercent;
+            regressions += regression ? 1 : 0;
+            std::cout << "  " << std::left << std::setw(44) << result.name << std::right << std::setw(12)
+                      << formatNs(found->second) << " -> " << std::setw(12) << formatNs(result.medianNs) << std::showpos
+                      << std::fixed << std::setprecision(1) << std::setw(9) << change << '%' << std::noshowpos
+                      << std::defaultfloat << std::setprecision(6) << (regression ? "  REGRESSION" : "") << '\n';
+        }
+        return regressions;
+    }
+
+private:
+    struct Benchmark {
+        std::string name;
+        Body body;
+        bool needsGL;
+        std::string skipped;
+    };
+
+    std::vector<Benchmark> m_Benchmarks;
+    std::vector<Result> m_Results;
+    std::map<std::string, std::string> m_Context;
+
+    static double timeBatch(const Body &body, unsigned long long iterations) {
+        auto start = std::chrono::steady_clock::now();
+        body(iterations);
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void measure(const Body &body, Result &result) const {
+        // at most ten times more per step, so a slow operation doesn't overshoot by much
+        double targetNs = settings.batchMs * 1e6;
+        unsigned long long iterations = 1;
+        double ns = timeBatch(body, iterations);
+        while (ns < targetNs) {
+            double factor = ns > 0.0 ? std::min(1.2 * targetNs / ns, 10.0) : 10.0;
+            iterations = std::max(iterations + 1, (unsigned long long) (iterations * factor));
+            ns = timeBatch(body, iterations);
+        }
+        std::vector<double> perOp;
+        for (int i = 0; i < std::max(settings.repeats, 1); i++)
+            perOp.push_back(timeBatch(body, iterations) / iterations);
+        std::sort(perOp.begin(), perOp.end());
+        result.iterations = iterations;
+        result.medianNs = perOp[perOp.size() / 2];
+        result.minNs = perOp.front();
+        result.maxNs = perOp.back();
+    }
+
+    static void print(const Result &result) {
+        std::cout << std::left << std::setw(46) << result.name << std::right;
+        if (!result.skipped.empty())
+            std::cout << "skipped (" << result.skipped << ")\n";
+        else
+            std::cout << std::setw(12) << formatNs(result.medianNs) << "  (" << formatNs(result.minNs) << " .. "
+                      << formatNs(result.maxNs) << ", " << result.iterations << " per batch)\n";
+    }
+
+    static std::string formatNs(double ns) {
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(ns < 10.0 ? 2 : 1);
+        if (ns < 1e3)
+            out << ns << " ns";
+        else if (ns < 1e6)
+            out << ns / 1e3 << " us";
+        else
+            out << ns / 1e6 << " ms";
+        return out.str();
+    }
+
+    static std::string escape(const std::string &text) {
+        std::string escaped;
+        for (char c : text) {
+            if (c == '"' || c == '\\')
+                escaped += '\\';
+            escaped += c;
+        }
+        return escaped;
+    }
+
+    // the name and ns_per_op of every benchmark of a file written by writeJson
+    static bool readBaseline(const std::string &path, std::map<std::string, double> &baseline) {
+        std::ifstream in(path);
+        if (!in)
+            return false;
+        std::string line;
+        const std::string nameKey = "{\"name\": \"", timeKey = "\"ns_per_op\": ";
+        while (std::getline(in, line)) {
+            size_t name = line.find(nameKey);
+            size_t time = line.find(timeKey);
+            if (name == std::string::npos || time == std::string::npos)
+                continue;
+            name += nameKey.size();
+            std::string key;
+            for (size_t i = name; i < line.size() && line[i] != '"'; i++) {
+                if (line[i] == '\\' && i + 1 < line.size())
+                    i++;
+                key += line[i];
+            }
+            baseline[key] = std::strtod(line.c_str() + time + timeKey.size(), NULL);
+        }
+        return true;
+    }
+};
+
+}
+
+#endif //PROJECT_BASE_MICROBENCH_H
@@ -0,0 +1,288 @@
+//
+// Collects the opaque objects that share one program into a single glMultiDrawElementsIndirect.
+// All meshes live in one vertex/index buffer, per draw data (transform, material layer) is streamed
+// into an SSBO range every frame and the diffuse maps are copied into one texture array so nothing
+// has to be rebound between draws. Needs a GL 4.3 context, see rg::GLExt::hasMultiDrawIndirect().
+//
+
+#ifndef PROJECT_BASE_MULTIDRAWBATCH_H
+#define PROJECT_BASE_MULTIDRAWBATCH_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/model.h>
+#include <rg/DrawStats.h>
+#include <rg/GLExt.h>
+#include <rg/StreamBuffer.h>
+
+#include <map>
+#include <vector>
+
+namespace rg {
+
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLuint baseVertex;
+    GLuint baseInstance;
+};
+
+// std430 layout of DrawData in mdi.vs
+struct DrawData {
+    glm::mat4 model;
+    GLuint materialLayer;
+    GLuint lit;
+    GLuint padding[2];
+};
+
+class MultiDrawBatch {
+public:
+    // every material texture is resampled to this size when it is copied into the array
+    static const int MaterialLayerWidth = 2048;
+    static const int MaterialLayerHeight = 1024;
+
+    // every mesh of the model becomes one indirect draw that shares the object's transform
+    unsigned int addObject(Model &model, bool lit) {
+        Object object;
+        object.model = &model;
+        object.lit = lit;
+        m_Objects.push_back(object);
+        return m_Objects.size() - 1;
+    }
+
+    // has to be called once after all objects were added
+    void build() {
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+        std::map<Model *, unsigned int> firstRange;
+        std::vector<MeshRange> ranges;
+        // GL texture id -> array layer, layer 0 is plain white for meshes without a diffuse map
+        std::map<unsigned int, unsigned int> layers;
+        std::vector<unsigned int> layerTextures(1, 0);
+
+        for (Object &object : m_Objects) {
+            if (firstRange.find(object.model) == firstRange.end()) {
+                firstRange[object.model] = ranges.size();
+                // Mesh::Draw leaves texture unit 0 alone for a mesh without maps, so on the per-mesh
+                // path it samples the map of the mesh drawn before it (the earth's atmosphere and
+                // clouds show the earth); the batch does the same within a model
+                unsigned int previousLayer = 0;
+                for (Mesh &mesh : object.model->meshes) {
+                    MeshRange range;
+                    range.count = mesh.indices.size();
+                    range.firstIndex = indices.size();
+                    range.baseVertex = vertices.size();
+                    range.layer = previousLayer;
+                    for (Texture &texture : mesh.textures) {
+                        if (texture.type != "texture_diffuse")
+                            continue;
+                        if (layers.find(texture.id) == layers.end()) {
+                            layers[texture.id] = layerTextures.size();
+                            layerTextures.push_back(texture.id);
+                        }
+                        range.layer = layers[texture.id];
+                        break;
+                    }
+                    previousLayer = range.layer;
+                    ranges.push_back(range);
+                    vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+                    indices.insert(indices.end(), mesh.indices.begin(), mesh.indices.end());
+                }
+            }
+
+            object.firstDraw = m_Commands.size();
+            object.drawCount = object.model->meshes.size();
+            for (unsigned int i = 0; i < object.drawCount; i++) {
+                const MeshRange &range = ranges[firstRange[object.model] + i];
+                DrawElementsIndirectCommand command;
+                command.count = range.count;
+                command.instanceCount = 1;
+                command.firstIndex = range.firstIndex;
+                command.baseVertex = range.baseVertex;
+                // the draw id vertex attribute has divisor 1, so baseInstance selects this draw's DrawData
+                command.baseInstance = m_Commands.size();
+                m_Commands.push_back(command);
+                m_Triangles += range.count / 3;
+
+                DrawData data;
+                data.model = glm::mat4(1.0f);
+                data.materialLayer = range.layer;
+                data.lit = object.lit ? 1 : 0;
+                data.padding[0] = data.padding[1] = 0;
+                m_DrawData.push_back(data);
+            }
+        }
+
+        setupBuffers(vertices, indices);
+        setupMaterialArray(layerTextures);
+    }
+
+    void setTransform(unsigned int object, const glm::mat4 &model) {
+        const Object &o = m_Objects[object];
+        for (unsigned int i = 0; i < o.drawCount; i++)
+            m_DrawData[o.firstDraw + i].model = model;
+    }
+
+    // the program has to be in use, its materialMaps sampler is expected on texture unit 0
+    void Draw(StreamBuffer &stream) {
+        if (m_Commands.empty())
+            return;
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, m_MaterialArray);
+        drawIndirect(stream, m_VAO);
+    }
+
+    // for depth-only programs like mdi_depth.vs: the same draws from the tightly packed positions
+    void DrawDepth(StreamBuffer &stream) {
+        if (m_Commands.empty())
+            return;
+        drawIndirect(stream, m_DepthVAO);
+    }
+
+    unsigned int drawCount() const { return m_Commands.size(); }
+
+private:
+    struct Object {
+        Model *model;
+        bool lit;
+        unsigned int firstDraw = 0;
+        unsigned int drawCount = 0;
+    };
+    struct MeshRange {
+        unsigned int count;
+        unsigned int firstIndex;
+        unsigned int baseVertex;
+        unsigned int layer;
+    };
+
+    std::vector<Object> m_Objects;
+    std::vector<DrawElementsIndirectCommand> m_Commands;
+    std::vector<DrawData> m_DrawData;
+
+    unsigned int m_VAO = 0, m_VBO = 0, m_EBO = 0, m_DrawIdBuffer = 0;
+    // positions only, with the same index, draw id and indirect buffers
+    unsigned int m_DepthVAO = 0, m_DepthVBO = 0;
+    unsigned int m_IndirectBuffer = 0;
+    unsigned long long m_Triangles = 0;
+    unsigned int m_MaterialArray = 0;
+    GLint m_StorageAlignment = 16;
+
+    void drawIndirect(StreamBuffer &stream, unsigned int vao) {
+        GLsizeiptr size = m_DrawData.size() * sizeof(DrawData);
+        GLintptr offset = stream.upload(&m_DrawData[0], size, m_StorageAlignment);
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, stream.buffer(), offset, size);
+
+        glBindVertexArray(vao);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_IndirectBuffer);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, 0, m_Commands.size(), 0);
+        countDraw(m_Triangles);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        glBindVertexArray(0);
+    }
+
+    void setupBuffers(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices) {
+        if (m_Commands.empty())
+            return;
+        std::vector<GLuint> drawIds(m_Commands.size());
+        for (unsigned int i = 0; i < drawIds.size(); i++)
+            drawIds[i] = i;
+
+        glGenVertexArrays(1, &m_VAO);
+        glGenBuffers(1, &m_VBO);
+        glGenBuffers(1, &m_EBO);
+        glGenBuffers(1, &m_DrawIdBuffer);
+        glGenBuffers(1, &m_IndirectBuffer);
+
+        glBindVertexArray(m_VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+
+        // same attribute locations as Mesh::setupMesh, only what the shaders read
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+
+        // draw id, advanced once per instance and offset by baseInstance (gl_DrawID needs GL 4.6)
+        glBindBuffer(GL_ARRAY_BUFFER, m_DrawIdBuffer);
+        glBufferData(GL_ARRAY_BUFFER, drawIds.size() * sizeof(GLuint), &drawIds[0], GL_STATIC_DRAW);
+        glEnableVertexAttribArray(5);
+        glVertexAttribIPointer(5, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+        glVertexAttribDivisor(5, 1);
+        glBindVertexArray(0);
+
+        // tightly packed positions for the depth pre-pass, like Mesh::depthVAO
+        std::vector<glm::vec3> positions(vertices.size());
+        for (unsigned int i = 0; i < vertices.size(); i++)
+            positions[i] = vertices[i].Position;
+        glGenVertexArrays(1, &m_DepthVAO);
+        glGenBuffers(1, &m_DepthVBO);
+        glBindVertexArray(m_DepthVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, m_DepthVBO);
+        glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), positions.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+        glBindBuffer(GL_ARRAY_BUFFER, m_DrawIdBuffer);
+        glEnableVertexAttribArray(5);
+        glVertexAttribIPointer(5, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+        glVertexAttribDivisor(5, 1);
+        glBindVertexArray(0);
+
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_IndirectBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, m_Commands.size() * sizeof(DrawElementsIndirectCommand), &m_Commands[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &m_StorageAlignment);
+    }
+
+    void setupMaterialArray(const std::vector<unsigned int> &layerTextures) {
+        glGenTextures(1, &m_MaterialArray);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, m_MaterialArray);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, MaterialLayerWidth, MaterialLayerHeight, layerTextures.size(),
+                     0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+        // copy every diffuse map into its layer with a scaling blit
+        unsigned int framebuffers[2];
+        glGenFramebuffers(2, framebuffers);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffers[0]);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffers[1]);
+        for (unsigned int layer = 0; layer < layerTextures.size(); layer++) {
+            glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_MaterialArray, 0, layer);
+            GLint width = 0, height = 0;
+            if (layer > 0) {
+                glBindTexture(GL_TEXTURE_2D, layerTextures[layer]);
+                glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+                glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+            }
+            // a map that failed to load has no image and samples as black on the per-mesh path
+            if (width == 0 || height == 0) {
+                const GLfloat white[] = {1.0f, 1.0f, 1.0f, 1.0f}, black[] = {0.0f, 0.0f, 0.0f, 1.0f};
+                glClearBufferfv(GL_COLOR, 0, layer == 0 ? white : black);
+                continue;
+            }
+            glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, layerTextures[layer], 0);
+            glBlitFramebuffer(0, 0, width, height, 0, 0, MaterialLayerWidth, MaterialLayerHeight,
+                              GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(2, framebuffers);
+
+        glBindTexture(GL_TEXTURE_2D_ARRAY, m_MaterialArray);
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+};
+
+}
+
+#endif //PROJECT_BASE_MULTIDRAWBATCH_H
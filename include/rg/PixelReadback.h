@@ -0,0 +1,142 @@
+//
+// Asynchronous readback of rendered frames through a ring of pixel buffer objects. glReadPixels
+// into a bound GL_PIXEL_PACK_BUFFER only queues the copy, a fence marks when it is done, and the
+// buffer is mapped frames later when the fence has signaled, so the CPU never waits for the GPU
+// to finish the frame it just submitted. Only when every buffer of the ring is still in flight
+// does a new request wait for the oldest one; stalls() counts those waits.
+//
+// The pixels are RGB, 8 bit, rows bottom up as glReadPixels returns them. Like the other GL
+// wrappers it has no destructor, release() deletes the buffers while the context is current.
+//
+
+#ifndef PROJECT_BASE_PIXELREADBACK_H
+#define PROJECT_BASE_PIXELREADBACK_H
+
+#include <glad/glad.h>
+
+#include <cstring>
+#include <functional>
+#include <vector>
+
+namespace rg {
+
+struct Image {
+    int width = 0;
+    int height = 0;
+    int channels = 3;
+    std::vector<unsigned char> pixels;
+};
+
+class PixelReadback {
+public:
+    // gets the image and the tag it was requested with, in request order
+    typedef std::function<void(unsigned long long tag, Image &image)> Handler;
+
+    explicit PixelReadback(unsigned int ringSize = 3) : m_Slots(ringSize < 1 ? 1 : ringSize) {}
+
+    // queues a copy of the first color attachment of framebuffer (0 for the back buffer)
+    void request(GLuint framebuffer, int width, int height, unsigned long long tag, const Handler &handler) {
+        Slot &slot = m_Slots[m_Next];
+        if (slot.fence != 0) {
+            m_Stalls++;
+            resolve(slot, true, handler);
+        }
+        if (slot.buffer == 0)
+            glGenBuffers(1, &slot.buffer);
+        GLsizeiptr size = (GLsizeiptr) width * height * 3;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        if (size != slot.size) {
+            glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+            slot.size = size;
+        }
+        GLint previousFramebuffer = 0;
+        glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousFramebuffer);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glReadBuffer(framebuffer == 0 ? GL_BACK : GL_COLOR_ATTACHMENT0);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, previousFramebuffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        slot.width = width;
+        slot.height = height;
+        slot.tag = tag;
+        m_Next = (m_Next + 1) % m_Slots.size();
+    }
+
+    // hands over the copies that are done, without waiting
+    void poll(const Handler &handler) {
+        for (unsigned int i = 0; i < m_Slots.size(); i++) {
+            Slot &slot = m_Slots[(m_Next + i) % m_Slots.size()];
+            // a later copy can't be done before an earlier one
+            if (slot.fence != 0 && !resolve(slot, false, handler))
+                break;
+        }
+    }
+
+    // waits for every copy in flight
+    void finish(const Handler &handler) {
+        for (unsigned int i = 0; i < m_Slots.size(); i++) {
+            Slot &slot = m_Slots[(m_Next + i) % m_Slots.size()];
+            if (slot.fence != 0)
+                resolve(slot, true, handler);
+        }
+    }
+
+    unsigned long long stalls() const { return m_Stalls; }
+
+    void release() {
+        for (Slot &slot : m_Slots) {
+            if (slot.fence != 0)
+                glDeleteSync(slot.fence);
+            if (slot.buffer != 0)
+                glDeleteBuffers(1, &slot.buffer);
+            slot = Slot();
+        }
+    }
+
+private:
+    struct Slot {
+        GLuint buffer = 0;
+        GLsizeiptr size = 0;
+        GLsync fence = 0;
+        int width = 0;
+        int height = 0;
+        unsigned long long tag = 0;
+    };
+
+    std::vector<Slot> m_Slots;
+    unsigned int m_Next = 0;
+    unsigned long long m_Stalls = 0;
+    Image m_Image;
+
+    bool resolve(Slot &slot, bool wait, const Handler &handler) {
+        GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        while (wait && status == GL_TIMEOUT_EXPIRED)
+            status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        if (status == GL_TIMEOUT_EXPIRED)
+            return false;
+        glDeleteSync(slot.fence);
+        slot.fence = 0;
+
+        m_Image.width = slot.width;
+        m_Image.height = slot.height;
+        m_Image.channels = 3;
+        m_Image.pixels.resize(slot.size);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        void *data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, slot.size, GL_MAP_READ_BIT);
+        if (data != NULL) {
+            std::memcpy(&m_Image.pixels[0], data, slot.size);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        if (data != NULL)
+            handler(slot.tag, m_Image);
+        return true;
+    }
+};
+
+}
+
+#endif //PROJECT_BASE_PIXELREADBACK_H
@@ -0,0 +1,416 @@
+//
+// Minimal PNG writer for captured frames: 8 bit gray, RGB or RGBA. Every row gets the filter
+// with the smallest sum of absolute differences and the rows are compressed with a small
+// deflate (greedy LZ77 over a hash chain, dynamic Huffman blocks), so no zlib is needed.
+// Rendered frames come out at a fraction of the raw size; stb_image and every viewer read them.
+//
+
+#ifndef PROJECT_BASE_PNGWRITER_H
+#define PROJECT_BASE_PNGWRITER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace rg {
+
+namespace png {
+
+inline uint32_t crc32(const unsigned char *data, size_t size, uint32_t crc = 0) {
+    // built once, also when several threads write at the same time
+    struct Table {
+        uint32_t entries[256];
+
+        Table() {
+            for (uint32_t n = 0; n < 256; n++) {
+                uint32_t c = n;
+                for (int k = 0; k < 8; k++)
+                    c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                entries[n] = c;
+            }
+        }
+    };
+    static const Table table;
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++)
+        crc = table.entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+inline void putBigEndian(std::vector<unsigned char> &out, uint32_t value) {
+    for (int shift = 24; shift >= 0; shift -= 8)
+        out.push_back((unsigned char) (value >> shift));
+}
+
+inline void writeChunk(std::ostream &out, const char *type, const std::vector<unsigned char> &data) {
+    std::vector<unsigned char> chunk;
+    putBigEndian(chunk, data.size());
+    chunk.insert(chunk.end(), type, type + 4);
+    chunk.insert(chunk.end(), data.begin(), data.end());
+    putBigEndian(chunk, crc32(&chunk[4], chunk.size() - 4));
+    out.write((const char *) &chunk[0], chunk.size());
+}
+
+// bits are packed starting at the least significant one, Huffman codes are reversed first
+struct BitWriter {
+    std::vector<unsigned char> &out;
+    uint32_t bits = 0;
+    int count = 0;
+
+    explicit BitWriter(std::vector<unsigned char> &out) : out(out) {}
+
+    void put(uint32_t value, int size) {
+        bits |= value << count;
+        count += size;
+        while (count >= 8) {
+            out.push_back((unsigned char) bits);
+            bits >>= 8;
+            count -= 8;
+        }
+    }
+
+    void flush() {
+        if (count > 0)
+            out.push_back((unsigned char) bits);
+        bits = 0;
+        count = 0;
+    }
+};
+
+static const uint16_t LengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83,
+                                        99, 115, 131, 163, 195, 227, 258};
+static const unsigned char LengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4,
+                                              5, 5, 5, 5, 0};
+static const uint16_t DistanceBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513,
+                                          769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const unsigned char DistanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10,
+                                                10, 11, 11, 12, 12, 13, 13};
+static const unsigned char CodeLengthOrder[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+// a literal byte when distance is 0, otherwise a match
+struct Token {
+    uint16_t length;
+    uint16_t distance;
+};
+
+inline std::vector<Token> lz77(const std::vector<unsigned char> &data) {
+    const int WindowSize = 32768, HashSize = 1 << 15, MaxChain = 64, MinMatch = 3, MaxMatch = 258;
+    std::vector<int> head(HashSize, -1), previous(WindowSize, -1);
+    auto hash = [&data](size_t i) { return ((data[i] << 10) ^ (data[i + 1] << 5) ^ data[i + 2]) & (HashSize - 1); };
+    auto insert = [&](size_t i) {
+        if (i + MinMatch > data.size())
+            return;
+        int h = hash(i);
+        previous[i & (WindowSize - 1)] = head[h];
+        head[h] = (int) i;
+    };
+
+    std::vector<Token> tokens;
+    tokens.reserve(data.size() / 2);
+    size_t i = 0;
+    while (i < data.size()) {
+        int bestLength = 0, bestDistance = 0;
+        if (i + MinMatch <= data.size()) {
+            int maxLength = (int) std::min<size_t>(MaxMatch, data.size() - i);
+            int limit = (int) i - WindowSize;
+            int candidate = head[hash(i)];
+            for (int chain = 0; candidate > limit && candidate >= 0 && chain < MaxChain; chain++) {
+                const unsigned char *a = &data[candidate], *b = &data[i];
+                if (a[bestLength] == b[bestLength]) {
+                    int length = 0;
+                    while (length < maxLength && a[length] == b[length])
+                        length++;
+                    if (length > bestLength) {
+                        bestLength = length;
+                        bestDistance = (int) i - candidate;
+                        if (length == maxLength)
+                            break;
+                    }
+                }
+                int next = previous[candidate & (WindowSize - 1)];
+                if (next >= candidate)
+                    break;
+                candidate = next;
+            }
+        }
+        if (bestLength >= MinMatch) {
+            tokens.push_back({(uint16_t) bestLength, (uint16_t) bestDistance});
+            for (int k = 0; k < bestLength; k++)
+                insert(i + k);
+            i += bestLength;
+        } else {
+            tokens.push_back({data[i], 0});
+            insert(i);
+            i++;
+        }
+    }
+    return tokens;
+}
+
+// code lengths of a Huffman code for the frequencies, none longer than maxBits; at least two symbols
+// get a code so that the code is complete, also for blocks that use one distance or none
+inline std::vector<unsigned char> huffmanLengths(std::vector<uint32_t> frequencies, int maxBits) {
+    size_t used = std::count_if(frequencies.begin(), frequencies.end(), [](uint32_t f) { return f > 0; });
+    for (size_t s = 0; s < frequencies.size() && used < 2; s++)
+        if (frequencies[s] == 0) {
+            frequencies[s] = 1;
+            used++;
+        }
+
+    std::vector<unsigned char> lengths(frequencies.size());
+    while (true) {
+        // nodes past the symbols are the merged ones, every node knows its parent
+        std::vector<int> parent(frequencies.size(), -1);
+        typedef std::pair<uint64_t, int> Entry;
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+        for (size_t s = 0; s < frequencies.size(); s++)
+            if (frequencies[s] > 0)
+                queue.push(Entry(frequencies[s], (int) s));
+        while (queue.size() > 1) {
+            Entry a = queue.top();
+            queue.pop();
+            Entry b = queue.top();
+            queue.pop();
+            int node = (int) parent.size();
+            parent.push_back(-1);
+            parent[a.second] = parent[b.second] = node;
+            queue.push(Entry(a.first + b.first, node));
+        }
+
+        int longest = 0;
+        for (size_t s = 0; s < frequencies.size(); s++) {
+            int depth = 0;
+            if (frequencies[s] > 0)
+                for (int node = (int) s; parent[node] >= 0; node = parent[node])
+                    depth++;
+            lengths[s] = (unsigned char) depth;
+            longest = std::max(longest, depth);
+        }
+        if (longest <= maxBits)
+            return lengths;
+        // flatten the frequencies until the tree is shallow enough
+        for (uint32_t &frequency : frequencies)
+            if (frequency > 0)
+                frequency = (frequency >> 1) | 1;
+    }
+}
+
+// canonical codes for the lengths, already bit reversed for BitWriter
+inline std::vector<uint16_t> huffmanCodes(const std::vector<unsigned char> &lengths) {
+    uint16_t counts[16] = {0}, next[16] = {0};
+    for (unsigned char length : lengths)
+        counts[length]++;
+    counts[0] = 0;
+    for (int bits = 1, code = 0; bits < 16; bits++) {
+        code = (code + counts[bits - 1]) << 1;
+        next[bits] = (uint16_t) code;
+    }
+    std::vector<uint16_t> codes(lengths.size());
+    for (size_t s = 0; s < lengths.size(); s++) {
+        if (lengths[s] == 0)
+            continue;
+        uint16_t code = next[lengths[s]]++, reversed = 0;
+        for (int bit = 0; bit < lengths[s]; bit++)
+            reversed |= ((code >> bit) & 1) << (lengths[s] - 1 - bit);
+        codes[s] = reversed;
+    }
+    return codes;
+}
+
+inline int lengthSymbol(int length) {
+    return (int) (std::upper_bound(LengthBase, LengthBase + 29, length) - LengthBase) - 1;
+}
+
+inline int distanceSymbol(int distance) {
+    return (int) (std::upper_bound(DistanceBase, DistanceBase + 30, distance) - DistanceBase) - 1;
+}
+
+// one dynamic Huffman block (BTYPE 2) for the tokens
+inline void writeBlock(BitWriter &bits, const Token *tokens, size_t count, bool last) {
+    std::vector<uint32_t> literalFrequencies(286), distanceFrequencies(30);
+    for (size_t t = 0; t < count; t++) {
+        if (tokens[t].distance == 0) {
+            literalFrequencies[tokens[t].length]++;
+        } else {
+            literalFrequencies[257 + lengthSymbol(tokens[t].length)]++;
+            distanceFrequencies[distanceSymbol(tokens[t].distance)]++;
+        }
+    }
+    literalFrequencies[256] = 1;
+    std::vector<unsigned char> literalLengths = huffmanLengths(literalFrequencies, 15);
+    std::vector<unsigned char> distanceLengths = huffmanLengths(distanceFrequencies, 15);
+    int literalCount = 286, distanceCount = 30;
+    while (literalCount > 257 && literalLengths[literalCount - 1] == 0)
+        literalCount--;
+    while (distanceCount > 1 && distanceLengths[distanceCount - 1] == 0)
+        distanceCount--;
+
+    // both length tables as one sequence, with runs as symbols 16 (repeat previous), 17 and 18 (zeros)
+    std::vector<unsigned char> all(literalLengths.begin(), literalLengths.begin() + literalCount);
+    all.insert(all.end(), distanceLengths.begin(), distanceLengths.begin() + distanceCount);
+    std::vector<std::pair<int, int>> runs;
+    std::vector<uint32_t> codeLengthFrequencies(19);
+    for (size_t i = 0; i < all.size();) {
+        size_t run = 1;
+        while (i + run < all.size() && all[i + run] == all[i])
+            run++;
+        if (all[i] == 0 && run >= 3) {
+            run = std::min<size_t>(run, 138);
+            runs.push_back(run >= 11 ? std::make_pair(18, (int) run - 11) : std::make_pair(17, (int) run - 3));
+        } else if (all[i] != 0 && run >= 4) {
+            run = std::min<size_t>(run, 7);
+            runs.push_back(std::make_pair((int) all[i], 0));
+            runs.push_back(std::make_pair(16, (int) run - 4));
+        } else {
+            run = 1;
+            runs.push_back(std::make_pair((int) all[i], 0));
+        }
+        i += run;
+    }
+    for (const std::pair<int, int> &run : runs)
+        codeLengthFrequencies[run.first]++;
+    std::vector<unsigned char> codeLengthLengths = huffmanLengths(codeLengthFrequencies, 7);
+    std::vector<uint16_t> codeLengthCodes = huffmanCodes(codeLengthLengths);
+    int codeLengthCount = 19;
+    while (codeLengthCount > 4 && codeLengthLengths[CodeLengthOrder[codeLengthCount - 1]] == 0)
+        codeLengthCount--;
+
+    bits.put(last ? 1 : 0, 1);
+    bits.put(2, 2);
+    bits.put(literalCount - 257, 5);
+    bits.put(distanceCount - 1, 5);
+    bits.put(codeLengthCount - 4, 4);
+    for (int i = 0; i < codeLengthCount; i++)
+        bits.put(codeLengthLengths[CodeLengthOrder[i]], 3);
+    static const int RunExtra[3] = {2, 3, 7};
+    for (const std::pair<int, int> &run : runs) {
+        bits.put(codeLengthCodes[run.first], codeLengthLengths[run.first]);
+        if (run.first >= 16)
+            bits.put(run.second, RunExtra[run.first - 16]);
+    }
+
+    std::vector<uint16_t> literalCodes = huffmanCodes(literalLengths);
+    std::vector<uint16_t> distanceCodes = huffmanCodes(distanceLengths);
+    for (size_t t = 0; t < count; t++) {
+        const Token &token = tokens[t];
+        if (token.distance == 0) {
+            bits.put(literalCodes[token.length], literalLengths[token.length]);
+            continue;
+        }
+        int length = lengthSymbol(token.length), distance = distanceSymbol(token.distance);
+        bits.put(literalCodes[257 + length], literalLengths[257 + length]);
+        bits.put(token.length - LengthBase[length], LengthExtra[length]);
+        bits.put(distanceCodes[distance], distanceLengths[distance]);
+        bits.put(token.distance - DistanceBase[distance], DistanceExtra[distance]);
+    }
+    bits.put(literalCodes[256], literalLengths[256]);
+}
+
+// zlib stream of the data: deflate blocks of up to 64K tokens, each with its own codes, and the Adler-32
+inline std::vector<unsigned char> zlibCompress(const std::vector<unsigned char> &data) {
+    const size_t BlockTokens = 1 << 16;
+    std::vector<unsigned char> out = {0x78, 0x9c};
+    std::vector<Token> tokens = lz77(data);
+    BitWriter bits(out);
+    size_t offset = 0;
+    do {
+        size_t count = std::min(BlockTokens, tokens.size() - offset);
+        writeBlock(bits, tokens.data() + offset, count, offset + count == tokens.size());
+        offset += count;
+    } while (offset < tokens.size());
+    bits.flush();
+
+    uint32_t a = 1, b = 0;
+    for (unsigned char byte : data) {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    putBigEndian(out, (b << 16) | a);
+    return out;
+}
+
+// row filter 0-4 of PNG; the filtered row is written to out, previous is all zero for the top row
+inline void filterRow(int type, const unsigned char *row, const unsigned char *previous, size_t size, int channels,
+                      unsigned char *out) {
+    for (size_t i = 0; i < size; i++) {
+        int left = i >= (size_t) channels ? row[i - channels] : 0;
+        int up = previous[i];
+        int upLeft = i >= (size_t) channels ? previous[i - channels] : 0;
+        int predictor = 0;
+        switch (type) {
+            case 1: predictor = left; break;
+            case 2: predictor = up; break;
+            case 3: predictor = (left + up) / 2; break;
+            case 4: {
+                int p = left + up - upLeft;
+                int pa = std::abs(p - left), pb = std::abs(p - up), pc = std::abs(p - upLeft);
+                predictor = pa <= pb && pa <= pc ? left : pb <= pc ? up : upLeft;
+                break;
+            }
+            default: break;
+        }
+        out[i] = (unsigned char) (row[i] - predictor);
+    }
+}
+
+}
+
+// pixels are rows of width * channels bytes; bottomUp for rows in the order glReadPixels returns
+// them, the file is always written top row first. False when the file can't be written.
+inline bool writePng(const std::string &path, int width, int height, int channels, const unsigned char *pixels,
+                     bool bottomUp) {
+    static const unsigned char colorTypes[5] = {0, 0, 4, 2, 6};
+    if (channels < 1 || channels > 4 || width <= 0 || height <= 0)
+        return false;
+    std::ofstream out(path, std::ios::binary);
+    if (!out)
+        return false;
+    static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    out.write((const char *) signature, sizeof(signature));
+
+    std::vector<unsigned char> header;
+    png::putBigEndian(header, width);
+    png::putBigEndian(header, height);
+    header.push_back(8);
+    header.push_back(colorTypes[channels]);
+    header.push_back(0);
+    header.push_back(0);
+    header.push_back(0);
+    png::writeChunk(out, "IHDR", header);
+
+    // every row starts with its filter type, the one whose output has the smallest sum of absolute
+    // (signed) values, the usual guess for what compresses best
+    size_t rowSize = (size_t) width * channels;
+    std::vector<unsigned char> raw((rowSize + 1) * height), zeros(rowSize), candidate(rowSize);
+    for (int y = 0; y < height; y++) {
+        const unsigned char *row = pixels + rowSize * (bottomUp ? height - 1 - y : y);
+        const unsigned char *previous = y == 0 ? &zeros[0] : pixels + rowSize * (bottomUp ? height - y : y - 1);
+        unsigned char *filtered = &raw[(rowSize + 1) * y];
+        uint64_t bestCost = UINT64_MAX;
+        for (int type = 0; type < 5; type++) {
+            png::filterRow(type, row, previous, rowSize, channels, &candidate[0]);
+            uint64_t cost = 0;
+            for (unsigned char value : candidate)
+                cost += std::abs((int) (signed char) value);
+            if (cost < bestCost) {
+                bestCost = cost;
+                filtered[0] = (unsigned char) type;
+                std::copy(candidate.begin(), candidate.end(), filtered + 1);
+            }
+        }
+    }
+
+    std::vector<unsigned char> data = png::zlibCompress(raw);
+    png::writeChunk(out, "IDAT", data);
+    png::writeChunk(out, "IEND", std::vector<unsigned char>());
+    return (bool) out;
+}
+
+}
+
+#endif //PROJECT_BASE_PNGWRITER_H
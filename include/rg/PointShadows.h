@@ -0,0 +1,233 @@
+//
+// Shadows of the sun point light, sampled by shadow.glsl.
+//
+// CubeMap mode renders distance-to-light into two depth cube maps. The static one holds the casters
+// that never change their silhouette and is only redrawn when the light moves. The dynamic one is
+// what the shaders sample: every frame only the faces that a moving caster touches (now or in the
+// previous frame) are restored from the static map and get the moving casters drawn on top.
+//
+// Analytic mode renders nothing, the shaders compute soft eclipses against the occluder spheres
+// that rg::selectOccluders picks for each object (see rg/Eclipse.h).
+//
+
+#ifndef PROJECT_BASE_POINTSHADOWS_H
+#define PROJECT_BASE_POINTSHADOWS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/model.h>
+#include <learnopengl/shader.h>
+#include <rg/Bounds.h>
+#include <rg/GpuTimer.h>
+
+#include <chrono>
+#include <vector>
+
+namespace rg {
+
+enum ShadowMode {
+    ShadowsOff = 0,
+    ShadowsCubeMap,
+    ShadowsAnalytic,
+    ShadowModeCount
+};
+
+inline const char *shadowModeName(int mode) {
+    static const char *names[ShadowModeCount] = {"Off", "Cached cube map", "Analytic eclipses"};
+    return names[mode];
+}
+
+class PointShadows {
+public:
+    static const int TextureUnit = 11;
+
+    struct Caster {
+        Model *model;
+        glm::mat4 transform;
+        // world space
+        BoundingSphere bounds;
+        bool dynamic;
+    };
+
+    struct Stats {
+        // cube faces drawn in the last frame, static and dynamic
+        unsigned int facesUpdated = 0;
+        unsigned long long staticRebuilds = 0;
+        double cpuMs = 0.0;
+        double gpuMs = 0.0;
+    };
+
+    PointShadows(int size, float farPlane)
+            : m_Shader("resources/shaders/shadow_depth.vs", "resources/shaders/shadow_depth.fs"),
+              m_Size(size), m_Far(farPlane) {
+        for (int layer = 0; layer < 2; layer++) {
+            glGenTextures(1, &m_CubeMaps[layer]);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, m_CubeMaps[layer]);
+            for (int face = 0; face < 6; face++)
+                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_DEPTH_COMPONENT24, size, size, 0,
+                             GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+            // hardware 2x2 PCF through samplerCubeShadow
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+            glGenFramebuffers(6, m_Framebuffers[layer]);
+            for (int face = 0; face < 6; face++) {
+                glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffers[layer][face]);
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face,
+                                       m_CubeMaps[layer], 0);
+                glDrawBuffer(GL_NONE);
+                glReadBuffer(GL_NONE);
+            }
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    }
+
+    // the static layer is redrawn on the next update, e.g. after a static caster was moved
+    void invalidate() { m_StaticValid = false; }
+
+    // brings the maps up to date for this frame; binds framebuffer 0 and changes the viewport
+    void update(const std::vector<Caster> &casters, const glm::vec3 &lightPosition, int mode) {
+        auto start = std::chrono::steady_clock::now();
+        m_Mode = mode;
+        m_LightPosition = lightPosition;
+        m_Stats.facesUpdated = 0;
+        if (mode != ShadowsCubeMap) {
+            m_Stats.cpuMs = 0.0;
+            m_Stats.gpuMs = 0.0;
+            return;
+        }
+
+        m_Timer.begin();
+        glViewport(0, 0, m_Size, m_Size);
+        m_Shader.use();
+        m_Shader.setVec3("lightPosition", lightPosition);
+        m_Shader.setFloat("farPlane", m_Far);
+
+        unsigned int dirtyFaces = 0;
+        if (!m_StaticValid || lightPosition != m_StaticLightPosition) {
+            for (int face = 0; face < 6; face++) {
+                glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffers[0][face]);
+                glClear(GL_DEPTH_BUFFER_BIT);
+                drawCasters(casters, face, false);
+                m_Stats.facesUpdated++;
+            }
+            m_StaticValid = true;
+            m_StaticLightPosition = lightPosition;
+            m_Stats.staticRebuilds++;
+            dirtyFaces = 0x3F;
+        }
+
+        // faces a moving caster covered last frame still show it and have to be restored as well
+        unsigned int dynamicFaces = 0;
+        for (const Caster &caster : casters) {
+            if (caster.dynamic)
+                dynamicFaces |= facesOf(caster.bounds);
+        }
+        dirtyFaces |= dynamicFaces | m_LastDynamicFaces;
+        m_LastDynamicFaces = dynamicFaces;
+
+        for (int face = 0; face < 6; face++) {
+            if (!(dirtyFaces & (1u << face)))
+                continue;
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, m_Framebuffers[0][face]);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_Framebuffers[1][face]);
+            glBlitFramebuffer(0, 0, m_Size, m_Size, 0, 0, m_Size, m_Size, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+            glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffers[1][face]);
+            drawCasters(casters, face, true);
+            m_Stats.facesUpdated++;
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        m_Timer.end();
+
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        m_Stats.cpuMs = m_Stats.cpuMs == 0.0 ? ms : m_Stats.cpuMs * 0.9 + ms * 0.1;
+        m_Stats.gpuMs = m_Timer.averageMs();
+    }
+
+    // sets the shadow.glsl uniforms of a program that is in use
+    void bind(const Shader &shader) const {
+        glActiveTexture(GL_TEXTURE0 + TextureUnit);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, m_CubeMaps[1]);
+        glActiveTexture(GL_TEXTURE0);
+        shader.setInt("shadowMap", TextureUnit);
+        shader.setInt("shadowMode", m_Mode);
+        shader.setVec3("shadowLightPosition", m_LightPosition);
+        shader.setFloat("shadowFar", m_Far);
+    }
+
+    const Stats &stats() const { return m_Stats; }
+
+private:
+    Shader m_Shader;
+    int m_Size;
+    float m_Far;
+    // [0] static casters only, [1] static and dynamic casters
+    GLuint m_CubeMaps[2];
+    GLuint m_Framebuffers[2][6];
+    bool m_StaticValid = false;
+    glm::vec3 m_StaticLightPosition = glm::vec3(0.0f);
+    glm::vec3 m_LightPosition = glm::vec3(0.0f);
+    unsigned int m_LastDynamicFaces = 0;
+    int m_Mode = ShadowsOff;
+    GpuTimer m_Timer;
+    Stats m_Stats;
+
+    static glm::vec3 faceDirection(int face) {
+        const glm::vec3 directions[6] = {glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0),
+                                         glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1)};
+        return directions[face];
+    }
+
+    // cube map face orientation, same as in the GL spec table for cube map face selection
+    glm::mat4 faceViewProjection(int face) const {
+        const glm::vec3 ups[6] = {glm::vec3(0, -1, 0), glm::vec3(0, -1, 0), glm::vec3(0, 0, 1),
+                                  glm::vec3(0, 0, -1), glm::vec3(0, -1, 0), glm::vec3(0, -1, 0)};
+        glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, m_Far);
+        return projection * glm::lookAt(m_LightPosition, m_LightPosition + faceDirection(face), ups[face]);
+    }
+
+    // bit per cube face whose 90 degree frustum the sphere reaches into
+    unsigned int facesOf(const BoundingSphere &bounds) const {
+        glm::vec3 center = bounds.center - m_LightPosition;
+        unsigned int faces = 0;
+        for (int face = 0; face < 6; face++) {
+            glm::vec3 axis = faceDirection(face);
+            glm::vec3 u = glm::vec3(axis.y != 0.0f ? 1.0f : 0.0f, axis.y == 0.0f ? 1.0f : 0.0f, 0.0f);
+            glm::vec3 v = glm::cross(axis, u);
+            if (glm::dot(center, axis) < -bounds.radius)
+                continue;
+            // the four side planes of the face frustum, normals point inwards
+            bool inside = true;
+            const glm::vec3 sides[4] = {axis + u, axis - u, axis + v, axis - v};
+            for (const glm::vec3 &side : sides) {
+                if (glm::dot(center, glm::normalize(side)) < -bounds.radius)
+                    inside = false;
+            }
+            if (inside)
+                faces |= 1u << face;
+        }
+        return faces;
+    }
+
+    void drawCasters(const std::vector<Caster> &casters, int face, bool dynamic) {
+        m_Shader.setMat4("lightSpace", faceViewProjection(face));
+        for (const Caster &caster : casters) {
+            if (caster.dynamic != dynamic || !(facesOf(caster.bounds) & (1u << face)))
+                continue;
+            m_Shader.setMat4("model", caster.transform);
+            caster.model->DrawDepth();
+        }
+    }
+};
+
+}
+
+#endif //PROJECT_BASE_POINTSHADOWS_H
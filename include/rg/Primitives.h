@@ -0,0 +1,53 @@
+//
+// Geometry generated in code, for test scenes that should not depend on assets.
+//
+
+#ifndef PROJECT_BASE_PRIMITIVES_H
+#define PROJECT_BASE_PRIMITIVES_H
+
+#include <glm/glm.hpp>
+#include <learnopengl/mesh.h>
+
+#include <cmath>
+#include <vector>
+
+namespace rg {
+
+// unit UV sphere centered at the origin, counter-clockwise when seen from outside
+inline Mesh makeSphereMesh(unsigned int stacks, unsigned int slices) {
+    const float pi = 3.14159265358979f;
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    for (unsigned int i = 0; i <= stacks; i++) {
+        float v = (float) i / stacks;
+        float phi = v * pi;
+        for (unsigned int j = 0; j <= slices; j++) {
+            float u = (float) j / slices;
+            float theta = u * 2.0f * pi;
+            Vertex vertex;
+            vertex.Position = glm::vec3(std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta));
+            vertex.Normal = vertex.Position;
+            vertex.TexCoords = glm::vec2(u, 1.0f - v);
+            vertex.Tangent = glm::vec3(-std::sin(theta), 0.0f, std::cos(theta));
+            vertex.Bitangent = glm::cross(vertex.Normal, vertex.Tangent);
+            vertices.push_back(vertex);
+        }
+    }
+    for (unsigned int i = 0; i < stacks; i++) {
+        for (unsigned int j = 0; j < slices; j++) {
+            unsigned int a = i * (slices + 1) + j;
+            unsigned int b = a + slices + 1;
+            indices.push_back(a);
+            indices.push_back(a + 1);
+            indices.push_back(b);
+            indices.push_back(a + 1);
+            indices.push_back(b + 1);
+            indices.push_back(b);
+        }
+    }
+    return Mesh(vertices, indices, std::vector<Texture>());
+}
+
+}
+
+#endif //PROJECT_BASE_PRIMITIVES_H
@@ -0,0 +1,116 @@
+//
+// On-demand rendering (--on-demand): the window only gets a new frame when something it shows has
+// changed. Input callbacks, the running animation, ImGui, the window system (resize, exposed
+// again) and captures in progress mark the next frames dirty, settings.settleFrames of them so
+// ImGui sees the end of an interaction. When no frame is dirty the render loop blocks in
+// glfwWaitEventsTimeout instead of polling, and the window keeps showing the last frame.
+//
+// The stats are a proxy for the power use and are kept in both modes, for comparing them: frames
+// rendered against frames presented (refreshes of the display over the wall time, each showing
+// the last frame), the CPU time of the process (all threads) and the GPU time of the rendered
+// frames, per second of wall time.
+//
+
+#ifndef PROJECT_BASE_REDRAWTRACKER_H
+#define PROJECT_BASE_REDRAWTRACKER_H
+
+#include <algorithm>
+#include <chrono>
+
+#include <sys/resource.h>
+
+namespace rg {
+
+class RedrawTracker {
+public:
+    enum Reason { Input, Animation, Interface, Window, Capture, ReasonCount };
+
+    struct Settings {
+        bool enabled = false;
+        // frames rendered after every change
+        int settleFrames = 2;
+        // with the ImGui window open its timings are refreshed this often while idle
+        double interfaceRefreshSeconds = 1.0;
+        // longest block in glfwWaitEventsTimeout
+        double idleTimeoutSeconds = 10.0;
+        // of the monitor, for the presented frames
+        double refreshRate = 60.0;
+    };
+
+    struct Stats {
+        unsigned long long rendered = 0;
+        unsigned long long presented = 0;
+        // glfwWaitEventsTimeout calls that came back without anything to render
+        unsigned long long idleWakeups = 0;
+        // rendered frames each reason asked for, a frame can count for several
+        unsigned long long reasons[ReasonCount] = {};
+        double wallSeconds = 0.0;
+        double cpuSeconds = 0.0;
+        double gpuMs = 0.0;
+    };
+
+    Settings settings;
+
+    RedrawTracker() { reset(); }
+
+    static const char *reasonName(int reason) {
+        static const char *const names[ReasonCount] = {"input", "animation", "interface", "window", "capture"};
+        return names[reason];
+    }
+
+    // the next settleFrames frames have to be rendered
+    void invalidate(Reason reason) {
+        m_DirtyFrames = std::max(m_DirtyFrames, settings.settleFrames);
+        m_Reasons |= 1u << reason;
+    }
+
+    bool needsFrame() const { return !settings.enabled || m_DirtyFrames > 0; }
+
+    void frameRendered(double gpuMs) {
+        m_Stats.rendered++;
+        m_Stats.gpuMs += gpuMs;
+        for (int i = 0; i < ReasonCount; i++) {
+            if (m_Reasons & (1u << i))
+                m_Stats.reasons[i]++;
+        }
+        if (m_DirtyFrames > 0 && --m_DirtyFrames == 0)
+            m_Reasons = 0;
+    }
+
+    void idleWakeup() { m_Stats.idleWakeups++; }
+
+    Stats stats() const {
+        Stats stats = m_Stats;
+        stats.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_Start).count();
+        stats.cpuSeconds = processCpuSeconds() - m_StartCpuSeconds;
+        stats.presented = (unsigned long long) (stats.wallSeconds * settings.refreshRate);
+        return stats;
+    }
+
+    // starts counting again, e.g. after switching the mode
+    void reset() {
+        m_Stats = Stats();
+        m_Start = std::chrono::steady_clock::now();
+        m_StartCpuSeconds = processCpuSeconds();
+        invalidate(Window);
+    }
+
+    // user and system time of all threads so far
+    static double processCpuSeconds() {
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0)
+            return 0.0;
+        return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+    }
+
+private:
+    Stats m_Stats;
+    int m_DirtyFrames = 0;
+    unsigned int m_Reasons = 0;
+    std::chrono::steady_clock::time_point m_Start;
+    double m_StartCpuSeconds = 0.0;
+};
+
+}
+
+#endif //PROJECT_BASE_REDRAWTRACKER_H
@@ -0,0 +1,276 @@
+//
+// Render farm (--farm <dir>): renders a frame range of the camera path to an image sequence,
+// <dir>/frame_000000.png and on, with several worker processes of this executable on one machine.
+// The coordinator splits the frames that are still missing into shards of consecutive frames and
+// keeps settings.workers processes busy, each a headless run of its own (--farm-shard) with its own
+// context, its log in <dir>/logs.
+//
+// A frame only depends on its number: the simulation time is frame / 60 s and the camera comes
+// from the path at that time, so the images are the same however the range is split. A worker
+// writes every frame to a temporary file and renames it, so a frame file that exists is complete.
+// That makes the frames on disk the state of the run: a shard that fails is started again for
+// the frames it didn't write, up to settings.retries times, and running --farm again on the same
+// directory only renders what is missing. <dir>/farm.txt records the settings and the camera path
+// of the run, and a directory rendered with others is refused instead of mixing two sequences.
+//
+
+#ifndef PROJECT_BASE_RENDERFARM_H
+#define PROJECT_BASE_RENDERFARM_H
+
+#include <rg/PixelReadback.h>
+#include <rg/PngWriter.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <spawn.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+extern char **environ;
+
+namespace rg {
+
+class RenderFarm {
+public:
+    struct Settings {
+        // inclusive
+        int firstFrame = 0;
+        int lastFrame = 599;
+        int workers = 4;
+        // frames per shard, 0 to split the missing frames into two shards per worker
+        int shardFrames = 0;
+        // how often a failed shard is started again
+        int retries = 2;
+    };
+
+    Settings settings;
+
+    // arguments are passed on to every worker, e.g. "--bench-size 1920x1080 --camera-path <dir>/farm.txt";
+    // manifest is what farm.txt has to contain, the settings that change the images
+    RenderFarm(const std::string &executable, const std::string &directory, const std::string &arguments,
+               const std::string &manifest, const Settings &settings)
+            : settings(settings), m_Executable(executable), m_Directory(directory), m_Arguments(arguments),
+              m_Manifest(manifest) {}
+
+    // "<first>-<last>" or a single frame
+    static bool parseRange(const std::string &text, int &first, int &last) {
+        int read = std::sscanf(text.c_str(), "%d-%d", &first, &last);
+        if (read == 1)
+            last = first;
+        return read >= 1 && first >= 0 && last >= first;
+    }
+
+    static std::string framePath(const std::string &directory, int frame) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "/frame_%06d.png", frame);
+        return directory + name;
+    }
+
+    // for the workers: the file appears under its name only when it is completely written
+    static bool writeFrame(const std::string &directory, int frame, const Image &image) {
+        std::string path = framePath(directory, frame), temporary = path + ".tmp";
+        if (!writePng(temporary, image.width, image.height, image.channels, &image.pixels[0], true)) {
+            std::remove(temporary.c_str());
+            return false;
+        }
+        return std::rename(temporary.c_str(), path.c_str()) == 0;
+    }
+
+    // for a POSIX shell, also for the worker arguments
+    static std::string quote(const std::string &text) {
+        std::string quoted = "'";
+        for (char c : text)
+            quoted += c == '\'' ? std::string("'\\''") : std::string(1, c);
+        return quoted + "'";
+    }
+
+    // true when every frame of the range is on disk at the end
+    bool run() {
+        if ((mkdir(m_Directory.c_str(), 0755) != 0 && errno != EEXIST)
+            || (mkdir((m_Directory + "/logs").c_str(), 0755) != 0 && errno != EEXIST)) {
+            std::cout << "Failed to create " << m_Directory << '\n';
+            return false;
+        }
+        if (!checkManifest())
+            return false;
+
+        int total = settings.lastFrame - settings.firstFrame + 1;
+        std::vector<int> missing = missingFrames(settings.firstFrame, settings.lastFrame);
+        if (missing.size() < (size_t) total)
+            std::cout << "Farm: " << total - missing.size() << " of " << total << " frames already rendered\n";
+        if (missing.empty())
+            return true;
+        int workers = std::max(settings.workers, 1);
+        int shardFrames = settings.shardFrames > 0
+                          ? settings.shardFrames
+                          : std::max((int) (missing.size() + 2 * workers - 1) / (2 * workers), 1);
+        std::deque<Shard> queue;
+        for (const Shard &shard : split(missing, shardFrames))
+            queue.push_back(shard);
+        std::cout << "Farm: " << missing.size() << " frames in " << queue.size() << " shards on " << workers
+                  << " workers, frames in " << m_Directory << '\n';
+
+        std::map<pid_t, Shard> running;
+        std::vector<Shard> failed;
+        auto start = std::chrono::steady_clock::now();
+        auto lastReport = start;
+        int done = total - (int) missing.size(), reported = done, startDone = done;
+        while (!queue.empty() || !running.empty()) {
+            while (!queue.empty() && (int) running.size() < workers) {
+                Shard shard = queue.front();
+                queue.pop_front();
+                pid_t pid = spawn(shard);
+                if (pid > 0) {
+                    running[pid] = shard;
+                } else {
+                    std::cout << "Farm: can't start a worker for frames " << shard.name() << '\n';
+                    failed.push_back(shard);
+                }
+            }
+
+            int status = 0;
+            pid_t pid = waitpid(-1, &status, WNOHANG);
+            if (pid > 0 && running.count(pid) != 0) {
+                Shard shard = running[pid];
+                running.erase(pid);
+                std::vector<int> left = missingFrames(shard.first, shard.last);
+                if (!left.empty()) {
+                    std::cout << "Farm: shard " << shard.name() << " failed ("
+                              << (WIFEXITED(status) ? "exit code " + std::to_string(WEXITSTATUS(status))
+                                                    : std::string("killed"))
+                              << "), " << left.size() << " frames missing, see " << logPath(shard) << '\n';
+                    // the frames it did write are kept
+                    for (Shard retry : split(left, shardFrames)) {
+                        retry.attempt = shard.attempt;
+                        if (shard.attempt < settings.retries) {
+                            retry.attempt++;
+                            queue.push_front(retry);
+                        } else {
+                            failed.push_back(retry);
+                        }
+                    }
+                }
+            } else if (pid <= 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+
+            auto now = std::chrono::steady_clock::now();
+            bool finished = queue.empty() && running.empty();
+            if (now - lastReport >= std::chrono::seconds(1) || finished) {
+                done = total - (int) missingFrames(settings.firstFrame, settings.lastFrame).size();
+                if (done != reported || finished) {
+                    double seconds = std::chrono::duration<double>(now - start).count();
+                    double rate = seconds > 0.0 ? (done - startDone) / seconds : 0.0;
+                    std::cout << "Farm: " << done << "/" << total << " frames, " << running.size() << " workers, "
+                              << rate << " frames/s";
+                    if (rate > 0.0 && !finished)
+                        std::cout << ", about " << (int) ((total - done) / rate) << " s left";
+                    std::cout << '\n';
+                    reported = done;
+                }
+                lastReport = now;
+            }
+        }
+
+        for (const Shard &shard : failed)
+            std::cout << "Farm: frames " << shard.name() << " failed, see " << logPath(shard) << '\n';
+        bool complete = missingFrames(settings.firstFrame, settings.lastFrame).empty();
+        std::cout << "Farm: " << (complete ? "all frames rendered" : "incomplete, run again to resume") << '\n';
+        return complete;
+    }
+
+private:
+    struct Shard {
+        int first = 0;
+        int last = 0;
+        int attempt = 0;
+
+        std::string name() const { return std::to_string(first) + "-" + std::to_string(last); }
+    };
+
+    std::string m_Executable;
+    std::string m_Directory;
+    std::string m_Arguments;
+    std::string m_Manifest;
+
+    static bool exists(const std::string &path) {
+        struct stat info;
+        return stat(path.c_str(), &info) == 0;
+    }
+
+    std::vector<int> missingFrames(int first, int last) const {
+        std::vector<int> frames;
+        for (int frame = first; frame <= last; frame++) {
+            if (!exists(framePath(m_Directory, frame)))
+                frames.push_back(frame);
+        }
+        return frames;
+    }
+
+    // runs of consecutive frames, at most size frames each
+    static std::vector<Shard> split(const std::vector<int> &frames, int size) {
+        std::vector<Shard> shards;
+        for (unsigned int i = 0; i < frames.size(); i++) {
+            if (shards.empty() || frames[i] != shards.back().last + 1 || shards.back().last - shards.back().first + 1 >= size) {
+                shards.push_back(Shard());
+                shards.back().first = frames[i];
+            }
+            shards.back().last = frames[i];
+        }
+        return shards;
+    }
+
+    // a new directory gets the manifest, an old one has to have the same
+    bool checkManifest() const {
+        std::string path = m_Directory + "/farm.txt";
+        std::ifstream in(path);
+        if (in) {
+            std::stringstream existing;
+            existing << in.rdbuf();
+            if (existing.str() != m_Manifest) {
+                std::cout << m_Directory << " holds frames rendered with other settings (see " << path
+                          << "), use another directory\n";
+                return false;
+            }
+            return true;
+        }
+        std::ofstream out(path + ".tmp");
+        out << m_Manifest;
+        out.close();
+        if (!out || std::rename((path + ".tmp").c_str(), path.c_str()) != 0) {
+            std::cout << "Failed to write " << path << '\n';
+            return false;
+        }
+        return true;
+    }
+
+    std::string logPath(const Shard &shard) const {
+        return m_Directory + "/logs/frames_" + shard.name()
+               + (shard.attempt > 0 ? ".retry" + std::to_string(shard.attempt) : std::string()) + ".log";
+    }
+
+    pid_t spawn(const Shard &shard) const {
+        std::string command = "exec " + quote(m_Executable) + " --farm " + quote(m_Directory) + " --farm-shard "
+                              + shard.name() + " " + m_Arguments + " > " + quote(logPath(shard)) + " 2>&1";
+        const char *argv[] = {"sh", "-c", command.c_str(), NULL};
+        pid_t pid = 0;
+        if (posix_spawn(&pid, "/bin/sh", NULL, NULL, (char *const *) argv, environ) != 0)
+            return -1;
+        return pid;
+    }
+};
+
+}
+
+#endif //PROJECT_BASE_RENDERFARM_H
@@ -0,0 +1,123 @@
+//
+// Offscreen framebuffer with texture attachments. The depth texture can be shared between
+// targets, so a later pass can depth test against the scene without copying it.
+//
+
+#ifndef PROJECT_BASE_RENDERTARGET_H
+#define PROJECT_BASE_RENDERTARGET_H
+
+#include <glad/glad.h>
+#include <rg/DrawStats.h>
+#include <rg/Error.h>
+
+#include <vector>
+
+namespace rg {
+
+// client format/type pair that goes with a sized internal format in glTexImage2D
+inline void textureFormatFor(GLenum internalFormat, GLenum &format, GLenum &type) {
+    switch (internalFormat) {
+        case GL_R8: format = GL_RED; type = GL_UNSIGNED_BYTE; break;
+        case GL_R16F: case GL_R32F: format = GL_RED; type = GL_FLOAT; break;
+        case GL_RG16F: case GL_RG32F: format = GL_RG; type = GL_FLOAT; break;
+        case GL_RGB16F: case GL_R11F_G11F_B10F: format = GL_RGB; type = GL_FLOAT; break;
+        case GL_RGBA16F: case GL_RGBA32F: format = GL_RGBA; type = GL_FLOAT; break;
+        case GL_DEPTH24_STENCIL8: format = GL_DEPTH_STENCIL; type = GL_UNSIGNED_INT_24_8; break;
+        case GL_DEPTH_COMPONENT24: case GL_DEPTH_COMPONENT32F: format = GL_DEPTH_COMPONENT; type = GL_FLOAT; break;
+        default: format = GL_RGBA; type = GL_UNSIGNED_BYTE; break;
+    }
+}
+
+inline GLuint createTexture2D(int width, int height, GLenum internalFormat, GLenum filter = GL_LINEAR) {
+    GLenum format, type;
+    textureFormatFor(internalFormat, format, type);
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
+
+// one triangle covering the viewport, see fullscreen.vs
+inline void drawFullscreenTriangle() {
+    static unsigned int emptyVAO = 0;
+    if (emptyVAO == 0)
+        glGenVertexArrays(1, &emptyVAO);
+    glBindVertexArray(emptyVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    countDraw(1);
+}
+
+struct RenderTarget {
+    GLuint framebuffer = 0;
+    std::vector<GLuint> colorTextures;
+    GLuint depthTexture = 0;
+    bool ownsDepth = false;
+    int width = 0;
+    int height = 0;
+
+    // one color attachment per format; sharedDepth == 0 gives the target its own
+    // DEPTH24_STENCIL8 texture unless withDepth is false
+    void create(int w, int h, const std::vector<GLenum> &colorFormats, GLuint sharedDepth = 0, bool withDepth = true) {
+        destroy();
+        width = w;
+        height = h;
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+        std::vector<GLenum> drawBuffers;
+        for (unsigned int i = 0; i < colorFormats.size(); i++) {
+            GLuint texture = createTexture2D(w, h, colorFormats[i]);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, texture, 0);
+            colorTextures.push_back(texture);
+            drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + i);
+        }
+        if (drawBuffers.empty()) {
+            glDrawBuffer(GL_NONE);
+            glReadBuffer(GL_NONE);
+        } else {
+            glDrawBuffers(drawBuffers.size(), &drawBuffers[0]);
+        }
+
+        if (sharedDepth != 0) {
+            depthTexture = sharedDepth;
+        } else if (withDepth) {
+            depthTexture = createTexture2D(w, h, GL_DEPTH24_STENCIL8, GL_NEAREST);
+            ownsDepth = true;
+        }
+        if (depthTexture != 0)
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+
+        ASSERT(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE, "Render target is not complete!");
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    void destroy() {
+        if (framebuffer == 0)
+            return;
+        glDeleteFramebuffers(1, &framebuffer);
+        if (!colorTextures.empty())
+            glDeleteTextures(colorTextures.size(), &colorTextures[0]);
+        if (ownsDepth)
+            glDeleteTextures(1, &depthTexture);
+        framebuffer = 0;
+        colorTextures.clear();
+        depthTexture = 0;
+        ownsDepth = false;
+    }
+
+    void bind() const {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glViewport(0, 0, width, height);
+    }
+};
+
+}
+
+#endif //PROJECT_BASE_RENDERTARGET_H
@@ -0,0 +1,146 @@
+//
+// Frame budget governor: keeps the GPU time of the 3D scene near a target by changing the scale
+// the scene is rendered at, and once the scale is at its minimum by lowering effect quality and
+// then biasing LOD selection towards coarser meshes. Headroom is given back in reverse order.
+//
+// The GPU times it gets are a few frames old (see GpuSpanTimer), so after every decision it waits
+// until results of frames that already used the new settings come back. Going down reacts to a
+// small overshoot, going up needs clear headroom and waits longer, so it doesn't oscillate.
+//
+// Every frame's input and decision is kept in a ring for plotting and CSV export.
+//
+
+#ifndef PROJECT_BASE_RESOLUTIONGOVERNOR_H
+#define PROJECT_BASE_RESOLUTIONGOVERNOR_H
+
+#include <algorithm>
+#include <cmath>
+#include <ostream>
+#include <vector>
+
+namespace rg {
+
+class ResolutionGovernor {
+public:
+    // effect quality levels, from QualityLevels - 1 (as configured) down to 0: translucent layers at
+    // half resolution, then at quarter resolution, then bloom off as well
+    static const int QualityLevels = 4;
+    static const int MaxLodBias = 2;
+    // the scale moves in steps so the render targets aren't recreated for every small change
+    static constexpr float ScaleStep = 0.05f;
+    static const int HistorySize = 512;
+
+    struct Settings {
+        bool enabled = false;
+        float targetMs = 12.0f;
+        float minScale = 0.5f;
+        float maxScale = 1.0f;
+    };
+
+    struct Decision {
+        unsigned long long frame;
+        // smoothed GPU time the decision was based on, 0 while no result came back
+        float gpuMs;
+        float scale;
+        int quality;
+        int lodBias;
+    };
+
+    Settings settings;
+
+    ResolutionGovernor() { m_History.reserve(HistorySize); }
+
+    // called once per frame; fresh is false when no new GPU time came back since the last frame
+    void update(double gpuMs, bool fresh) {
+        m_Frame++;
+        if (fresh)
+            m_SmoothedMs = m_SmoothedMs == 0.0 ? gpuMs : m_SmoothedMs * 0.7 + gpuMs * 0.3;
+        if (!settings.enabled) {
+            m_Scale = settings.maxScale;
+            m_Quality = QualityLevels - 1;
+            m_LodBias = 0;
+            m_Wait = 0;
+        } else if (fresh) {
+            if (m_Wait > 0)
+                m_Wait--;
+            else
+                decide();
+        }
+        m_Scale = std::min(std::max(m_Scale, settings.minScale), settings.maxScale);
+        record();
+    }
+
+    float scale() const { return m_Scale; }
+    int quality() const { return m_Quality; }
+    int lodBias() const { return m_LodBias; }
+
+    // oldest first
+    unsigned int historySize() const { return m_History.size(); }
+    const Decision &history(unsigned int i) const {
+        return m_History[(m_Next + HistorySize - m_History.size() + i) % HistorySize];
+    }
+
+    void writeCsv(std::ostream &out) const {
+        out << "frame,gpu_ms,scale,quality,lod_bias\n";
+        for (unsigned int i = 0; i < historySize(); i++) {
+            const Decision &d = history(i);
+            out << d.frame << ',' << d.gpuMs << ',' << d.scale << ',' << d.quality << ',' << d.lodBias << '\n';
+        }
+    }
+
+private:
+    // frames until a result rendered with new settings comes back, GpuSpanTimer::QueryCount plus slack
+    static const int LatencyFrames = 6;
+    // extra frames of proof before giving quality back
+    static const int RaiseFrames = 30;
+
+    float m_Scale = 1.0f;
+    int m_Quality = QualityLevels - 1;
+    int m_LodBias = 0;
+    double m_SmoothedMs = 0.0;
+    int m_Wait = 0;
+    unsigned long long m_Frame = 0;
+    std::vector<Decision> m_History;
+    unsigned int m_Next = 0;
+
+    void decide() {
+        double ratio = settings.targetMs / std::max(m_SmoothedMs, 1e-3);
+        if (ratio < 0.95) {
+            // the scene's cost is mostly per pixel, which goes with the square of the scale
+            if (m_Scale > settings.minScale) {
+                float wanted = std::floor(m_Scale * (float) std::sqrt(ratio) / ScaleStep) * ScaleStep;
+                m_Scale = std::max(std::min(wanted, m_Scale - ScaleStep), settings.minScale);
+            } else if (m_Quality > 0) {
+                m_Quality--;
+            } else if (m_LodBias < MaxLodBias) {
+                m_LodBias++;
+            } else {
+                return;
+            }
+            m_Wait = LatencyFrames;
+        } else if (ratio > 1.25) {
+            if (m_LodBias > 0)
+                m_LodBias--;
+            else if (m_Quality < QualityLevels - 1)
+                m_Quality++;
+            else if (m_Scale < settings.maxScale)
+                m_Scale = std::min(m_Scale + ScaleStep, settings.maxScale);
+            else
+                return;
+            m_Wait = LatencyFrames + RaiseFrames;
+        }
+    }
+
+    void record() {
+        Decision d = {m_Frame, (float) m_SmoothedMs, m_Scale, m_Quality, m_LodBias};
+        if (m_History.size() < (size_t) HistorySize)
+            m_History.push_back(d);
+        else
+            m_History[m_Next] = d;
+        m_Next = (m_Next + 1) % HistorySize;
+    }
+};
+
+}
+
+#endif //PROJECT_BASE_RESOLUTIONGOVERNOR_H
@@ -0,0 +1,258 @@
+//
+// Synthetic solar system for stress testing, added to the shipped scene (--scene). Planets orbit
+// the sun, moons orbit their planet, asteroids form a belt around the sun, and point lights and
+// translucent clouds circle the planets. Everything comes from the seed and the counts, so a spec
+// like "seed=7,planets=16,moons=2,asteroids=4000,lights=1024,clouds=32" always builds the same
+// scene. Planets are drawn with the earth model, moons and asteroids with the moon model, clouds
+// with the cosmic dust model.
+//
+// Orbits are circles around their parent at a fixed angular speed, so positions only depend on the
+// time and parents are always placed before their children.
+//
+
+#ifndef PROJECT_BASE_SCENEGENERATOR_H
+#define PROJECT_BASE_SCENEGENERATOR_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+class SceneGenerator {
+public:
+    struct Settings {
+        unsigned int seed = 1;
+        int planets = 0;
+        int moonsPerPlanet = 0;
+        int asteroids = 0;
+        int lights = 0;
+        int clouds = 0;
+
+        bool empty() const { return planets == 0 && asteroids == 0 && lights == 0 && clouds == 0; }
+
+        // comma separated key=value pairs with the keys of toString(), false on anything else
+        static bool parse(const std::string &spec, Settings &settings) {
+            std::stringstream in(spec);
+            std::string pair;
+            while (std::getline(in, pair, ',')) {
+                size_t equals = pair.find('=');
+                if (equals == std::string::npos)
+                    return false;
+                std::string key = pair.substr(0, equals);
+                char *end = NULL;
+                long value = std::strtol(pair.c_str() + equals + 1, &end, 10);
+                if (*end != '\0' || end == pair.c_str() + equals + 1 || value < 0)
+                    return false;
+                if (key == "seed")
+                    settings.seed = value;
+                else if (key == "planets")
+                    settings.planets = value;
+                else if (key == "moons")
+                    settings.moonsPerPlanet = value;
+                else if (key == "asteroids")
+                    settings.asteroids = value;
+                else if (key == "lights")
+                    settings.lights = value;
+                else if (key == "clouds")
+                    settings.clouds = value;
+                else
+                    return false;
+            }
+            return true;
+        }
+
+        std::string toString() const {
+            return "seed=" + std::to_string(seed) + ",planets=" + std::to_string(planets) + ",moons="
+                   + std::to_string(moonsPerPlanet) + ",asteroids=" + std::to_string(asteroids) + ",lights="
+                   + std::to_string(lights) + ",clouds=" + std::to_string(clouds);
+        }
+    };
+
+    enum BodyKind {
+        Planet,
+        Moon,
+        Asteroid
+    };
+
+    // a circle around the parent body, or around the sun for parent -1
+    struct Orbit {
+        int parent;
+        glm::vec3 axis;
+        // position at time 0 relative to the parent, perpendicular to axis
+        glm::vec3 start;
+        // radians per second
+        float speed;
+    };
+
+    struct Body {
+        BodyKind kind;
+        Orbit orbit;
+        // world space radius
+        float radius;
+        glm::vec3 spinAxis;
+        float spinSpeed;
+    };
+
+    struct Light {
+        Orbit orbit;
+        glm::vec3 color;
+    };
+
+    struct Cloud {
+        Orbit orbit;
+        float radius;
+        glm::vec4 tint;
+    };
+
+    SceneGenerator(const Settings &settings, const glm::vec3 &sunPosition)
+            : m_Settings(settings), m_Sun(sunPosition) {
+        // random numbers are only drawn in braced lists or separate statements, where the order
+        // of evaluation is fixed, and without the standard distributions, which differ between
+        // standard libraries, so every build makes the same scene
+        std::mt19937 random(settings.seed);
+        // the system lies close to one plane, tilted a little so it isn't edge on from the earth
+        glm::vec3 systemAxis = glm::normalize(glm::vec3(0.15f, 1.0f, 0.1f));
+
+        for (int p = 0; p < settings.planets; p++) {
+            float distance = 22.0f + 50.0f * unit(random);
+            glm::vec3 axis = tilt(systemAxis, 0.08f, random);
+            float radius = 0.8f + 1.2f * unit(random);
+            int planet = m_Bodies.size();
+            m_Bodies.push_back({Planet, makeOrbit(-1, axis, distance, keplerSpeed(distance, 40.0f), random), radius,
+                                tilt(axis, 0.4f, random), 0.2f + 0.6f * unit(random)});
+            for (int m = 0; m < settings.moonsPerPlanet; m++) {
+                float moonDistance = radius * (2.0f + 1.2f * m + 0.8f * unit(random));
+                glm::vec3 moonAxis = tilt(axis, 0.3f, random);
+                float moonSpeed = 2.0f * 3.14159265f / (8.0f + 4.0f * m + 4.0f * unit(random));
+                m_Bodies.push_back({Moon, makeOrbit(planet, moonAxis, moonDistance, moonSpeed, random),
+                                    radius * (0.15f + 0.15f * unit(random)), moonAxis, 0.1f});
+            }
+        }
+        for (int a = 0; a < settings.asteroids; a++) {
+            float distance = 40.0f + 15.0f * unit(random);
+            glm::vec3 axis = tilt(systemAxis, 0.05f, random);
+            m_Bodies.push_back({Asteroid, makeOrbit(-1, axis, distance, keplerSpeed(distance, 40.0f), random),
+                                0.05f + 0.15f * unit(random), randomDirection(random), 0.5f + 2.0f * unit(random)});
+        }
+        // lights and clouds stay near the planets, or circle the sun when there are none
+        std::vector<int> planets;
+        for (unsigned int i = 0; i < m_Bodies.size(); i++) {
+            if (m_Bodies[i].kind == Planet)
+                planets.push_back(i);
+        }
+        for (int l = 0; l < settings.lights; l++) {
+            int parent = planets.empty() ? -1 : planets[random() % planets.size()];
+            float distance = parent == -1 ? 12.0f + 10.0f * unit(random) : m_Bodies[parent].radius * (1.2f + 1.5f * unit(random));
+            glm::vec3 color{unit(random), unit(random), unit(random)};
+            color /= std::max(std::max(color.r, std::max(color.g, color.b)), 1e-3f);
+            glm::vec3 axis = randomDirection(random);
+            float speed = 0.3f + 1.2f * unit(random);
+            m_Lights.push_back({makeOrbit(parent, axis, distance, speed, random), color});
+        }
+        for (int c = 0; c < settings.clouds; c++) {
+            int parent = planets.empty() ? -1 : planets[random() % planets.size()];
+            float scale = parent == -1 ? 6.0f : m_Bodies[parent].radius;
+            glm::vec4 tint{unit(random), unit(random), unit(random), 0.2f + 0.3f * unit(random)};
+            glm::vec3 axis = randomDirection(random);
+            float distance = scale * (1.5f + 2.0f * unit(random));
+            float speed = 0.05f + 0.2f * unit(random);
+            m_Clouds.push_back({makeOrbit(parent, axis, distance, speed, random), scale * (0.8f + 0.8f * unit(random)), tint});
+        }
+        m_Positions.resize(m_Bodies.size());
+        m_Spins.resize(m_Bodies.size());
+        m_LightPositions.resize(m_Lights.size());
+        m_CloudPositions.resize(m_Clouds.size());
+    }
+
+    const Settings &settings() const { return m_Settings; }
+    const std::vector<Body> &bodies() const { return m_Bodies; }
+    const std::vector<Light> &lights() const { return m_Lights; }
+    const std::vector<Cloud> &clouds() const { return m_Clouds; }
+
+    // places everything at time seconds
+    void update(float time) {
+        for (unsigned int i = 0; i < m_Bodies.size(); i++) {
+            m_Positions[i] = orbitPosition(m_Bodies[i].orbit, time);
+            m_Spins[i] = m_Bodies[i].spinSpeed * time;
+        }
+        for (unsigned int i = 0; i < m_Lights.size(); i++)
+            m_LightPositions[i] = orbitPosition(m_Lights[i].orbit, time);
+        for (unsigned int i = 0; i < m_Clouds.size(); i++)
+            m_CloudPositions[i] = orbitPosition(m_Clouds[i].orbit, time);
+    }
+
+    // world transform of a body drawn with a model whose bounding sphere has modelRadius
+    glm::mat4 bodyTransform(unsigned int i, float modelRadius) const {
+        glm::mat4 transform = glm::translate(glm::mat4(1.0f), m_Positions[i]);
+        transform = glm::rotate(transform, m_Spins[i], m_Bodies[i].spinAxis);
+        return glm::scale(transform, glm::vec3(m_Bodies[i].radius / modelRadius));
+    }
+
+    glm::mat4 cloudTransform(unsigned int i, float modelRadius) const {
+        glm::mat4 transform = glm::translate(glm::mat4(1.0f), m_CloudPositions[i]);
+        return glm::scale(transform, glm::vec3(m_Clouds[i].radius / modelRadius));
+    }
+
+    const glm::vec3 &lightPosition(unsigned int i) const { return m_LightPositions[i]; }
+
+private:
+    Settings m_Settings;
+    glm::vec3 m_Sun;
+    std::vector<Body> m_Bodies;
+    std::vector<Light> m_Lights;
+    std::vector<Cloud> m_Clouds;
+    std::vector<glm::vec3> m_Positions;
+    std::vector<float> m_Spins;
+    std::vector<glm::vec3> m_LightPositions;
+    std::vector<glm::vec3> m_CloudPositions;
+
+    glm::vec3 orbitPosition(const Orbit &orbit, float time) const {
+        glm::vec3 center = orbit.parent == -1 ? m_Sun : m_Positions[orbit.parent];
+        float angle = orbit.speed * time;
+        return center + orbit.start * std::cos(angle) + glm::cross(orbit.axis, orbit.start) * std::sin(angle);
+    }
+
+    // one turn every `period` seconds at distance 10, slower further out like a real orbit
+    static float keplerSpeed(float distance, float period) {
+        return 2.0f * 3.14159265f / period * std::pow(10.0f / distance, 1.5f);
+    }
+
+    // in [0, 1), from the top 24 bits
+    static float unit(std::mt19937 &random) {
+        return (random() >> 8) * (1.0f / 16777216.0f);
+    }
+
+    static glm::vec3 randomDirection(std::mt19937 &random) {
+        glm::vec3 direction;
+        do {
+            direction = glm::vec3{unit(random), unit(random), unit(random)} * 2.0f - 1.0f;
+        } while (glm::dot(direction, direction) > 1.0f || glm::dot(direction, direction) < 1e-4f);
+        return glm::normalize(direction);
+    }
+
+    // axis moved away from itself by up to `amount` (about radians for small amounts)
+    static glm::vec3 tilt(const glm::vec3 &axis, float amount, std::mt19937 &random) {
+        return glm::normalize(axis + randomDirection(random) * amount);
+    }
+
+    static Orbit makeOrbit(int parent, const glm::vec3 &axis, float distance, float speed, std::mt19937 &random) {
+        // any direction perpendicular to the axis, from a random one
+        glm::vec3 side;
+        do {
+            side = glm::cross(axis, randomDirection(random));
+        } while (glm::dot(side, side) < 1e-4f);
+        return {parent, axis, glm::normalize(side) * distance, speed * (unit(random) < 0.1f ? -1.0f : 1.0f)};
+    }
+};
+
+}
+
+#endif //PROJECT_BASE_SCENEGENERATOR_H
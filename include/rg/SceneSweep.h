@@ -0,0 +1,257 @@
+//
+// Scaling sweep of the synthetic scene (--sweep <dir>). One count of rg::SceneGenerator at a time
+// is raised step by step with the others held, and every step is a separate --bench run of this
+// executable, so each starts from a fresh process and reports its own memory. The results go into
+// <dir>/sweep.csv and one SVG chart per count: CPU frame time (p50 and p99), CPU submit time and GPU
+// scene time over the steps on top, resident and video memory below. The counts double from step
+// to step, so a cost that grows linearly doubles too and a cliff shows up as a jump.
+//
+
+#ifndef PROJECT_BASE_SCENESWEEP_H
+#define PROJECT_BASE_SCENESWEEP_H
+
+#include <rg/SceneGenerator.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+namespace rg {
+
+class SceneSweep {
+public:
+    // one swept count, name as in SceneGenerator::Settings::parse
+    struct Axis {
+        std::string name;
+        std::vector<int> values;
+        // the other counts during the sweep
+        SceneGenerator::Settings base;
+    };
+
+    // -1 for what a run didn't report
+    struct Result {
+        std::string axis;
+        int value = 0;
+        bool ok = false;
+        double frameP50 = -1.0;
+        double frameP99 = -1.0;
+        double submitP50 = -1.0;
+        double gpuP50 = -1.0;
+        double residentMb = -1.0;
+        double gpuMemoryMb = -1.0;
+    };
+
+    std::vector<Axis> axes = defaultAxes();
+
+    // arguments are passed on to every run, e.g. "--bench-frames 300 --gl43"
+    SceneSweep(const std::string &executable, const std::string &directory, const std::string &arguments)
+            : m_Executable(executable), m_Directory(directory), m_Arguments(arguments) {}
+
+    // false when the directory can't be created or no run produced a report
+    bool run() {
+        if (mkdir(m_Directory.c_str(), 0755) != 0 && errno != EEXIST) {
+            std::cout << "Failed to create " << m_Directory << '\n';
+            return false;
+        }
+        m_Results.clear();
+        for (const Axis &axis : axes) {
+            for (int value : axis.values) {
+                SceneGenerator::Settings settings = axis.base;
+                SceneGenerator::Settings::parse(axis.name + "=" + std::to_string(value), settings);
+                std::string name = m_Directory + "/" + axis.name + "_" + std::to_string(value);
+                std::string command = quote(m_Executable) + " --bench " + quote(name + ".json") + " --scene "
+                                      + quote(settings.toString()) + " " + m_Arguments + " > " + quote(name + ".log")
+                                      + " 2>&1";
+                std::cout << "Sweep: " << axis.name << " = " << value << "... " << std::flush;
+                Result result;
+                result.axis = axis.name;
+                result.value = value;
+                result.ok = std::system(command.c_str()) == 0 && readReport(name + ".json", result);
+                if (result.ok)
+                    std::cout << "frame p50 " << result.frameP50 << " ms, submit p50 " << result.submitP50 << " ms\n";
+                else
+                    std::cout << "failed, see " << name << ".log\n";
+                m_Results.push_back(result);
+            }
+            writeChart(axis);
+        }
+        writeCsv();
+        std::cout << "Sweep: results in " << m_Directory << "/sweep.csv\n";
+        for (const Result &result : m_Results) {
+            if (result.ok)
+                return true;
+        }
+        return false;
+    }
+
+    const std::vector<Result> &results() const { return m_Results; }
+
+    // each count from nothing to well past what the shipped scene needs
+    static std::vector<Axis> defaultAxes() {
+        SceneGenerator::Settings none;
+        SceneGenerator::Settings planets;
+        planets.planets = 8;
+        return {
+                {"planets", {1, 2, 4, 8, 16, 32, 64}, none},
+                {"moons", {0, 1, 2, 4, 8}, planets},
+                {"asteroids", {0, 250, 500, 1000, 2000, 4000, 8000}, none},
+                {"lights", {0, 128, 256, 512, 1024, 2048, 4096}, none},
+                {"clouds", {0, 4, 8, 16, 32, 64, 128}, none},
+        };
+    }
+
+private:
+    std::string m_Executable;
+    std::string m_Directory;
+    std::string m_Arguments;
+    std::vector<Result> m_Results;
+
+    // for a POSIX shell
+    static std::string quote(const std::string &text) {
+        std::string quoted = "'";
+        for (char c : text)
+            quoted += c == '\'' ? std::string("'\\''") : std::string(1, c);
+        return quoted + "'";
+    }
+
+    // the numbers of a Benchmark report; it is our own output, so finding the keys is enough
+    static bool readReport(const std::string &path, Result &result) {
+        std::ifstream in(path);
+        if (!in)
+            return false;
+        std::stringstream buffer;
+        buffer << in.rdbuf();
+        std::string json = buffer.str();
+        result.frameP50 = findNumber(json, "cpu_frame_ms", "p50");
+        result.frameP99 = findNumber(json, "cpu_frame_ms", "p99");
+        result.submitP50 = findNumber(json, "cpu_submit_ms", "p50");
+        result.gpuP50 = findNumber(json, "gpu_scene_ms", "p50");
+        result.residentMb = findNumber(json, "memory", "resident_mb");
+        result.gpuMemoryMb = findNumber(json, "memory", "gpu_used_mb");
+        return result.frameP50 >= 0.0;
+    }
+
+    // value of the first "key" after "object", -1 when missing or null
+    static double findNumber(const std::string &json, const std::string &object, const std::string &key) {
+        size_t position = json.find("\"" + object + "\"");
+        if (position == std::string::npos)
+            return -1.0;
+        position = json.find("\"" + key + "\":", position);
+        if (position == std::string::npos)
+            return -1.0;
+        const char *start = json.c_str() + position + key.size() + 3;
+        char *end = NULL;
+        double value = std::strtod(start, &end);
+        return end == start ? -1.0 : value;
+    }
+
+    void writeCsv() const {
+        std::ofstream out(m_Directory + "/sweep.csv");
+        out << "axis,value,ok,frame_p50_ms,frame_p99_ms,submit_p50_ms,gpu_p50_ms,resident_mb,gpu_memory_mb\n";
+        for (const Result &r : m_Results) {
+            out << r.axis << ',' << r.value << ',' << (r.ok ? 1 : 0) << ',' << r.frameP50 << ',' << r.frameP99 << ','
+                << r.submitP50 << ',' << r.gpuP50 << ',' << r.residentMb << ',' << r.gpuMemoryMb << '\n';
+        }
+    }
+
+    struct Series {
+        const char *name;
+        const char *color;
+        std::vector<double> values;
+    };
+
+    void writeChart(const Axis &axis) const {
+        std::vector<const Result *> steps;
+        for (const Result &result : m_Results) {
+            if (result.axis == axis.name)
+                steps.push_back(&result);
+        }
+        std::vector<Series> times = {{"frame p50", "#1f77b4", {}}, {"frame p99", "#9ecae1", {}},
+                                     {"submit p50", "#ff7f0e", {}}, {"GPU p50", "#2ca02c", {}}};
+        std::vector<Series> memory = {{"resident", "#9467bd", {}}, {"video", "#8c564b", {}}};
+        for (const Result *step : steps) {
+            times[0].values.push_back(step->ok ? step->frameP50 : -1.0);
+            times[1].values.push_back(step->ok ? step->frameP99 : -1.0);
+            times[2].values.push_back(step->ok ? step->submitP50 : -1.0);
+            times[3].values.push_back(step->ok ? step->gpuP50 : -1.0);
+            memory[0].values.push_back(step->ok ? step->residentMb : -1.0);
+            memory[1].values.push_back(step->ok ? step->gpuMemoryMb : -1.0);
+        }
+        std::ofstream out(m_Directory + "/" + axis.name + ".svg");
+        out << "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"" << ChartWidth << "\" height=\"500\" "
+            << "font-family=\"sans-serif\" font-size=\"11\">\n<rect width=\"100%\" height=\"100%\" fill=\"white\"/>\n";
+        out << "<text x=\"" << ChartWidth / 2 << "\" y=\"20\" text-anchor=\"middle\" font-size=\"14\">" << axis.name
+            << " (" << axis.base.toString() << ")</text>\n";
+        writePanel(out, times, "ms", 40, 260, steps);
+        writePanel(out, memory, "MB", 340, 120, steps);
+        out << "</svg>\n";
+    }
+
+    static const int ChartWidth = 720;
+    static const int PanelLeft = 60;
+    static const int PanelRight = 150;
+
+    // a line per series over the steps, spaced evenly; missing values leave a gap
+    static void writePanel(std::ostream &out, const std::vector<Series> &series, const char *unit, int top, int height,
+                           const std::vector<const Result *> &steps) {
+        double maximum = 0.0;
+        for (const Series &s : series) {
+            for (double value : s.values)
+                maximum = std::max(maximum, value);
+        }
+        maximum = maximum > 0.0 ? maximum * 1.1 : 1.0;
+        int width = ChartWidth - PanelLeft - PanelRight;
+        auto x = [&](unsigned int i) {
+            return PanelLeft + (steps.size() > 1 ? width * (double) i / (steps.size() - 1) : width / 2.0);
+        };
+        auto y = [&](double value) { return top + height * (1.0 - value / maximum); };
+
+        out << "<rect x=\"" << PanelLeft << "\" y=\"" << top << "\" width=\"" << width << "\" height=\"" << height
+            << "\" fill=\"none\" stroke=\"#888\"/>\n";
+        for (int tick = 0; tick <= 4; tick++) {
+            double value = maximum * tick / 4.0;
+            out << "<line x1=\"" << PanelLeft << "\" x2=\"" << PanelLeft + width << "\" y1=\"" << y(value) << "\" y2=\""
+                << y(value) << "\" stroke=\"#eee\"/>\n";
+            out << "<text x=\"" << PanelLeft - 4 << "\" y=\"" << y(value) + 4 << "\" text-anchor=\"end\">"
+                << std::round(value * 100.0) / 100.0 << "</text>\n";
+        }
+        out << "<text x=\"12\" y=\"" << top + height / 2 << "\">" << unit << "</text>\n";
+        for (unsigned int i = 0; i < steps.size(); i++) {
+            out << "<text x=\"" << x(i) << "\" y=\"" << top + height + 14 << "\" text-anchor=\"middle\">"
+                << steps[i]->value << "</text>\n";
+        }
+        for (unsigned int s = 0; s < series.size(); s++) {
+            const std::vector<double> &values = series[s].values;
+            std::string points;
+            for (unsigned int i = 0; i <= values.size(); i++) {
+                if (i < values.size() && values[i] >= 0.0) {
+                    points += std::to_string(x(i)) + "," + std::to_string(y(values[i])) + " ";
+                    out << "<circle cx=\"" << x(i) << "\" cy=\"" << y(values[i]) << "\" r=\"2.5\" fill=\""
+                        << series[s].color << "\"/>\n";
+                } else if (!points.empty()) {
+                    out << "<polyline points=\"" << points << "\" fill=\"none\" stroke=\"" << series[s].color
+                        << "\" stroke-width=\"1.5\"/>\n";
+                    points.clear();
+                }
+            }
+            int legendY = top + 12 + 16 * s;
+            out << "<line x1=\"" << ChartWidth - PanelRight + 12 << "\" x2=\"" << ChartWidth - PanelRight + 32
+                << "\" y1=\"" << legendY - 4 << "\" y2=\"" << legendY - 4 << "\" stroke=\"" << series[s].color
+                << "\" stroke-width=\"2\"/>\n";
+            out << "<text x=\"" << ChartWidth - PanelRight + 38 << "\" y=\"" << legendY << "\">" << series[s].name
+                << "</text>\n";
+        }
+    }
+};
+
+}
+
+#endif //PROJECT_BASE_SCENESWEEP_H
@@ -0,0 +1,851 @@
+//
+// CPU rendering backend for render nodes without a GPU (--software). It draws the same Model data
+// as the GL path with the lighting of earth.fs/moon.fs (Blinn-Phong point light plus the four
+// directional fill lights), the emissive sun of shader.fs and the skybox, tonemapped like
+// tonemap.fs. Point shadows, clustered lights, eclipses, bloom and the translucent passes are not
+// reproduced.
+//
+// A frame runs in two data parallel stages on the job system:
+//  1. geometry, in batches of triangles: transform, clipping against the near and far planes and a
+//     guard band, back-face culling, snapping to 1/16 pixel and binning into TileSize tiles
+//  2. per tile, pulled from the job system's shared counter: the bins are rasterized in submission
+//     order with integer edge functions, 8 pixels at a time with AVX2 when the CPU has it, into the
+//     depth buffer and a buffer of triangle ids; then every covered pixel is shaded once from the
+//     triangle that won the depth test and the others get the skybox
+// The tiles don't overlap and their bins keep the submission order, so the image doesn't depend on
+// the number of threads.
+//
+
+#ifndef PROJECT_BASE_SOFTWARERENDERER_H
+#define PROJECT_BASE_SOFTWARERENDERER_H
+
+#include <glm/glm.hpp>
+#include <stb_image.h>
+
+#include <learnopengl/model.h>
+#include <rg/JobSystem.h>
+#include <rg/PngWriter.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define RG_SOFTWARE_AVX2 1
+#endif
+
+namespace rg {
+
+// RGB texture with a box filtered mip chain. Channels expand like GL_RED/GL_RG uploads, (r, 0, 0)
+// and (r, g, 0); rows stay in the order stb_image returns them, so with the vertical flip on they
+// match what the GL path uploads.
+class SoftwareTexture {
+public:
+    bool load(const std::string &path, bool mipmaps) {
+        int width, height, channels;
+        unsigned char *data = stbi_load(path.c_str(), &width, &height, &channels, 0);
+        if (data == NULL) {
+            std::cout << "Texture failed to load at path: " << path << std::endl;
+            return false;
+        }
+        m_Levels.assign(1, Level());
+        Level &base = m_Levels[0];
+        base.width = width;
+        base.height = height;
+        base.texels.assign((size_t) width * height * 3, 0);
+        for (size_t i = 0; i < (size_t) width * height; i++)
+            for (int c = 0; c < std::min(channels, 3); c++)
+                base.texels[i * 3 + c] = data[i * channels + c];
+        stbi_image_free(data);
+        while (mipmaps && (m_Levels.back().width > 1 || m_Levels.back().height > 1))
+            m_Levels.push_back(downsample(m_Levels.back()));
+        m_LodBias = 0.5f * std::log2((float) width * height);
+        return true;
+    }
+
+    // GL_REPEAT; lod is log2 of the texels per pixel along one axis, the nearest level is filtered bilinearly
+    glm::vec3 sample(const glm::vec2 &uv, float lod) const {
+        int level = std::min(std::max((int) std::floor(lod + m_LodBias + 0.5f), 0), (int) m_Levels.size() - 1);
+        return bilinear(m_Levels[level], uv.x, uv.y, true);
+    }
+
+    // GL_CLAMP_TO_EDGE on the base level, for the cube map faces
+    glm::vec3 sampleClamped(float s, float t) const { return bilinear(m_Levels[0], s, t, false); }
+
+private:
+    struct Level {
+        int width = 0;
+        int height = 0;
+        std::vector<unsigned char> texels;
+    };
+
+    std::vector<Level> m_Levels;
+    float m_LodBias = 0.0f;
+
+    static Level downsample(const Level &source) {
+        Level level;
+        level.width = std::max(source.width / 2, 1);
+        level.height = std::max(source.height / 2, 1);
+        level.texels.resize((size_t) level.width * level.height * 3);
+        for (int y = 0; y < level.height; y++) {
+            int y0 = std::min(2 * y, source.height - 1), y1 = std::min(2 * y + 1, source.height - 1);
+            for (int x = 0; x < level.width; x++) {
+                int x0 = std::min(2 * x, source.width - 1), x1 = std::min(2 * x + 1, source.width - 1);
+                for (int c = 0; c < 3; c++) {
+                    int sum = source.texels[((size_t) y0 * source.width + x0) * 3 + c]
+                              + source.texels[((size_t) y0 * source.width + x1) * 3 + c]
+                              + source.texels[((size_t) y1 * source.width + x0) * 3 + c]
+                              + source.texels[((size_t) y1 * source.width + x1) * 3 + c];
+                    level.texels[((size_t) y * level.width + x) * 3 + c] = (unsigned char) ((sum + 2) / 4);
+                }
+            }
+        }
+        return level;
+    }
+
+    static int wrap(int i, int size, bool repeat) {
+        return repeat ? ((i % size) + size) % size : std::min(std::max(i, 0), size - 1);
+    }
+
+    static glm::vec3 bilinear(const Level &level, float s, float t, bool repeat) {
+        float x = s * level.width - 0.5f, y = t * level.height - 0.5f;
+        if (repeat) {
+            // keeps the integer part small for texture coordinates far from [0, 1]
+            x -= std::floor(x / level.width) * level.width;
+            y -= std::floor(y / level.height) * level.height;
+        }
+        float fx = std::floor(x), fy = std::floor(y);
+        float wx = x - fx, wy = y - fy;
+        int x0 = wrap((int) fx, level.width, repeat), x1 = wrap((int) fx + 1, level.width, repeat);
+        int y0 = wrap((int) fy, level.height, repeat), y1 = wrap((int) fy + 1, level.height, repeat);
+        const unsigned char *t00 = &level.texels[((size_t) y0 * level.width + x0) * 3];
+        const unsigned char *t10 = &level.texels[((size_t) y0 * level.width + x1) * 3];
+        const unsigned char *t01 = &level.texels[((size_t) y1 * level.width + x0) * 3];
+        const unsigned char *t11 = &level.texels[((size_t) y1 * level.width + x1) * 3];
+        glm::vec3 color;
+        for (int c = 0; c < 3; c++) {
+            float top = t00[c] + (t10[c] - t00[c]) * wx;
+            float bottom = t01[c] + (t11[c] - t01[c]) * wx;
+            color[c] = (top + (bottom - top) * wy) / 255.0f;
+        }
+        return color;
+    }
+};
+
+// the six faces in the order of GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, sampled like a GL cube map
+class SoftwareCubeMap {
+public:
+    bool load(const std::vector<std::string> &faces) {
+        bool loaded = faces.size() == 6;
+        for (unsigned int i = 0; i < 6 && loaded; i++)
+            loaded = m_Faces[i].load(faces[i], false);
+        return m_Loaded = loaded;
+    }
+
+    glm::vec3 sample(const glm::vec3 &direction) const {
+        if (!m_Loaded)
+            return glm::vec3(0.0f);
+        // face selection and (sc, tc) of the GL specification's cube map table
+        glm::vec3 a = glm::abs(direction);
+        int face;
+        float sc, tc, ma;
+        if (a.x >= a.y && a.x >= a.z) {
+            face = direction.x > 0.0f ? 0 : 1;
+            sc = direction.x > 0.0f ? -direction.z : direction.z;
+            tc = -direction.y;
+            ma = a.x;
+        } else if (a.y >= a.z) {
+            face = direction.y > 0.0f ? 2 : 3;
+            sc = direction.x;
+            tc = direction.y > 0.0f ? direction.z : -direction.z;
+            ma = a.y;
+        } else {
+            face = direction.z > 0.0f ? 4 : 5;
+            sc = direction.z > 0.0f ? direction.x : -direction.x;
+            tc = -direction.y;
+            ma = a.z;
+        }
+        return m_Faces[face].sampleClamped(0.5f * (sc / ma + 1.0f), 0.5f * (tc / ma + 1.0f));
+    }
+
+private:
+    SoftwareTexture m_Faces[6];
+    bool m_Loaded = false;
+};
+
+class SoftwareRenderer {
+public:
+    static const int TileSize = 32;
+    static const int SubpixelBits = 4;
+    static const int MaxSize = 4096;
+
+    struct PointLight {
+        glm::vec3 position;
+        glm::vec3 ambient;
+        glm::vec3 diffuse;
+        glm::vec3 specular;
+        float constant;
+        float linear;
+        float quadratic;
+    };
+
+    struct DirLight {
+        glm::vec3 direction;
+        glm::vec3 ambient;
+        glm::vec3 diffuse;
+        glm::vec3 specular;
+    };
+
+    struct Lights {
+        PointLight point;
+        std::vector<DirLight> directional;
+        float shininess = 32.0f;
+    };
+
+    struct Stats {
+        // submitted, and left after culling and clipping
+        unsigned long long triangles = 0;
+        unsigned long long rasterized = 0;
+        unsigned long long shadedPixels = 0;
+        unsigned int drawCalls = 0;
+        double geometryMs = 0.0;
+        double tileMs = 0.0;
+    };
+
+    explicit SoftwareRenderer(JobSystem &jobSystem) : m_JobSystem(jobSystem) {
+#ifdef RG_SOFTWARE_AVX2
+        m_Avx2 = __builtin_cpu_supports("avx2");
+#endif
+    }
+
+    bool avx2() const { return m_Avx2; }
+    int width() const { return m_Width; }
+    int height() const { return m_Height; }
+
+    void resize(int width, int height) {
+        m_Width = std::min(std::max(width, 1), MaxSize);
+        m_Height = std::min(std::max(height, 1), MaxSize);
+        m_TilesX = (m_Width + TileSize - 1) / TileSize;
+        m_TilesY = (m_Height + TileSize - 1) / TileSize;
+        m_Depth.assign((size_t) m_Width * m_Height, 1.0f);
+        m_Ids.assign((size_t) m_Width * m_Height, 0);
+        m_Color.assign((size_t) m_Width * m_Height * 3, 0);
+        m_TilePixels.assign(m_TilesX * m_TilesY, 0);
+        for (std::vector<std::vector<uint32_t>> &bins : m_Bins)
+            bins.assign(m_TilesX * m_TilesY, std::vector<uint32_t>());
+    }
+
+    bool loadSkybox(const std::vector<std::string> &faces) { return m_Skybox.load(faces); }
+
+    void beginFrame(const glm::mat4 &view, const glm::mat4 &projection, const glm::vec3 &viewPosition,
+                    const Lights &lights) {
+        m_ViewProjection = projection * view;
+        m_Projection = projection;
+        m_ViewRotationInverse = glm::transpose(glm::mat3(view));
+        m_ViewPosition = viewPosition;
+        m_Lights = lights;
+        m_Draws.clear();
+    }
+
+    // lit meshes get the lighting of earth.fs, the others shader.fs's diffuse times emissiveStrength
+    void draw(const Model &model, const glm::mat4 &transform, bool lit, float emissiveStrength = 1.0f) {
+        const std::vector<MeshMaterial> &materials = materialsOf(model);
+        for (unsigned int i = 0; i < model.meshes.size(); i++) {
+            if (model.meshes[i].indices.size() < 3)
+                continue;
+            Draw draw;
+            draw.mesh = &model.meshes[i];
+            draw.transform = transform;
+            draw.normalMatrix = glm::mat3(transform);
+            draw.material = materials[i];
+            draw.lit = lit;
+            draw.emissiveStrength = emissiveStrength;
+            m_Draws.push_back(draw);
+        }
+    }
+
+    // renders the recorded draws; the result stays in the color and depth buffers
+    void endFrame(float exposure) {
+        auto start = std::chrono::steady_clock::now();
+        m_Stats = Stats();
+        m_Stats.drawCalls = m_Draws.size();
+        buildBatches();
+        m_JobSystem.parallelFor(m_BatchFirstSpan.size() - 1, 1, [this](unsigned int begin, unsigned int end) {
+            for (unsigned int batch = begin; batch < end; batch++)
+                processBatch(batch);
+        });
+        for (unsigned int batch = 0; batch + 1 < m_BatchFirstSpan.size(); batch++)
+            m_Stats.rasterized += m_Triangles[batch].size();
+        auto geometryEnd = std::chrono::steady_clock::now();
+
+        m_Exposure = exposure;
+        m_JobSystem.parallelFor(m_TilesX * m_TilesY, 1, [this](unsigned int begin, unsigned int end) {
+            for (unsigned int tile = begin; tile < end; tile++)
+                renderTile(tile);
+        });
+        for (unsigned int pixels : m_TilePixels)
+            m_Stats.shadedPixels += pixels;
+        auto end = std::chrono::steady_clock::now();
+        m_Stats.geometryMs = std::chrono::duration<double, std::milli>(geometryEnd - start).count();
+        m_Stats.tileMs = std::chrono::duration<double, std::milli>(end - geometryEnd).count();
+    }
+
+    const Stats &stats() const { return m_Stats; }
+
+    // RGB, rows bottom up like glReadPixels
+    const std::vector<unsigned char> &color() const { return m_Color; }
+
+    bool writeColorPng(const std::string &path) const {
+        return writePng(path, m_Width, m_Height, 3, &m_Color[0], true);
+    }
+
+    // distance from the camera, white at the camera and black at the far plane and for the sky
+    bool writeDepthPng(const std::string &path) const {
+        std::vector<unsigned char> gray(m_Depth.size());
+        float p22 = m_Projection[2][2], p32 = m_Projection[3][2];
+        float far = p32 / (1.0f + p22);
+        for (size_t i = 0; i < m_Depth.size(); i++) {
+            float distance = p32 / (2.0f * m_Depth[i] - 1.0f + p22);
+            gray[i] = (unsigned char) (255.0f * std::min(std::max(1.0f - distance / far, 0.0f), 1.0f) + 0.5f);
+        }
+        return writePng(path, m_Width, m_Height, 1, &gray[0], true);
+    }
+
+private:
+    // how far outside the viewport vertices may lie before triangles are clipped, in halves of
+    // the viewport; it keeps the edge function coefficients small enough for 32 bit lanes
+    static constexpr float GuardBand = 4.0f;
+    // triangle ids are (batch << 24 | index) + 1, 0 is no triangle
+    static const unsigned int MaxBatches = 254;
+    static const unsigned int MinBatchTriangles = 4096;
+    static const int AttributeCount = 8;
+
+    struct MeshMaterial {
+        const SoftwareTexture *diffuse = nullptr;
+        const SoftwareTexture *specular = nullptr;
+    };
+
+    struct Draw {
+        const Mesh *mesh;
+        glm::mat4 transform;
+        glm::mat3 normalMatrix;
+        MeshMaterial material;
+        bool lit;
+        float emissiveStrength;
+    };
+
+    // triangles [first, first + count) of a draw, part of a batch
+    struct Span {
+        unsigned int draw;
+        unsigned int first;
+        unsigned int count;
+    };
+
+    // world position, normal and texture coordinates, like the outputs of earth.vs
+    struct ClipVertex {
+        glm::vec4 position;
+        float attributes[AttributeCount];
+    };
+
+    struct Triangle {
+        // edge functions a * x + b * y + c in 1/16 pixel units, edge i is opposite vertex i
+        int32_t a[3];
+        int32_t b[3];
+        int64_t c[3];
+        // 1 where c was lowered by the top-left rule, added back for interpolation
+        int bias[3];
+        int minX, minY, maxX, maxY;
+        // window depth at the center of pixel (minX, minY) and its change per pixel
+        float z;
+        float dzdx, dzdy;
+        float invW[3];
+        float attributes[3][AttributeCount];
+        // 1 / (2 * area) in 1/16 pixel units
+        float invArea;
+        // log2 of the texture coordinate change per pixel
+        float lod;
+        unsigned int draw;
+    };
+
+    JobSystem &m_JobSystem;
+    bool m_Avx2 = false;
+    int m_Width = 0;
+    int m_Height = 0;
+    int m_TilesX = 0;
+    int m_TilesY = 0;
+    std::vector<float> m_Depth;
+    std::vector<uint32_t> m_Ids;
+    std::vector<unsigned char> m_Color;
+    std::vector<unsigned int> m_TilePixels;
+
+    glm::mat4 m_ViewProjection;
+    glm::mat4 m_Projection;
+    glm::mat3 m_ViewRotationInverse;
+    glm::vec3 m_ViewPosition;
+    Lights m_Lights;
+    float m_Exposure = 1.0f;
+    SoftwareCubeMap m_Skybox;
+
+    std::vector<Draw> m_Draws;
+    std::vector<Span> m_Spans;
+    // spans of batch i are [m_BatchFirstSpan[i], m_BatchFirstSpan[i + 1])
+    std::vector<unsigned int> m_BatchFirstSpan;
+    std::vector<std::vector<Triangle>> m_Triangles;
+    // per batch and tile, indices into m_Triangles[batch]
+    std::vector<std::vector<std::vector<uint32_t>>> m_Bins;
+
+    std::map<std::string, std::unique_ptr<SoftwareTexture>> m_Textures;
+    std::map<const Model *, std::vector<MeshMaterial>> m_Materials;
+    Stats m_Stats;
+
+    const SoftwareTexture *texture(const std::string &path) {
+        auto found = m_Textures.find(path);
+        if (found != m_Textures.end())
+            return found->second.get();
+        std::unique_ptr<SoftwareTexture> texture(new SoftwareTexture());
+        if (!texture->load(path, true))
+            texture.reset();
+        return (m_Textures[path] = std::move(texture)).get();
+    }
+
+    // Mesh::Draw only binds the maps a mesh has and the material samplers are never set, so like
+    // on the GL path a mesh without a specular map samples its diffuse map (texture unit 0), and a
+    // mesh without a diffuse map the diffuse map of the mesh drawn before it
+    const std::vector<MeshMaterial> &materialsOf(const Model &model) {
+        auto found = m_Materials.find(&model);
+        if (found != m_Materials.end())
+            return found->second;
+        std::vector<MeshMaterial> &materials = m_Materials[&model];
+        const SoftwareTexture *unit0 = nullptr;
+        for (const Mesh &mesh : model.meshes) {
+            MeshMaterial material;
+            bool hasDiffuse = false;
+            for (const Texture &map : mesh.textures) {
+                if (map.type == "texture_diffuse" && !hasDiffuse) {
+                    material.diffuse = texture(model.directory + '/' + map.path);
+                    hasDiffuse = true;
+                } else if (map.type == "texture_specular" && material.specular == nullptr) {
+                    material.specular = texture(model.directory + '/' + map.path);
+                }
+            }
+            if (!hasDiffuse)
+                material.diffuse = unit0;
+            unit0 = material.diffuse;
+            if (material.specular == nullptr)
+                material.specular = material.diffuse;
+            materials.push_back(material);
+        }
+        return materials;
+    }
+
+    // splits the draws into at most MaxBatches batches, enough of them to keep every thread busy
+    void buildBatches() {
+        unsigned long long total = 0;
+        for (const Draw &draw : m_Draws)
+            total += draw.mesh->indices.size() / 3;
+        m_Stats.triangles = total;
+        unsigned long long perBatch = std::max<unsigned long long>(
+                {(unsigned long long) MinBatchTriangles, (total + 4 * m_JobSystem.threadCount() - 1) / (4 * m_JobSystem.threadCount()),
+                 (total + MaxBatches - 1) / MaxBatches});
+        m_Spans.clear();
+        m_BatchFirstSpan.assign(1, 0);
+        unsigned long long inBatch = 0;
+        for (unsigned int i = 0; i < m_Draws.size(); i++) {
+            unsigned int count = m_Draws[i].mesh->indices.size() / 3;
+            for (unsigned int first = 0; first < count;) {
+                unsigned int take = (unsigned int) std::min<unsigned long long>(count - first, perBatch - inBatch);
+                m_Spans.push_back({i, first, take});
+                first += take;
+                inBatch += take;
+                if (inBatch == perBatch) {
+                    m_BatchFirstSpan.push_back(m_Spans.size());
+                    inBatch = 0;
+                }
+            }
+        }
+        if (inBatch > 0)
+            m_BatchFirstSpan.push_back(m_Spans.size());
+        unsigned int batches = m_BatchFirstSpan.size() - 1;
+        if (m_Triangles.size() < batches) {
+            m_Triangles.resize(batches);
+            m_Bins.resize(batches, std::vector<std::vector<uint32_t>>(m_TilesX * m_TilesY));
+        }
+    }
+
+    ClipVertex transform(const Draw &draw, unsigned int index) const {
+        const Vertex &vertex = draw.mesh->vertices[index];
+        ClipVertex out;
+        glm::vec4 world = draw.transform * glm::vec4(vertex.Position, 1.0f);
+        glm::vec3 normal = draw.normalMatrix * vertex.Normal;
+        out.position = m_ViewProjection * world;
+        out.attributes[0] = world.x;
+        out.attributes[1] = world.y;
+        out.attributes[2] = world.z;
+        out.attributes[3] = normal.x;
+        out.attributes[4] = normal.y;
+        out.attributes[5] = normal.z;
+        out.attributes[6] = vertex.TexCoords.x;
+        out.attributes[7] = vertex.TexCoords.y;
+        return out;
+    }
+
+    void processBatch(unsigned int batch) {
+        std::vector<Triangle> &triangles = m_Triangles[batch];
+        std::vector<std::vector<uint32_t>> &bins = m_Bins[batch];
+        triangles.clear();
+        for (std::vector<uint32_t> &bin : bins)
+            bin.clear();
+        std::vector<ClipVertex> vertices;
+        for (unsigned int s = m_BatchFirstSpan[batch]; s < m_BatchFirstSpan[batch + 1]; s++) {
+            const Span &span = m_Spans[s];
+            const Draw &draw = m_Draws[span.draw];
+            const unsigned int *indices = &draw.mesh->indices[span.first * 3];
+            // the vertices the span uses are transformed once when they are close together, as
+            // they are in the meshes ASSIMP produces, and per corner otherwise
+            unsigned int low = *std::min_element(indices, indices + span.count * 3);
+            unsigned int high = *std::max_element(indices, indices + span.count * 3);
+            bool shared = high - low < span.count * 3;
+            if (shared) {
+                vertices.resize(high - low + 1);
+                for (unsigned int i = low; i <= high; i++)
+                    vertices[i - low] = transform(draw, i);
+            }
+            for (unsigned int t = 0; t < span.count; t++) {
+                ClipVertex corners[3];
+                for (int k = 0; k < 3; k++)
+                    corners[k] = shared ? vertices[indices[t * 3 + k] - low] : transform(draw, indices[t * 3 + k]);
+                clipAndSetup(corners, span.draw, batch);
+            }
+        }
+    }
+
+    // signed distances to the near and far planes and the guard band, negative outside
+    static void planeDistances(const glm::vec4 &p, float distances[6]) {
+        distances[0] = p.z + p.w;
+        distances[1] = p.w - p.z;
+        distances[2] = GuardBand * p.w - p.x;
+        distances[3] = GuardBand * p.w + p.x;
+        distances[4] = GuardBand * p.w - p.y;
+        distances[5] = GuardBand * p.w + p.y;
+    }
+
+    static unsigned int frustumOutcode(const glm::vec4 &p) {
+        return (p.x > p.w ? 1u : 0u) | (p.x < -p.w ? 2u : 0u) | (p.y > p.w ? 4u : 0u) | (p.y < -p.w ? 8u : 0u)
+               | (p.z > p.w ? 16u : 0u) | (p.z < -p.w ? 32u : 0u);
+    }
+
+    void clipAndSetup(const ClipVertex corners[3], unsigned int draw, unsigned int batch) {
+        if (frustumOutcode(corners[0].position) & frustumOutcode(corners[1].position) & frustumOutcode(corners[2].position))
+            return;
+        unsigned int outside = 0;
+        for (int k = 0; k < 3; k++) {
+            float distances[6];
+            planeDistances(corners[k].position, distances);
+            for (int p = 0; p < 6; p++)
+                outside |= distances[p] < 0.0f ? 1u << p : 0u;
+        }
+        if (outside == 0) {
+            setup(corners[0], corners[1], corners[2], draw, batch);
+            return;
+        }
+
+        // Sutherland-Hodgman against the planes some corner is outside of, then a fan
+        ClipVertex polygon[2][9];
+        int count = 3;
+        std::copy(corners, corners + 3, polygon[0]);
+        int current = 0;
+        for (int p = 0; p < 6 && count >= 3; p++) {
+            if (!(outside & (1u << p)))
+                continue;
+            const ClipVertex *in = polygon[current];
+            ClipVertex *out = polygon[1 - current];
+            int outCount = 0;
+            for (int i = 0; i < count; i++) {
+                const ClipVertex &from = in[i], &to = in[(i + 1) % count];
+                float d0[6], d1[6];
+                planeDistances(from.position, d0);
+                planeDistances(to.position, d1);
+                if (d0[p] >= 0.0f)
+                    out[outCount++] = from;
+                if ((d0[p] >= 0.0f) != (d1[p] >= 0.0f)) {
+                    float t = d0[p] / (d0[p] - d1[p]);
+                    ClipVertex &v = out[outCount++];
+                    v.position = from.position + (to.position - from.position) * t;
+                    for (int a = 0; a < AttributeCount; a++)
+                        v.attributes[a] = from.attributes[a] + (to.attributes[a] - from.attributes[a]) * t;
+                }
+            }
+            count = outCount;
+            current = 1 - current;
+        }
+        for (int i = 1; i + 1 < count; i++)
+            setup(polygon[current][0], polygon[current][i], polygon[current][i + 1], draw, batch);
+    }
+
+    void setup(const ClipVertex &v0, const ClipVertex &v1, const ClipVertex &v2, unsigned int draw, unsigned int batch) {
+        const ClipVertex *v[3] = {&v0, &v1, &v2};
+        const float scale = (float) (1 << SubpixelBits);
+        int64_t x[3], y[3];
+        float z[3];
+        Triangle triangle;
+        for (int k = 0; k < 3; k++) {
+            float invW = 1.0f / v[k]->position.w;
+            x[k] = (int64_t) std::lrint((v[k]->position.x * invW * 0.5f + 0.5f) * m_Width * scale);
+            y[k] = (int64_t) std::lrint((v[k]->position.y * invW * 0.5f + 0.5f) * m_Height * scale);
+            z[k] = v[k]->position.z * invW * 0.5f + 0.5f;
+            triangle.invW[k] = invW;
+            for (int a = 0; a < AttributeCount; a++)
+                triangle.attributes[k][a] = v[k]->attributes[a] * invW;
+        }
+        // counter-clockwise is the front face, like glCullFace(GL_BACK)
+        int64_t area2 = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+        if (area2 <= 0)
+            return;
+
+        // pixels whose centers can be inside
+        const int64_t half = 1 << (SubpixelBits - 1);
+        int64_t minX = std::min({x[0], x[1], x[2]}), maxX = std::max({x[0], x[1], x[2]});
+        int64_t minY = std::min({y[0], y[1], y[2]}), maxY = std::max({y[0], y[1], y[2]});
+        triangle.minX = (int) std::max<int64_t>(floorDiv(minX - half + (1 << SubpixelBits) - 1, 1 << SubpixelBits), 0);
+        triangle.minY = (int) std::max<int64_t>(floorDiv(minY - half + (1 << SubpixelBits) - 1, 1 << SubpixelBits), 0);
+        triangle.maxX = (int) std::min<int64_t>(floorDiv(maxX - half, 1 << SubpixelBits), m_Width - 1);
+        triangle.maxY = (int) std::min<int64_t>(floorDiv(maxY - half, 1 << SubpixelBits), m_Height - 1);
+        if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+            return;
+
+        double zdx = 0.0, zdy = 0.0, zAtMin = 0.0;
+        int64_t px = ((int64_t) triangle.minX << SubpixelBits) + half, py = ((int64_t) triangle.minY << SubpixelBits) + half;
+        for (int k = 0; k < 3; k++) {
+            int i = (k + 1) % 3, j = (k + 2) % 3;
+            int64_t a = y[i] - y[j], b = x[j] - x[i];
+            int64_t c = -(a * x[i] + b * y[i]);
+            // top-left rule: an edge shared by two triangles belongs to the one it runs up or left in
+            triangle.bias[k] = a > 0 || (a == 0 && b < 0) ? 0 : 1;
+            triangle.a[k] = (int32_t) a;
+            triangle.b[k] = (int32_t) b;
+            triangle.c[k] = c - triangle.bias[k];
+            zdx += (double) a * z[k];
+            zdy += (double) b * z[k];
+            zAtMin += (double) (a * px + b * py + c) * z[k];
+        }
+        triangle.invArea = (float) (1.0 / area2);
+        triangle.z = (float) (zAtMin / area2);
+        triangle.dzdx = (float) (zdx * scale / area2);
+        triangle.dzdy = (float) (zdy * scale / area2);
+
+        glm::vec2 uv0(v0.attributes[6], v0.attributes[7]), uv1(v1.attributes[6], v1.attributes[7]),
+                uv2(v2.attributes[6], v2.attributes[7]);
+        float uvArea = std::abs((uv1.x - uv0.x) * (uv2.y - uv0.y) - (uv1.y - uv0.y) * (uv2.x - uv0.x));
+        float pixelArea = (float) area2 / (scale * scale);
+        triangle.lod = uvArea > 0.0f ? 0.5f * std::log2(uvArea / pixelArea) : -64.0f;
+        triangle.draw = draw;
+
+        std::vector<Triangle> &triangles = m_Triangles[batch];
+        if (triangles.size() >= (1u << 24))
+            return;
+        uint32_t index = triangles.size();
+        triangles.push_back(triangle);
+        std::vector<std::vector<uint32_t>> &bins = m_Bins[batch];
+        for (int ty = triangle.minY / TileSize; ty <= triangle.maxY / TileSize; ty++)
+            for (int tx = triangle.minX / TileSize; tx <= triangle.maxX / TileSize; tx++)
+                bins[ty * m_TilesX + tx].push_back(index);
+    }
+
+    static int64_t floorDiv(int64_t value, int64_t divisor) {
+        return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+    }
+
+    void renderTile(unsigned int tile) {
+        int x0 = (tile % m_TilesX) * TileSize, y0 = (tile / m_TilesX) * TileSize;
+        int x1 = std::min(x0 + TileSize, m_Width) - 1, y1 = std::min(y0 + TileSize, m_Height) - 1;
+        for (int y = y0; y <= y1; y++) {
+            std::fill(&m_Depth[(size_t) y * m_Width + x0], &m_Depth[(size_t) y * m_Width + x1] + 1, 1.0f);
+            std::fill(&m_Ids[(size_t) y * m_Width + x0], &m_Ids[(size_t) y * m_Width + x1] + 1, 0u);
+        }
+
+        for (unsigned int batch = 0; batch + 1 < m_BatchFirstSpan.size(); batch++) {
+            for (uint32_t index : m_Bins[batch][tile]) {
+                const Triangle &t = m_Triangles[batch][index];
+                int rx0 = std::max(x0, t.minX), ry0 = std::max(y0, t.minY);
+                int rx1 = std::min(x1, t.maxX), ry1 = std::min(y1, t.maxY);
+                if (rx0 > rx1 || ry0 > ry1)
+                    continue;
+                uint32_t id = (batch << 24 | index) + 1;
+#ifdef RG_SOFTWARE_AVX2
+                if (m_Avx2) {
+                    rasterizeAvx2(t, id, rx0, ry0, rx1, ry1, &m_Depth[0], &m_Ids[0], m_Width);
+                    continue;
+                }
+#endif
+                rasterizeScalar(t, id, rx0, ry0, rx1, ry1);
+            }
+        }
+
+        unsigned int shaded = 0;
+        for (int y = y0; y <= y1; y++) {
+            for (int x = x0; x <= x1; x++) {
+                size_t pixel = (size_t) y * m_Width + x;
+                glm::vec3 color;
+                if (m_Ids[pixel] == 0) {
+                    color = sky(x, y);
+                } else {
+                    uint32_t id = m_Ids[pixel] - 1;
+                    color = shade(m_Triangles[id >> 24][id & 0xffffff], x, y);
+                    shaded++;
+                }
+                for (int c = 0; c < 3; c++)
+                    m_Color[pixel * 3 + c] = (unsigned char) (acesFilm(color[c] * m_Exposure) * 255.0f + 0.5f);
+            }
+        }
+        m_TilePixels[tile] = shaded;
+    }
+
+    void rasterizeScalar(const Triangle &t, uint32_t id, int x0, int y0, int x1, int y1) {
+        const int64_t half = 1 << (SubpixelBits - 1);
+        for (int y = y0; y <= y1; y++) {
+            int64_t py = ((int64_t) y << SubpixelBits) + half;
+            for (int x = x0; x <= x1; x++) {
+                int64_t px = ((int64_t) x << SubpixelBits) + half;
+                if (t.a[0] * px + t.b[0] * py + t.c[0] < 0 || t.a[1] * px + t.b[1] * py + t.c[1] < 0
+                    || t.a[2] * px + t.b[2] * py + t.c[2] < 0)
+                    continue;
+                float z = t.z + t.dzdx * (x - t.minX) + t.dzdy * (y - t.minY);
+                size_t pixel = (size_t) y * m_Width + x;
+                if (z < m_Depth[pixel]) {
+                    m_Depth[pixel] = z;
+                    m_Ids[pixel] = id;
+                }
+            }
+        }
+    }
+
+#ifdef RG_SOFTWARE_AVX2
+    // Edges that are inside over the whole rectangle are dropped and a triangle with an edge that
+    // is outside over all of it is skipped; on the rest the edge functions stay far below 2^31, so
+    // they are stepped in 32 bit lanes.
+    __attribute__((target("avx2"))) static void rasterizeAvx2(const Triangle &t, uint32_t id, int x0, int y0, int x1,
+                                                              int y1, float *depth, uint32_t *ids, int stride) {
+        const int64_t half = 1 << (SubpixelBits - 1);
+        int64_t px = ((int64_t) x0 << SubpixelBits) + half, py = ((int64_t) y0 << SubpixelBits) + half;
+        int32_t row[3], stepX[3], stepY[3];
+        int active = 0;
+        for (int k = 0; k < 3; k++) {
+            int64_t e = t.a[k] * px + t.b[k] * py + t.c[k];
+            int64_t dx = ((int64_t) t.a[k] << SubpixelBits) * (x1 - x0);
+            int64_t dy = ((int64_t) t.b[k] << SubpixelBits) * (y1 - y0);
+            int64_t lowest = e + std::min<int64_t>(dx, 0) + std::min<int64_t>(dy, 0);
+            int64_t highest = e + std::max<int64_t>(dx, 0) + std::max<int64_t>(dy, 0);
+            if (highest < 0)
+                return;
+            if (lowest >= 0)
+                continue;
+            row[active] = (int32_t) e;
+            stepX[active] = t.a[k] << SubpixelBits;
+            stepY[active] = t.b[k] << SubpixelBits;
+            active++;
+        }
+
+        const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        const __m256 laneOffsets = _mm256_cvtepi32_ps(lanes);
+        const __m256i minusOne = _mm256_set1_epi32(-1);
+        const __m256i idVector = _mm256_set1_epi32((int) id);
+        const __m256 dzdx = _mm256_set1_ps(t.dzdx);
+        __m256i laneSteps[3];
+        for (int k = 0; k < active; k++)
+            laneSteps[k] = _mm256_mullo_epi32(lanes, _mm256_set1_epi32(stepX[k]));
+
+        for (int y = y0; y <= y1; y++) {
+            float zRow = t.z + t.dzdx * (x0 - t.minX) + t.dzdy * (y - t.minY);
+            for (int x = x0; x <= x1; x += 8) {
+                __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(std::min(8, x1 - x + 1)), lanes);
+                for (int k = 0; k < active; k++) {
+                    __m256i e = _mm256_add_epi32(_mm256_set1_epi32(row[k] + stepX[k] * (x - x0)), laneSteps[k]);
+                    mask = _mm256_and_si256(mask, _mm256_cmpgt_epi32(e, minusOne));
+                }
+                if (_mm256_testz_si256(mask, mask))
+                    continue;
+                size_t pixel = (size_t) y * stride + x;
+                __m256 z = _mm256_add_ps(_mm256_set1_ps(zRow + t.dzdx * (x - x0)), _mm256_mul_ps(laneOffsets, dzdx));
+                __m256 stored = _mm256_maskload_ps(depth + pixel, mask);
+                __m256i pass = _mm256_and_si256(mask, _mm256_castps_si256(_mm256_cmp_ps(z, stored, _CMP_LT_OQ)));
+                _mm256_maskstore_ps(depth + pixel, pass, z);
+                _mm256_maskstore_epi32((int *) (ids + pixel), pass, idVector);
+            }
+            for (int k = 0; k < active; k++)
+                row[k] += stepY[k];
+        }
+    }
+#endif
+
+    static float acesFilm(float x) {
+        return std::min(std::max((x * (2.51f * x + 0.03f)) / (x * (2.43f * x + 0.59f) + 0.14f), 0.0f), 1.0f);
+    }
+
+    glm::vec3 sky(int x, int y) const {
+        // the skybox cube is drawn with the rotation of the view only, its positions are the lookup directions
+        float ndcX = 2.0f * (x + 0.5f) / m_Width - 1.0f, ndcY = 2.0f * (y + 0.5f) / m_Height - 1.0f;
+        glm::vec3 direction((ndcX + m_Projection[2][0]) / m_Projection[0][0],
+                            (ndcY + m_Projection[2][1]) / m_Projection[1][1], -1.0f);
+        return m_Skybox.sample(m_ViewRotationInverse * direction);
+    }
+
+    glm::vec3 shade(const Triangle &t, int x, int y) const {
+        const int64_t half = 1 << (SubpixelBits - 1);
+        int64_t px = ((int64_t) x << SubpixelBits) + half, py = ((int64_t) y << SubpixelBits) + half;
+        // screen space barycentrics, then perspective correct through the attributes divided by w
+        float weights[3], invW = 0.0f;
+        for (int k = 0; k < 3; k++) {
+            weights[k] = (float) (t.a[k] * px + t.b[k] * py + t.c[k] + t.bias[k]) * t.invArea;
+            invW += weights[k] * t.invW[k];
+        }
+        float attributes[AttributeCount];
+        for (int a = 0; a < AttributeCount; a++)
+            attributes[a] = (weights[0] * t.attributes[0][a] + weights[1] * t.attributes[1][a]
+                             + weights[2] * t.attributes[2][a]) / invW;
+        glm::vec3 position(attributes[0], attributes[1], attributes[2]);
+        glm::vec3 normal(attributes[3], attributes[4], attributes[5]);
+        glm::vec2 uv(attributes[6], attributes[7]);
+
+        const Draw &draw = m_Draws[t.draw];
+        glm::vec3 diffuseMap = draw.material.diffuse ? draw.material.diffuse->sample(uv, t.lod) : glm::vec3(0.0f);
+        if (!draw.lit)
+            return diffuseMap * draw.emissiveStrength;
+        glm::vec3 specularMap = draw.material.specular == draw.material.diffuse
+                                ? diffuseMap
+                                : draw.material.specular ? draw.material.specular->sample(uv, t.lod) : glm::vec3(0.0f);
+
+        normal = glm::normalize(normal);
+        glm::vec3 viewDir = glm::normalize(m_ViewPosition - position);
+        float shininess = m_Lights.shininess;
+
+        // CalcPointLight, without the shadow
+        const PointLight &light = m_Lights.point;
+        glm::vec3 lightDir = glm::normalize(light.position - position);
+        float diff = std::max(glm::dot(normal, lightDir), 0.0f);
+        float spec = std::pow(std::max(glm::dot(normal, glm::normalize(lightDir + viewDir)), 0.0f), shininess);
+        float distance = glm::length(light.position - position);
+        float attenuation = 1.0f / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+        glm::vec3 result = (light.ambient * diffuseMap + light.diffuse * diff * diffuseMap
+                            + light.specular * spec * specularMap.x) * attenuation;
+
+        // CalcDirLight
+        for (const DirLight &dirLight : m_Lights.directional) {
+            lightDir = glm::normalize(-dirLight.direction);
+            diff = std::max(glm::dot(normal, lightDir), 0.0f);
+            spec = std::pow(std::max(glm::dot(normal, glm::normalize(lightDir + viewDir)), 0.0f), shininess);
+            result += dirLight.ambient * diffuseMap + dirLight.diffuse * diff * diffuseMap
+                      + dirLight.specular * spec * specularMap;
+        }
+        return result;
+    }
+};
+
+}
+
+#endif //PROJECT_BASE_SOFTWARERENDERER_H
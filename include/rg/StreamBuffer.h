@@ -0,0 +1,173 @@
+//
+// Ring buffer for data that is rewritten every frame. The buffer is split into one region per
+// frame in flight and sub-allocations inside the current region are handed out by a bump pointer.
+//
+// With glBufferStorage the whole buffer is mapped once (persistent + coherent) and each region is
+// guarded by a fence, so the CPU only waits when it laps the GPU. On plain GL 3.3 the buffer is
+// orphaned every time the ring wraps and regions are written with unsynchronized maps instead.
+//
+
+#ifndef PROJECT_BASE_STREAMBUFFER_H
+#define PROJECT_BASE_STREAMBUFFER_H
+
+#include <glad/glad.h>
+#include <rg/GLExt.h>
+
+#include <chrono>
+#include <cstring>
+
+namespace rg {
+
+class StreamBuffer {
+public:
+    static const int FramesInFlight = 3;
+
+    struct Stats {
+        // how many times beginFrame had to wait for the GPU to release a region
+        unsigned long long stalls = 0;
+        double stallMs = 0.0;
+        double lastFrameStallMs = 0.0;
+        // GL 3.3 fallback only
+        unsigned long long orphans = 0;
+        // a frame needed more than one region, the buffer was recreated twice as big
+        unsigned long long grows = 0;
+    };
+
+    explicit StreamBuffer(GLsizeiptr regionSize) {
+        m_Persistent = glext().hasBufferStorage();
+        create(regionSize);
+    }
+
+    // has to be called before the first upload of a frame
+    void beginFrame() {
+        m_Region = (m_Region + 1) % FramesInFlight;
+        m_Head = 0;
+        m_Stats.lastFrameStallMs = 0.0;
+        if (m_Persistent)
+            waitForRegion(m_Region);
+        else if (m_Region == 0)
+            orphan();
+    }
+
+    // copies size bytes into the current region and returns their offset in buffer(),
+    // the offset is a multiple of alignment (which doesn't have to be a power of two)
+    GLintptr upload(const void *data, GLsizeiptr size, GLsizeiptr alignment = 16) {
+        GLintptr base = m_Region * m_RegionSize;
+        GLsizeiptr offset = (base + m_Head + alignment - 1) / alignment * alignment - base;
+        // nothing to copy, and glMapBufferRange rejects an empty range
+        if (size == 0)
+            return offset <= m_RegionSize ? base + offset : base;
+        if (offset + size > m_RegionSize) {
+            grow(size + alignment);
+            base = 0;
+            offset = 0;
+        }
+        GLintptr absolute = base + offset;
+        if (m_Persistent) {
+            std::memcpy(m_Mapped + absolute, data, size);
+        } else {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, m_Buffer);
+            void *ptr = glMapBufferRange(GL_COPY_WRITE_BUFFER, absolute, size,
+                                         GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+            if (ptr) {
+                std::memcpy(ptr, data, size);
+                glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+            }
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        }
+        m_Head = offset + size;
+        return absolute;
+    }
+
+    // has to be called after the last draw that reads this frame's region was issued
+    void endFrame() {
+        if (!m_Persistent)
+            return;
+        if (m_Fences[m_Region])
+            glDeleteSync(m_Fences[m_Region]);
+        m_Fences[m_Region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    // deletes the buffer and the fences, the GL context has to still be current
+    void destroy() {
+        for (int i = 0; i < FramesInFlight; i++) {
+            if (m_Fences[i])
+                glDeleteSync(m_Fences[i]);
+            m_Fences[i] = 0;
+        }
+        glDeleteBuffers(1, &m_Buffer);
+        m_Buffer = 0;
+        m_Mapped = nullptr;
+    }
+
+    // can change after an upload when the buffer had to grow, so rebind after uploading
+    GLuint buffer() const { return m_Buffer; }
+    bool persistent() const { return m_Persistent; }
+    const Stats& stats() const { return m_Stats; }
+
+private:
+    GLuint m_Buffer = 0;
+    GLsizeiptr m_RegionSize = 0;
+    GLsizeiptr m_Head = 0;
+    int m_Region = 0;
+    bool m_Persistent = false;
+    char *m_Mapped = nullptr;
+    GLsync m_Fences[FramesInFlight] = {};
+    Stats m_Stats;
+
+    void create(GLsizeiptr regionSize) {
+        m_RegionSize = regionSize;
+        glGenBuffers(1, &m_Buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_Buffer);
+        if (m_Persistent) {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_COPY_WRITE_BUFFER, m_RegionSize * FramesInFlight, NULL, flags);
+            m_Mapped = (char *) glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, m_RegionSize * FramesInFlight, flags);
+        } else {
+            glBufferData(GL_COPY_WRITE_BUFFER, m_RegionSize * FramesInFlight, NULL, GL_STREAM_DRAW);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    void waitForRegion(int region) {
+        GLsync fence = m_Fences[region];
+        if (!fence)
+            return;
+        GLenum result = glClientWaitSync(fence, 0, 0);
+        if (result == GL_TIMEOUT_EXPIRED) {
+            m_Stats.stalls++;
+            auto start = std::chrono::steady_clock::now();
+            do {
+                result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+            } while (result == GL_TIMEOUT_EXPIRED);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            m_Stats.stallMs += ms;
+            m_Stats.lastFrameStallMs += ms;
+        }
+        glDeleteSync(fence);
+        m_Fences[region] = 0;
+    }
+
+    void orphan() {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_Buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, m_RegionSize * FramesInFlight, NULL, GL_STREAM_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        m_Stats.orphans++;
+    }
+
+    // the GL keeps the old storage alive until the draws that still read it are done
+    void grow(GLsizeiptr required) {
+        GLsizeiptr regionSize = m_RegionSize * 2;
+        while (regionSize < required)
+            regionSize *= 2;
+        destroy();
+        create(regionSize);
+        m_Region = 0;
+        m_Head = 0;
+        m_Stats.grows++;
+    }
+};
+
+}
+
+#endif //PROJECT_BASE_STREAMBUFFER_H
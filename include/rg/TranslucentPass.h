@@ -0,0 +1,332 @@
+//
+// Draws the blended geometry of the scene after the opaque pass and the skybox.
+//
+// WeightedBlended is the default: every translucent fragment is accumulated into two
+// order-independent targets and resolved over the scene with one fullscreen triangle, so the
+// result and the cost don't depend on the order the objects are submitted in. Sorted is the
+// per-object back-to-front fallback and Unsorted is the plain alpha blending the scene used before.
+//
+// Objects can ask for a reduced resolution (1/2 or 1/4 per axis). They are drawn into a layer of
+// that size that depth tests against a downsampled copy of the scene depth, and the layer is
+// upsampled over the scene with a nearest-depth filter so it doesn't bleed over depth edges.
+//
+// The passes are declared in a FrameGraph; the layer targets are transient textures of the graph
+// and the layers no object uses are culled.
+//
+
+#ifndef PROJECT_BASE_TRANSLUCENTPASS_H
+#define PROJECT_BASE_TRANSLUCENTPASS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/model.h>
+#include <learnopengl/shader.h>
+#include <rg/FrameGraph.h>
+#include <rg/GpuTimer.h>
+#include <rg/RenderTarget.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+enum TransparencyMode {
+    TransparencyUnsorted = 0,
+    TransparencySorted,
+    TransparencyWeightedBlended,
+    TransparencyModeCount
+};
+
+inline const char *transparencyModeName(int mode) {
+    static const char *names[TransparencyModeCount] = {"Unsorted", "Sorted back-to-front", "Weighted blended OIT"};
+    return names[mode];
+}
+
+struct TranslucentObject {
+    Model *model;
+    glm::mat4 transform;
+    // rgb and opacity
+    glm::vec4 tint;
+    // 1, 2 or 4, the layer resolution is the scene resolution divided by it
+    int resolutionDivisor;
+};
+
+class TranslucentPass {
+public:
+    static const int LayerCount = 3;
+
+    // cost of one resolution layer in the last frame it was drawn
+    struct LayerStats {
+        int divisor;
+        double gpuMs;
+        GLuint64 fragments;
+    };
+
+    TranslucentPass()
+            : m_BlendShader("resources/shaders/cd.vs", "resources/shaders/cd.fs"),
+              m_AccumShader("resources/shaders/cd.vs", "resources/shaders/cd_oit.fs"),
+              m_CompositeShader("resources/shaders/fullscreen.vs", "resources/shaders/oit_composite.fs"),
+              m_DownsampleShader("resources/shaders/fullscreen.vs", "resources/shaders/depth_downsample.fs"),
+              m_UpsampleShader("resources/shaders/fullscreen.vs", "resources/shaders/translucent_upsample.fs") {
+        for (int i = 0; i < LayerCount; i++)
+            m_Layers[i].divisor = 1 << i;
+    }
+
+    // near and far plane of the projection, the upsampling compares linear depths
+    void setDepthRange(float nearPlane, float farPlane) {
+        m_Near = nearPlane;
+        m_Far = farPlane;
+    }
+
+    // bit (1 << layer) for every layer that has objects at its resolution
+    static unsigned int usedLayers(const std::vector<TranslucentObject> &objects) {
+        unsigned int layers = 0;
+        for (const TranslucentObject &object : objects) {
+            for (int i = 0; i < LayerCount; i++) {
+                if (object.resolutionDivisor == 1 << i)
+                    layers |= 1u << i;
+            }
+        }
+        return layers;
+    }
+
+    // declares the passes of every layer for the given mode. The full resolution layer depth tests
+    // against the scene's depth without writing it in the order independent modes, the reduced
+    // ones get their own depth buffer that is refilled from it every frame. Passes that composite
+    // into the scene are only added for the layers in `layers`, so the graph culls the rest.
+    void addPasses(FrameGraph &graph, FrameGraph::Resource sceneColor, FrameGraph::Resource sceneDepth, int mode,
+                   unsigned int layers) {
+        const FrameGraph::TextureDesc &scene = graph.desc(sceneColor);
+        for (int i = 0; i < LayerCount; i++) {
+            Layer *layer = &m_Layers[i];
+            bool used = (layers & (1u << i)) != 0;
+            bool reduced = layer->divisor > 1;
+            std::string prefix = "translucent 1/" + std::to_string(layer->divisor) + " ";
+            int w = (scene.width + layer->divisor - 1) / layer->divisor;
+            int h = (scene.height + layer->divisor - 1) / layer->divisor;
+
+            // reduced layers: premultiplied color and transmittance, plus the downsampled depth
+            FrameGraph::Resource target = sceneColor, depth = sceneDepth;
+            if (reduced) {
+                target = graph.createTexture(prefix + "color", {w, h, GL_RGBA16F});
+                depth = graph.createTexture(prefix + "depth", {w, h, GL_DEPTH24_STENCIL8});
+                graph.addPass(prefix + "depth", [this, layer, sceneDepth](const FrameGraph &graph) {
+                    layer->timer.begin();
+                    prepareReducedLayer(*layer, graph.texture(sceneDepth));
+                }).read(sceneDepth).write(target).depthWrite(depth);
+            }
+
+            if (mode == TransparencyWeightedBlended) {
+                FrameGraph::Resource accum = graph.createTexture(prefix + "accum", {w, h, GL_RGBA16F});
+                FrameGraph::Resource weight = graph.createTexture(prefix + "weight", {w, h, GL_R16F});
+                graph.addPass(prefix + "accumulate", [this, layer, reduced](const FrameGraph &) {
+                    if (!reduced)
+                        layer->timer.begin();
+                    accumulate(*layer);
+                }).write(accum).write(weight).depthTest(depth);
+                if (used || reduced) {
+                    graph.addPass(prefix + "resolve", [this, layer, reduced, accum, weight](const FrameGraph &graph) {
+                        resolve(graph.texture(accum), graph.texture(weight));
+                        if (!reduced)
+                            layer->timer.end();
+                    }).read(accum).read(weight).write(target);
+                }
+            } else if (used || reduced) {
+                FrameGraph::Pass &pass = graph.addPass(prefix + "blend", [this, layer, reduced](const FrameGraph &) {
+                    if (!reduced)
+                        layer->timer.begin();
+                    drawBlended(*layer);
+                    if (!reduced)
+                        layer->timer.end();
+                }).write(target);
+                if (reduced)
+                    pass.depthTest(depth);
+                else
+                    pass.depthWrite(depth);
+            }
+
+            if (used && reduced) {
+                graph.addPass(prefix + "upsample", [this, layer, target, depth, sceneDepth](const FrameGraph &graph) {
+                    upsample(*layer, graph.texture(target), graph.texture(depth), graph.texture(sceneDepth));
+                    layer->timer.end();
+                }).read(target).read(depth).read(sceneDepth).write(sceneColor);
+            }
+        }
+    }
+
+    // per frame input of the passes, sorts the objects for the sorted mode and splits them by layer
+    void setFrame(std::vector<TranslucentObject> &objects, const glm::mat4 &view, const glm::mat4 &projection,
+                  const glm::vec3 &cameraPosition, int mode) {
+        m_Objects = &objects;
+        m_View = view;
+        m_Projection = projection;
+        m_Mode = mode;
+        sortObjects(objects, cameraPosition, mode == TransparencySorted);
+        for (Layer &layer : m_Layers) {
+            layer.order.clear();
+            for (unsigned int i : m_Order) {
+                if (objects[i].resolutionDivisor == layer.divisor)
+                    layer.order.push_back(i);
+            }
+        }
+    }
+
+    LayerStats layerStats(int layer) const {
+        LayerStats stats;
+        stats.divisor = m_Layers[layer].divisor;
+        stats.gpuMs = m_Layers[layer].timer.averageMs();
+        stats.fragments = m_Layers[layer].fragments.lastSamples();
+        return stats;
+    }
+
+private:
+    struct Layer {
+        int divisor = 1;
+        // indices into the frame's objects, in drawing order
+        std::vector<unsigned int> order;
+        GpuTimer timer;
+        SampleCounter fragments;
+    };
+
+    Shader m_BlendShader;
+    Shader m_AccumShader;
+    Shader m_CompositeShader;
+    Shader m_DownsampleShader;
+    Shader m_UpsampleShader;
+    Layer m_Layers[LayerCount];
+    float m_Near = 0.1f;
+    float m_Far = 100.0f;
+    std::vector<TranslucentObject> *m_Objects = NULL;
+    glm::mat4 m_View = glm::mat4(1.0f);
+    glm::mat4 m_Projection = glm::mat4(1.0f);
+    int m_Mode = TransparencyWeightedBlended;
+    std::vector<unsigned int> m_Order;
+    std::vector<float> m_Distance;
+
+    void sortObjects(const std::vector<TranslucentObject> &objects, const glm::vec3 &cameraPosition, bool sorted) {
+        m_Order.resize(objects.size());
+        for (unsigned int i = 0; i < m_Order.size(); i++)
+            m_Order[i] = i;
+        if (!sorted)
+            return;
+        // farthest object center first, overlapping volumes of similar size come out right
+        m_Distance.resize(objects.size());
+        for (unsigned int i = 0; i < objects.size(); i++) {
+            glm::vec3 d = glm::vec3(objects[i].transform[3]) - cameraPosition;
+            m_Distance[i] = glm::dot(d, d);
+        }
+        const std::vector<float> &distance = m_Distance;
+        std::sort(m_Order.begin(), m_Order.end(),
+                  [&distance](unsigned int a, unsigned int b) { return distance[a] > distance[b]; });
+    }
+
+    // back faces of translucent volumes stay visible through the front faces
+    void drawObjects(Shader &shader, Layer &layer) {
+        glDisable(GL_CULL_FACE);
+        glEnable(GL_BLEND);
+        shader.use();
+        shader.setMat4("view", m_View);
+        shader.setMat4("projection", m_Projection);
+        layer.fragments.begin();
+        for (unsigned int i : layer.order) {
+            TranslucentObject &object = (*m_Objects)[i];
+            shader.setMat4("model", object.transform);
+            shader.setVec4("tint", object.tint);
+            object.model->Draw(shader);
+        }
+        layer.fragments.end();
+        glDisable(GL_BLEND);
+        glEnable(GL_CULL_FACE);
+    }
+
+    // the target's alpha ends up as the transmittance of everything drawn into it, which is what
+    // the upsampling composite needs; for the scene target the alpha channel isn't used
+    void drawBlended(Layer &layer) {
+        // sorted objects must not hide each other through the depth buffer, reduced layers
+        // never write depth since their depth buffer is rebuilt from the scene each frame
+        if (m_Mode == TransparencySorted || layer.divisor > 1)
+            glDepthMask(GL_FALSE);
+        glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+        drawObjects(m_BlendShader, layer);
+        glDepthMask(GL_TRUE);
+    }
+
+    // the accumulation and weight targets are bound, with the layer's depth for testing
+    void accumulate(Layer &layer) {
+        const GLfloat accumClear[] = {0.0f, 0.0f, 0.0f, 1.0f};
+        const GLfloat weightClear[] = {0.0f, 0.0f, 0.0f, 0.0f};
+        glClearBufferfv(GL_COLOR, 0, accumClear);
+        glClearBufferfv(GL_COLOR, 1, weightClear);
+        glDepthMask(GL_FALSE);
+        glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+        drawObjects(m_AccumShader, layer);
+        glDepthMask(GL_TRUE);
+    }
+
+    // the layer's target is bound
+    void resolve(GLuint accumTexture, GLuint weightTexture) {
+        glDisable(GL_DEPTH_TEST);
+        glEnable(GL_BLEND);
+        glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+        m_CompositeShader.use();
+        m_CompositeShader.setInt("accumTexture", 0);
+        m_CompositeShader.setInt("weightTexture", 1);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, accumTexture);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, weightTexture);
+        drawFullscreenTriangle();
+        glActiveTexture(GL_TEXTURE0);
+        glDisable(GL_BLEND);
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    // fills the bound layer's depth buffer from the scene depth and clears it to fully transparent
+    void prepareReducedLayer(Layer &layer, GLuint sceneDepth) {
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glDepthFunc(GL_ALWAYS);
+        m_DownsampleShader.use();
+        m_DownsampleShader.setInt("sceneDepth", 0);
+        m_DownsampleShader.setInt("divisor", layer.divisor);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, sceneDepth);
+        drawFullscreenTriangle();
+        glDepthFunc(GL_LESS);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+        const GLfloat transparent[] = {0.0f, 0.0f, 0.0f, 1.0f};
+        glClearBufferfv(GL_COLOR, 0, transparent);
+    }
+
+    // the scene color is bound, its depth texture is only read here
+    void upsample(Layer &layer, GLuint layerColor, GLuint layerDepth, GLuint sceneDepth) {
+        glDisable(GL_DEPTH_TEST);
+        glDepthMask(GL_FALSE);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_SRC_ALPHA);
+        m_UpsampleShader.use();
+        m_UpsampleShader.setInt("layerColor", 0);
+        m_UpsampleShader.setInt("layerDepth", 1);
+        m_UpsampleShader.setInt("sceneDepth", 2);
+        m_UpsampleShader.setInt("divisor", layer.divisor);
+        m_UpsampleShader.setFloat("nearPlane", m_Near);
+        m_UpsampleShader.setFloat("farPlane", m_Far);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, layerColor);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, layerDepth);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, sceneDepth);
+        drawFullscreenTriangle();
+        glActiveTexture(GL_TEXTURE0);
+        glDisable(GL_BLEND);
+        glDepthMask(GL_TRUE);
+        glEnable(GL_DEPTH_TEST);
+    }
+};
+
+}
+
+#endif //PROJECT_BASE_TRANSLUCENTPASS_H
@@ -36,6 +36,9 @@ IMGUI_IMPL_API void     ImGui_ImplOpenGL3_DestroyFontsTexture();
 IMGUI_IMPL_API bool     ImGui_ImplOpenGL3_CreateDeviceObjects();
 IMGUI_IMPL_API void     ImGui_ImplOpenGL3_DestroyDeviceObjects();
 
+// (Project) Fence stalls of the vertex/index ring buffers, see include/rg/StreamBuffer.h
+IMGUI_IMPL_API void     ImGui_ImplOpenGL3_GetStreamStats(unsigned long long* stalls, double* stall_ms);
+
 // Specific OpenGL ES versions
 //#define IMGUI_IMPL_OPENGL_ES2     // Auto-detected on Emscripten
 //#define IMGUI_IMPL_OPENGL_ES3     // Auto-detected on iOS/Android
@@ -13,6 +13,7 @@
 
 // CHANGELOG
 // (minor and older changes stripped away, please see git history for details)
+//  (project) OpenGL: Vertex/index data is sub-allocated from rg::StreamBuffer ring buffers instead of glBufferData() per draw list (GL 3.2+, glad loader).
 //  2020-10-23: OpenGL: Save and restore current GL_PRIMITIVE_RESTART state.
 //  2020-10-15: OpenGL: Use glGetString(GL_VERSION) instead of glGetIntegerv(GL_MAJOR_VERSION, ...) when the later returns zero (e.g. Desktop GL 2.x)
 //  2020-09-17: OpenGL: Fix to avoid compiling/calling glBindSampler() on ES or pre 3.3 context which have the defines set by a loader.
@@ -130,6 +131,12 @@ using namespace gl;
 #define IMGUI_IMPL_OPENGL_MAY_HAVE_VTX_OFFSET
 #endif
 
+// Desktop GL 3.2+ with glad: stream vertex/index data through the project's ring buffers (fences and base vertex are 3.2 features)
+#if defined(IMGUI_IMPL_OPENGL_MAY_HAVE_VTX_OFFSET) && defined(IMGUI_IMPL_OPENGL_LOADER_GLAD)
+#include <rg/StreamBuffer.h>
+#define IMGUI_IMPL_OPENGL_HAS_STREAM_BUFFER
+#endif
+
 // Desktop GL 3.3+ has glBindSampler()
 #if !defined(IMGUI_IMPL_OPENGL_ES2) && !defined(IMGUI_IMPL_OPENGL_ES3) && defined(GL_VERSION_3_3)
 #define IMGUI_IMPL_OPENGL_MAY_HAVE_BIND_SAMPLER
@@ -148,6 +155,10 @@ static GLuint       g_ShaderHandle = 0, g_VertHandle = 0, g_FragHandle = 0;
 static GLint        g_AttribLocationTex = 0, g_AttribLocationProjMtx = 0;                                // Uniforms location
 static GLuint       g_AttribLocationVtxPos = 0, g_AttribLocationVtxUV = 0, g_AttribLocationVtxColor = 0; // Vertex attributes location
 static unsigned int g_VboHandle = 0, g_ElementsHandle = 0;
+#ifdef IMGUI_IMPL_OPENGL_HAS_STREAM_BUFFER
+static rg::StreamBuffer* g_VertexStream = NULL;     // Used instead of g_VboHandle/g_ElementsHandle when created (GL 3.2+)
+static rg::StreamBuffer* g_IndexStream = NULL;
+#endif
 
 // Functions
 bool    ImGui_ImplOpenGL3_Init(const char* glsl_version)
@@ -296,8 +307,16 @@ static void ImGui_ImplOpenGL3_SetupRenderState(ImDrawData* draw_data, int fb_wid
 #endif
 
     // Bind vertex/index buffers and setup attributes for ImDrawVert
-    glBindBuffer(GL_ARRAY_BUFFER, g_VboHandle);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_ElementsHandle);
+    GLuint vbo = g_VboHandle, ebo = g_ElementsHandle;
+#ifdef IMGUI_IMPL_OPENGL_HAS_STREAM_BUFFER
+    if (g_VertexStream)
+    {
+        vbo = g_VertexStream->buffer();
+        ebo = g_IndexStream->buffer();
+    }
+#endif
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
     glEnableVertexAttribArray(g_AttribLocationVtxPos);
     glEnableVertexAttribArray(g_AttribLocationVtxUV);
     glEnableVertexAttribArray(g_AttribLocationVtxColor);
@@ -354,6 +373,13 @@ void    ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data)
     GLuint vertex_array_object = 0;
 #ifndef IMGUI_IMPL_OPENGL_ES2
     glGenVertexArrays(1, &vertex_array_object);
+#endif
+#ifdef IMGUI_IMPL_OPENGL_HAS_STREAM_BUFFER
+    if (g_VertexStream)
+    {
+        g_VertexStream->beginFrame();
+        g_IndexStream->beginFrame();
+    }
 #endif
     ImGui_ImplOpenGL3_SetupRenderState(draw_data, fb_width, fb_height, vertex_array_object);
 
@@ -367,8 +393,25 @@ void    ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data)
         const ImDrawList* cmd_list = draw_data->CmdLists[n];
 
         // Upload vertex/index buffers
-        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)cmd_list->VtxBuffer.Size * (int)sizeof(ImDrawVert), (const GLvoid*)cmd_list->VtxBuffer.Data, GL_STREAM_DRAW);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)cmd_list->IdxBuffer.Size * (int)sizeof(ImDrawIdx), (const GLvoid*)cmd_list->IdxBuffer.Data, GL_STREAM_DRAW);
+        GLintptr idx_buffer_offset = 0;
+        GLint vtx_buffer_base = 0;
+#ifdef IMGUI_IMPL_OPENGL_HAS_STREAM_BUFFER
+        if (g_VertexStream)
+        {
+            // Sub-allocate from this frame's region, the attribute pointers stay at offset 0 and the draw uses a base vertex
+            GLuint last_vbo = g_VertexStream->buffer(), last_ebo = g_IndexStream->buffer();
+            GLintptr vtx_offset = g_VertexStream->upload(cmd_list->VtxBuffer.Data, (GLsizeiptr)cmd_list->VtxBuffer.Size * (int)sizeof(ImDrawVert), sizeof(ImDrawVert));
+            idx_buffer_offset = g_IndexStream->upload(cmd_list->IdxBuffer.Data, (GLsizeiptr)cmd_list->IdxBuffer.Size * (int)sizeof(ImDrawIdx), sizeof(ImDrawIdx));
+            vtx_buffer_base = (GLint)(vtx_offset / (GLintptr)sizeof(ImDrawVert));
+            if (g_VertexStream->buffer() != last_vbo || g_IndexStream->buffer() != last_ebo)
+                ImGui_ImplOpenGL3_SetupRenderState(draw_data, fb_width, fb_height, vertex_array_object); // A ring buffer grew, rebind it
+        }
+        else
+#endif
+        {
+            glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)cmd_list->VtxBuffer.Size * (int)sizeof(ImDrawVert), (const GLvoid*)cmd_list->VtxBuffer.Data, GL_STREAM_DRAW);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)cmd_list->IdxBuffer.Size * (int)sizeof(ImDrawIdx), (const GLvoid*)cmd_list->IdxBuffer.Data, GL_STREAM_DRAW);
+        }
 
         for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; cmd_i++)
         {
@@ -400,15 +443,24 @@ void    ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data)
                     glBindTexture(GL_TEXTURE_2D, (GLuint)(intptr_t)pcmd->TextureId);
 #ifdef IMGUI_IMPL_OPENGL_MAY_HAVE_VTX_OFFSET
                     if (g_GlVersion >= 320)
-                        glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, (void*)(intptr_t)(pcmd->IdxOffset * sizeof(ImDrawIdx)), (GLint)pcmd->VtxOffset);
+                        glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, (void*)(intptr_t)(idx_buffer_offset + pcmd->IdxOffset * sizeof(ImDrawIdx)), (GLint)pcmd->VtxOffset + vtx_buffer_base);
                     else
 #endif
-                    glDrawElements(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, (void*)(intptr_t)(pcmd->IdxOffset * sizeof(ImDrawIdx)));
+                    glDrawElements(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, (void*)(intptr_t)(idx_buffer_offset + pcmd->IdxOffset * sizeof(ImDrawIdx)));
                 }
             }
         }
     }
 
+    // Fence this frame's ring buffer regions
+#ifdef IMGUI_IMPL_OPENGL_HAS_STREAM_BUFFER
+    if (g_VertexStream)
+    {
+        g_VertexStream->endFrame();
+        g_IndexStream->endFrame();
+    }
+#endif
+
     // Destroy the temporary VAO
 #ifndef IMGUI_IMPL_OPENGL_ES2
     glDeleteVertexArrays(1, &vertex_array_object);
@@ -686,6 +738,13 @@ bool    ImGui_ImplOpenGL3_CreateDeviceObjects()
     // Create buffers
     glGenBuffers(1, &g_VboHandle);
     glGenBuffers(1, &g_ElementsHandle);
+#ifdef IMGUI_IMPL_OPENGL_HAS_STREAM_BUFFER
+    if (g_GlVersion >= 320)
+    {
+        g_VertexStream = new rg::StreamBuffer(128 * 1024);
+        g_IndexStream = new rg::StreamBuffer(32 * 1024);
+    }
+#endif
 
     ImGui_ImplOpenGL3_CreateFontsTexture();
 
@@ -703,6 +762,10 @@ void    ImGui_ImplOpenGL3_DestroyDeviceObjects()
 {
     if (g_VboHandle)        { glDeleteBuffers(1, &g_VboHandle); g_VboHandle = 0; }
     if (g_ElementsHandle)   { glDeleteBuffers(1, &g_ElementsHandle); g_ElementsHandle = 0; }
+#ifdef IMGUI_IMPL_OPENGL_HAS_STREAM_BUFFER
+    if (g_VertexStream)     { g_VertexStream->destroy(); delete g_VertexStream; g_VertexStream = NULL; }
+    if (g_IndexStream)      { g_IndexStream->destroy(); delete g_IndexStream; g_IndexStream = NULL; }
+#endif
     if (g_ShaderHandle && g_VertHandle) { glDetachShader(g_ShaderHandle, g_VertHandle); }
     if (g_ShaderHandle && g_FragHandle) { glDetachShader(g_ShaderHandle, g_FragHandle); }
     if (g_VertHandle)       { glDeleteShader(g_VertHandle); g_VertHandle = 0; }
@@ -711,3 +774,16 @@ void    ImGui_ImplOpenGL3_DestroyDeviceObjects()
 
     ImGui_ImplOpenGL3_DestroyFontsTexture();
 }
+
+void    ImGui_ImplOpenGL3_GetStreamStats(unsigned long long* stalls, double* stall_ms)
+{
+    *stalls = 0;
+    *stall_ms = 0.0;
+#ifdef IMGUI_IMPL_OPENGL_HAS_STREAM_BUFFER
+    if (g_VertexStream)
+    {
+        *stalls = g_VertexStream->stats().stalls + g_IndexStream->stats().stalls;
+        *stall_ms = g_VertexStream->stats().stallMs + g_IndexStream->stats().stallMs;
+    }
+#endif
+}
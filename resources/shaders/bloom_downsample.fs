@@ -0,0 +1,37 @@
+#version 330 core
+// dual filter downsample, the first pass also keeps only the bright part of the scene
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D source;
+// half an output texel in source texture coordinates
+uniform vec2 offset;
+uniform bool prefilter;
+uniform float threshold;
+uniform float knee;
+
+// soft threshold: quadratic ramp over [threshold - knee, threshold + knee], linear above
+vec3 Prefilter(vec3 color)
+{
+    float brightness = max(color.r, max(color.g, color.b));
+    float soft = clamp(brightness - threshold + knee, 0.0, 2.0 * knee);
+    soft = soft * soft / (4.0 * knee + 1e-5);
+    return color * max(soft, brightness - threshold) / max(brightness, 1e-5);
+}
+
+vec3 Tap(vec2 uv)
+{
+    vec3 color = texture(source, uv).rgb;
+    return prefilter ? Prefilter(color) : color;
+}
+
+void main()
+{
+    vec3 sum = Tap(TexCoords) * 4.0;
+    sum += Tap(TexCoords - offset);
+    sum += Tap(TexCoords + offset);
+    sum += Tap(TexCoords + vec2(offset.x, -offset.y));
+    sum += Tap(TexCoords - vec2(offset.x, -offset.y));
+    FragColor = vec4(sum / 8.0, 1.0);
+}
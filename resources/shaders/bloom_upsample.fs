@@ -0,0 +1,22 @@
+#version 330 core
+// dual filter upsample to the size of the next bigger level
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D source;
+// half a texel of the source level
+uniform vec2 offset;
+
+void main()
+{
+    vec3 sum = texture(source, TexCoords + vec2(-2.0 * offset.x, 0.0)).rgb;
+    sum += texture(source, TexCoords + vec2(-offset.x, offset.y)).rgb * 2.0;
+    sum += texture(source, TexCoords + vec2(0.0, 2.0 * offset.y)).rgb;
+    sum += texture(source, TexCoords + vec2(offset.x, offset.y)).rgb * 2.0;
+    sum += texture(source, TexCoords + vec2(2.0 * offset.x, 0.0)).rgb;
+    sum += texture(source, TexCoords + vec2(offset.x, -offset.y)).rgb * 2.0;
+    sum += texture(source, TexCoords + vec2(0.0, -2.0 * offset.y)).rgb;
+    sum += texture(source, TexCoords + vec2(-offset.x, -offset.y)).rgb * 2.0;
+    FragColor = vec4(sum / 12.0, 1.0);
+}
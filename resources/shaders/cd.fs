@@ -6,13 +6,13 @@ in vec3 Normal;
 in vec3 FragPos;
 
 uniform sampler2D tex;
+// rgb and opacity of the volume, (0.5, 0.5, 0.5, 0.5) for the cosmic dust
+uniform vec4 tint;
 
 // Sejder za kosmicku prasinu ne treba da radi nista drugo sem da vraca njenu boju, kao i da
 // implementira BLENDING
 
 void main()
 {
-
-    vec3 color = vec3(0.5,0.5,0.5).rgb;
-    FragColor = vec4(color, 0.5);
-}
\ No newline at end of file
+    FragColor = tint;
+}
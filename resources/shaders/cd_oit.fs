@@ -0,0 +1,23 @@
+#version 330 core
+// weighted blended order-independent transparency (McGuire and Bavoil, 2013), accumulation pass.
+// Both targets are blended with (ONE, ONE) for color and (ZERO, ONE_MINUS_SRC_ALPHA) for alpha:
+// accum.rgb sums premultiplied color * weight, accum.a ends up as the product of (1 - alpha),
+// weight.r sums alpha * weight.
+layout (location = 0) out vec4 accum;
+layout (location = 1) out vec4 weight;
+
+in vec2 TexCoords;
+in vec3 Normal;
+in vec3 FragPos;
+
+uniform vec4 tint;
+
+void main()
+{
+    vec4 color = tint;
+    // depth weight from equation 10 of the paper, gl_FragCoord.z is close to 1 for far fragments
+    float z = gl_FragCoord.z;
+    float w = clamp(pow(min(1.0, color.a * 10.0) + 0.01, 3.0) * 1e8 * pow(1.0 - z * 0.9, 3.0), 1e-2, 3e3);
+    accum = vec4(color.rgb * color.a * w, color.a);
+    weight = vec4(color.a * w);
+}
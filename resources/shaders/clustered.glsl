@@ -0,0 +1,52 @@
+// clustered point lights, the lists are built on the CPU by rg::ClusteredLights.
+// Included by earth.fs, moon.fs and mdi.fs.
+
+// 3 texels per light: (position, range), (color, constant), (linear, quadratic, -, -)
+uniform samplerBuffer clusterLights;
+// (first index, light count) of every cluster
+uniform usamplerBuffer clusterGrid;
+uniform usamplerBuffer clusterIndices;
+uniform ivec3 clusterDims;
+uniform vec2 clusterViewport;
+uniform float clusterNear;
+uniform float clusterFar;
+
+int ClusterIndex()
+{
+    float ndcDepth = gl_FragCoord.z * 2.0 - 1.0;
+    float viewDepth = 2.0 * clusterNear * clusterFar / (clusterFar + clusterNear - ndcDepth * (clusterFar - clusterNear));
+    int z = int(log(viewDepth / clusterNear) / log(clusterFar / clusterNear) * float(clusterDims.z));
+    ivec2 xy = ivec2(gl_FragCoord.xy / clusterViewport * vec2(clusterDims.xy));
+    xy = clamp(xy, ivec2(0), clusterDims.xy - 1);
+    z = clamp(z, 0, clusterDims.z - 1);
+    return xy.x + clusterDims.x * (xy.y + clusterDims.y * z);
+}
+
+vec3 CalcClusteredLights(vec3 normal, vec3 fragPos, vec3 viewDir, vec3 diffuseTexel, vec3 specularTexel, float shininess)
+{
+    uvec2 cluster = texelFetch(clusterGrid, ClusterIndex()).xy;
+    vec3 result = vec3(0.0);
+    for (uint i = 0u; i < cluster.y; i++) {
+        int light = int(texelFetch(clusterIndices, int(cluster.x + i)).r) * 3;
+        vec4 positionRange = texelFetch(clusterLights, light);
+        vec3 toLight = positionRange.xyz - fragPos;
+        float distance = length(toLight);
+        if (distance >= positionRange.w)
+            continue;
+        // the rest of the light is only fetched once it reaches the fragment
+        vec4 colorConstant = texelFetch(clusterLights, light + 1);
+        vec2 linearQuadratic = texelFetch(clusterLights, light + 2).xy;
+
+        vec3 lightDir = toLight / distance;
+        float diff = max(dot(normal, lightDir), 0.0);
+        // specular shading -- BLINN-PHONG
+        vec3 halfway = normalize(lightDir + viewDir);
+        float spec = pow(max(dot(normal, halfway), 0.0), shininess);
+        float attenuation = 1.0 / (colorConstant.w + linearQuadratic.x * distance + linearQuadratic.y * (distance * distance));
+        // fade out towards the range the light was binned with, so the cut off doesn't show
+        float window = clamp(1.0 - pow(distance / positionRange.w, 4.0), 0.0, 1.0);
+        attenuation *= window * window;
+        result += colorConstant.rgb * attenuation * (diff * diffuseTexel + spec * specularTexel);
+    }
+    return result;
+}
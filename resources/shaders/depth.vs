@@ -0,0 +1,16 @@
+#version 330 core
+// depth pre-pass, reads only the position stream of the mesh (Mesh::depthVAO).
+// gl_Position is computed exactly like in the color pass shaders so GL_EQUAL passes.
+layout (location = 0) in vec3 aPos;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+invariant gl_Position;
+
+void main()
+{
+    vec3 FragPos = vec3(model * vec4(aPos, 1.0));
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
@@ -0,0 +1,17 @@
+#version 330 core
+// writes the farthest scene depth of every divisor x divisor block into the reduced resolution
+// depth buffer; translucent fragments that are hidden only in part of a block are kept and
+// sorted out by the upsampling composite
+uniform sampler2D sceneDepth;
+uniform int divisor;
+
+void main()
+{
+    ivec2 size = textureSize(sceneDepth, 0) - 1;
+    ivec2 base = ivec2(gl_FragCoord.xy) * divisor;
+    float depth = 0.0;
+    for (int y = 0; y < divisor; y++)
+        for (int x = 0; x < divisor; x++)
+            depth = max(depth, texelFetch(sceneDepth, min(base + ivec2(x, y), size), 0).r);
+    gl_FragDepth = depth;
+}
@@ -0,0 +1,56 @@
+// soft eclipse shadows of the point light by the spheres picked on the CPU (rg::selectOccluders).
+// SphereVisibility is mirrored by rg::sphereVisibility in include/rg/Eclipse.h, keep them in sync.
+
+const float ECLIPSE_PI = 3.14159265;
+
+// (center, radius) of the bodies that can shadow this object
+uniform int occluderCount;
+uniform vec4 occluders[4];
+uniform float eclipseLightRadius;
+
+// area of the intersection of two discs with radii r1 and r2 whose centers are d apart. Written with
+// atan instead of the usual acos/asin, which lose too much precision on GPUs at small angles.
+float DiscOverlap(float r1, float r2, float d)
+{
+    if (d >= r1 + r2)
+        return 0.0;
+    float rMin = min(r1, r2);
+    if (d <= max(r1, r2) - rMin)
+        return ECLIPSE_PI * rMin * rMin;
+    // half length of the common chord and its distance from the first center
+    float h = sqrt(max((-d + r1 + r2) * (d + r1 - r2) * (d - r1 + r2) * (d + r1 + r2), 0.0)) / (2.0 * d);
+    float x1 = (d * d + r1 * r1 - r2 * r2) / (2.0 * d);
+    return r1 * r1 * atan(h, x1) + r2 * r2 * atan(h, d - x1) - d * h;
+}
+
+// angular radius of a sphere seen from the given distance
+float AngularRadius(float radius, float distance)
+{
+    return atan(radius, sqrt(max(distance * distance - radius * radius, 0.0)));
+}
+
+// fraction of the light sphere visible from fragPos past one occluder
+float SphereVisibility(vec3 fragPos, vec3 lightPos, float lightRadius, vec4 occluder)
+{
+    vec3 toLight = lightPos - fragPos;
+    vec3 toOccluder = occluder.xyz - fragPos;
+    float lightDistance = length(toLight);
+    float occluderDistance = length(toOccluder);
+    // the fragment is on this body (its night side comes from N dot L) or the body is behind the light
+    if (occluderDistance <= occluder.w * 1.01 || occluderDistance >= lightDistance)
+        return 1.0;
+    float lightAngle = max(AngularRadius(lightRadius, lightDistance), 1e-4);
+    float occluderAngle = AngularRadius(occluder.w, occluderDistance);
+    float separation = atan(length(cross(toLight, toOccluder)), dot(toLight, toOccluder));
+    float covered = DiscOverlap(lightAngle, occluderAngle, separation) / (ECLIPSE_PI * lightAngle * lightAngle);
+    return 1.0 - clamp(covered, 0.0, 1.0);
+}
+
+// overlapping occluders are treated as independent, which darkens a double eclipse a little too much
+float EclipseVisibility(vec3 fragPos, vec3 lightPos)
+{
+    float visibility = 1.0;
+    for (int i = 0; i < occluderCount; i++)
+        visibility *= SphereVisibility(fragPos, lightPos, eclipseLightRadius, occluders[i]);
+    return visibility;
+}
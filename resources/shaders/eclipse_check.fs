@@ -0,0 +1,17 @@
+#version 330 core
+// evaluates SphereVisibility for the samples of rg::checkEclipseShader, one sample per pixel
+out float Visibility;
+
+// per sample 3 texels in a row: (fragPos, lightRadius), (lightPos, -), (occluder center, radius)
+uniform sampler2D samples;
+
+#include "eclipse.glsl"
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec4 fragment = texelFetch(samples, ivec2(pixel.x * 3, pixel.y), 0);
+    vec4 light = texelFetch(samples, ivec2(pixel.x * 3 + 1, pixel.y), 0);
+    vec4 occluder = texelFetch(samples, ivec2(pixel.x * 3 + 2, pixel.y), 0);
+    Visibility = SphereVisibility(fragment.xyz, light.xyz, fragment.w, occluder);
+}
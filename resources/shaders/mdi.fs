@@ -0,0 +1,109 @@
+#version 430 core
+out vec4 FragColor;
+
+struct PointLight {
+    vec3 position;
+
+    vec3 specular;
+    vec3 diffuse;
+    vec3 ambient;
+
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct Material {
+    float shininess;
+};
+in vec2 TexCoords;
+in vec3 Normal;
+in vec3 FragPos;
+flat in uint MaterialLayer;
+flat in uint Lit;
+
+// diffuse maps of every material in the batch, one layer each
+uniform sampler2DArray materialMaps;
+uniform PointLight pointLight;
+uniform Material material;
+uniform DirLight dirLight1;
+uniform DirLight dirLight2;
+uniform DirLight dirLight3;
+uniform DirLight dirLight4;
+uniform vec3 viewPosition;
+// HDR brightness of unlit (emissive) objects
+uniform float emissiveStrength;
+
+#include "clustered.glsl"
+#include "shadow.glsl"
+
+
+// same math as earth.fs/moon.fs; their specular sampler is never set and ends up reading the
+// diffuse map, so the diffuse texel is used for the specular term here as well
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 texel)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading -- BLINN-PHONG
+    vec3 halfway = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(normal, halfway), 0.0), material.shininess);
+    // attenuation
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    // combine results
+    vec3 ambient = light.ambient * texel;
+    vec3 diffuse = light.diffuse * diff * texel;
+    vec3 specular = light.specular * spec * texel.xxx;
+    ambient *= attenuation;
+    // the sun casts shadows, the ambient term stays so the night side is not pitch black
+    float shadow = PointShadow(fragPos, normal);
+    diffuse *= attenuation * shadow;
+    specular *= attenuation * shadow;
+    return (ambient + diffuse + specular);
+}
+
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 texel)
+{
+    vec3 lightDir = normalize(-light.direction);
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading -- BLINN-PHONG
+    vec3 halfway = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(normal, halfway), 0.0), material.shininess);
+    // combine results
+    vec3 ambient = light.ambient * texel;
+    vec3 diffuse = light.diffuse * diff * texel;
+    vec3 specular = light.specular * spec * texel;
+    return (ambient + diffuse + specular);
+}
+
+
+void main()
+{
+    vec3 texel = vec3(texture(materialMaps, vec3(TexCoords, float(MaterialLayer))));
+    // the sun is only a light source, like in shader.fs it returns the texture color
+    if (Lit == 0u) {
+        FragColor = vec4(texel * emissiveStrength, 1.0);
+        return;
+    }
+
+    vec3 normal = normalize(Normal);
+    vec3 viewDir = normalize(viewPosition - FragPos);
+    vec3 result = CalcPointLight(pointLight, normal, FragPos, viewDir, texel);
+    result += CalcDirLight(dirLight1, normal, viewDir, texel);
+    result += CalcDirLight(dirLight2, normal, viewDir, texel);
+    result += CalcDirLight(dirLight3, normal, viewDir, texel);
+    result += CalcDirLight(dirLight4, normal, viewDir, texel);
+    result += CalcClusteredLights(normal, FragPos, viewDir, texel, texel, material.shininess);
+
+    FragColor = vec4(result, 1.0);
+}
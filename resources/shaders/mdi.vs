@@ -0,0 +1,37 @@
+#version 430 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+// draw index, fed by baseInstance of the indirect command
+layout (location = 5) in uint aDrawId;
+
+struct DrawData {
+    mat4 model;
+    uint materialLayer;
+    uint lit;
+};
+
+layout (std430, binding = 0) readonly buffer DrawDataBuffer {
+    DrawData drawData[];
+};
+
+out vec2 TexCoords;
+out vec3 Normal;
+out vec3 FragPos;
+invariant gl_Position; // see mdi_depth.vs
+flat out uint MaterialLayer;
+flat out uint Lit;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    mat4 model = drawData[aDrawId].model;
+    FragPos = vec3(model * vec4(aPos, 1.0));
+    Normal = vec3(model * vec4(aNormal, 0.0));
+    TexCoords = aTexCoords;
+    MaterialLayer = drawData[aDrawId].materialLayer;
+    Lit = drawData[aDrawId].lit;
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
@@ -0,0 +1,26 @@
+#version 430 core
+// depth pre-pass for the multi-draw batch, same transform as mdi.vs
+layout (location = 0) in vec3 aPos;
+layout (location = 5) in uint aDrawId;
+
+struct DrawData {
+    mat4 model;
+    uint materialLayer;
+    uint lit;
+};
+
+layout (std430, binding = 0) readonly buffer DrawDataBuffer {
+    DrawData drawData[];
+};
+
+uniform mat4 view;
+uniform mat4 projection;
+
+invariant gl_Position;
+
+void main()
+{
+    mat4 model = drawData[aDrawId].model;
+    vec3 FragPos = vec3(model * vec4(aPos, 1.0));
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
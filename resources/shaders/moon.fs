@@ -38,6 +38,10 @@ uniform DirLight dirLight2;
 uniform DirLight dirLight3;
 uniform DirLight dirLight4;
 uniform vec3 viewPosition;
+
+#include "clustered.glsl"
+#include "shadow.glsl"
+
 // calculates the color when using a point light.
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
 {
@@ -56,8 +60,10 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
     vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords).xxx);
     ambient *= attenuation;
-    diffuse *= attenuation;
-    specular *= attenuation;
+    // the sun casts shadows, the ambient term stays so the night side is not pitch black
+    float shadow = PointShadow(fragPos, normal);
+    diffuse *= attenuation * shadow;
+    specular *= attenuation * shadow;
     return (ambient + diffuse + specular);
 }
 
@@ -87,6 +93,8 @@ void main()
     result += CalcDirLight(dirLight2, normal, viewDir);
     result += CalcDirLight(dirLight3, normal, viewDir);
     result += CalcDirLight(dirLight4, normal, viewDir);
+    result += CalcClusteredLights(normal, FragPos, viewDir, vec3(texture(material.texture_diffuse1, TexCoords)),
+                                  vec3(texture(material.texture_specular1, TexCoords)), material.shininess);
 
     FragColor = vec4(result, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,20 @@
+#version 330 core
+// resolves the weighted blended accumulation over the opaque scene,
+// blended with (SRC_ALPHA, ONE_MINUS_SRC_ALPHA)
+out vec4 FragColor;
+
+uniform sampler2D accumTexture;
+uniform sampler2D weightTexture;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    vec4 accum = texelFetch(accumTexture, texel, 0);
+    float revealage = accum.a;
+    // nothing translucent was drawn over this pixel
+    if (revealage >= 0.9999)
+        discard;
+    float weight = texelFetch(weightTexture, texel, 0).r;
+    vec3 average = accum.rgb / max(weight, 1e-5);
+    FragColor = vec4(average, 1.0 - revealage);
+}
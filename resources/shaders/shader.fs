@@ -6,6 +6,8 @@ in vec3 Normal;
 in vec3 FragPos;
 
 uniform sampler2D tex;
+// HDR brightness of the surface, enough to get over the bloom threshold
+uniform float emissiveStrength;
 
 // Sejder za Sunce ne treba da radi nista sem da vraca boju onakva kakva je u teksturi jer je Sunce sam izvor svetlosti
 // i njegova boja ne zavisi ni od kakvog izvora svetlosti
@@ -14,5 +16,5 @@ void main()
 {
 
     vec3 color = vec3(texture(tex, TexCoords)).rgb;
-    FragColor = vec4(color, 1.0);
+    FragColor = vec4(color * emissiveStrength, 1.0);
 }
\ No newline at end of file
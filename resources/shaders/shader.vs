@@ -6,6 +6,7 @@ layout (location = 2) in vec2 aTexCoords;
 out vec2 TexCoords;
 out vec3 Normal;
 out vec3 FragPos;
+invariant gl_Position; // see depth.vs
 
 uniform mat4 model;
 uniform mat4 view;
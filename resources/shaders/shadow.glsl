@@ -0,0 +1,23 @@
+// shadows of the sun point light, set up by rg::PointShadows.
+// Included by earth.fs, moon.fs and mdi.fs.
+
+// 0 off, 1 cube map, 2 analytic spheres (rg::ShadowMode)
+uniform int shadowMode;
+uniform samplerCubeShadow shadowMap;
+uniform vec3 shadowLightPosition;
+uniform float shadowFar;
+
+#include "eclipse.glsl"
+
+// 1.0 where all of the point light reaches fragPos, 0.0 in full shadow
+float PointShadow(vec3 fragPos, vec3 normal)
+{
+    if (shadowMode == 1) {
+        // normal offset against acne on the curved surfaces, LINEAR filtering gives 2x2 PCF
+        vec3 fromLight = fragPos + normal * 0.05 - shadowLightPosition;
+        return texture(shadowMap, vec4(fromLight, length(fromLight) / shadowFar - 0.0005));
+    }
+    if (shadowMode == 2)
+        return EclipseVisibility(fragPos, shadowLightPosition);
+    return 1.0;
+}
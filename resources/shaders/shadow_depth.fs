@@ -0,0 +1,11 @@
+#version 330 core
+// linear distance to the light, the same value shadow.glsl compares against
+in vec3 FragPos;
+
+uniform vec3 lightPosition;
+uniform float farPlane;
+
+void main()
+{
+    gl_FragDepth = length(FragPos - lightPosition) / farPlane;
+}
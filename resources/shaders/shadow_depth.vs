@@ -0,0 +1,14 @@
+#version 330 core
+// one face of the point light shadow cube map, rendered by rg::PointShadows
+layout (location = 0) in vec3 aPos;
+
+uniform mat4 model;
+uniform mat4 lightSpace;
+
+out vec3 FragPos;
+
+void main()
+{
+    FragPos = vec3(model * vec4(aPos, 1.0));
+    gl_Position = lightSpace * vec4(FragPos, 1.0);
+}
@@ -0,0 +1,22 @@
+#version 330 core
+// HDR scene plus bloom to the window
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D scene;
+uniform sampler2D bloom;
+uniform float bloomStrength;
+uniform float exposure;
+
+// Narkowicz's fit of the ACES filmic curve
+vec3 ACESFilm(vec3 x)
+{
+    return clamp((x * (2.51 * x + 0.03)) / (x * (2.43 * x + 0.59) + 0.14), 0.0, 1.0);
+}
+
+void main()
+{
+    vec3 color = texture(scene, TexCoords).rgb + bloomStrength * texture(bloom, TexCoords).rgb;
+    FragColor = vec4(ACESFilm(color * exposure), 1.0);
+}
@@ -0,0 +1,45 @@
+#version 330 core
+// composites a reduced resolution translucent layer (premultiplied rgb, transmittance in alpha)
+// over the full resolution scene, blended with (ONE, SRC_ALPHA).
+// Where the four nearest layer texels agree with the scene depth the layer is filtered bilinearly,
+// on depth edges the texel whose depth is closest to the pixel's own depth is taken instead.
+out vec4 FragColor;
+
+uniform sampler2D layerColor;
+uniform sampler2D layerDepth;
+uniform sampler2D sceneDepth;
+uniform int divisor;
+uniform float nearPlane;
+uniform float farPlane;
+
+float linearDepth(float depth)
+{
+    return nearPlane * farPlane / (farPlane - depth * (farPlane - nearPlane));
+}
+
+void main()
+{
+    float depth = linearDepth(texelFetch(sceneDepth, ivec2(gl_FragCoord.xy), 0).r);
+    vec2 layerSize = vec2(textureSize(layerColor, 0));
+    vec2 position = gl_FragCoord.xy / float(divisor);
+    ivec2 base = ivec2(floor(position - 0.5));
+    ivec2 last = textureSize(layerDepth, 0) - 1;
+
+    ivec2 nearest = clamp(base, ivec2(0), last);
+    float nearestDifference = 1e30;
+    float largestDifference = 0.0;
+    for (int i = 0; i < 4; i++) {
+        ivec2 texel = clamp(base + ivec2(i & 1, i >> 1), ivec2(0), last);
+        float difference = abs(linearDepth(texelFetch(layerDepth, texel, 0).r) - depth);
+        if (difference < nearestDifference) {
+            nearestDifference = difference;
+            nearest = texel;
+        }
+        largestDifference = max(largestDifference, difference);
+    }
+
+    if (largestDifference < 0.05 * depth)
+        FragColor = texture(layerColor, position / layerSize);
+    else
+        FragColor = texelFetch(layerColor, nearest, 0);
+}
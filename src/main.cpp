@@ -14,7 +14,49 @@
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
 
+#include <rg/Benchmark.h>
+#include <rg/Bounds.h>
+#include <rg/Bloom.h>
+#include <rg/ClusteredLights.h>
+#include <rg/CpuProfiler.h>
+#include <rg/Eclipse.h>
+#include <rg/EglContext.h>
+#include <rg/DrawStats.h>
+#include <rg/EclipseCheck.h>
+#include <rg/FlightRecorder.h>
+#include <rg/FrameCapture.h>
+#include <rg/FrameGraph.h>
+#include <rg/GLDebug.h>
+#include <rg/GLExt.h>
+#include <rg/GoldenImages.h>
+#include <rg/GpuProfiler.h>
+#include <rg/GpuTimer.h>
+#include <rg/InputLog.h>
+#include <rg/JobSystem.h>
+#include <rg/MultiDrawBatch.h>
+#include <rg/PixelReadback.h>
+#include <rg/PointShadows.h>
+#include <rg/RedrawTracker.h>
+#include <rg/RenderFarm.h>
+#include <rg/ResolutionGovernor.h>
+#include <rg/Primitives.h>
+#include <rg/RenderTarget.h>
+#include <rg/SceneGenerator.h>
+#include <rg/SceneSweep.h>
+#include <rg/SoftwareRenderer.h>
+#include <rg/StreamBuffer.h>
+#include <rg/TranslucentPass.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <random>
+#include <sstream>
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
 
@@ -26,12 +68,22 @@ void processInput(GLFWwindow *window);
 
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods);
 
+void mouse_button_callback(GLFWwindow *window, int button, int action, int mods);
+
+void window_refresh_callback(GLFWwindow *window);
+
+void handleKey(GLFWwindow *window, int key, int action);
+
 unsigned int loadSkybox(vector<std::string> faces);
 unsigned int loadTexture(const char *path);
+vector<std::string> SkyboxFaces();
 
 // settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
+// current size of the default framebuffer, the offscreen targets follow it
+int framebufferWidth = SCR_WIDTH;
+int framebufferHeight = SCR_HEIGHT;
 
 // camera
 float lastX = SCR_WIDTH / 2.0f;
@@ -53,6 +105,83 @@ struct PointLight {
     float quadratic;
 };
 
+// the sun; the state file doesn't keep it
+const PointLight SunLight = {glm::vec3(-3.0f, 14.5f, 35.0f), glm::vec3(0.5f), glm::vec3(55.0f), glm::vec3(1.0f),
+                             1.0f, 0.09f, 0.032f};
+
+struct DirLight {
+    glm::vec3 direction;
+    glm::vec3 ambient;
+    glm::vec3 diffuse;
+    glm::vec3 specular;
+};
+
+// dirLight1..4 of earth.fs and moon.fs, dim fill lights from four sides
+const DirLight FillLights[4] = {
+        {glm::vec3(-0.2f, -1.0f, -0.3f), glm::vec3(0.005f), glm::vec3(0.005f), glm::vec3(0.005f)},
+        {glm::vec3(0.2f, -1.0f, -0.3f), glm::vec3(0.005f), glm::vec3(0.005f), glm::vec3(0.005f)},
+        {glm::vec3(-0.2f, 1.0f, -0.3f), glm::vec3(0.005f), glm::vec3(0.005f), glm::vec3(0.005f)},
+        {glm::vec3(0.2f, 1.0f, -0.3f), glm::vec3(0.005f), glm::vec3(0.005f), glm::vec3(0.005f)},
+};
+
+// an opaque object of the scene, drawn with its own shader or as part of the multi-draw batch
+struct OpaqueObject {
+    Model *model;
+    Shader *shader;
+    // earth.vs and moon.vs name their model matrix differently
+    std::string modelUniform;
+    glm::mat4 transform;
+    bool lit;
+    // model space, see rg::transformSphere
+    rg::BoundingSphere bounds;
+    bool castsShadow;
+    // moves relative to the point light in a way that changes its shadow, see rg::PointShadows
+    bool dynamicCaster;
+    // picked every frame for lit objects; set when the object is drawn, objects share programs
+    rg::EclipseOccluders occluders = rg::EclipseOccluders();
+};
+
+// averaged cost of the opaque pass, kept separately for each draw path so they can be compared
+struct OpaquePassStats {
+    double cpuMs = 0.0;
+    double gpuMs = 0.0;
+    // fragments that passed the depth test in the color pass, i.e. were shaded
+    unsigned long long shadedFragments = 0;
+};
+
+// everything that changes the shape of the frame graph; it is rebuilt when any of it changes
+struct FrameGraphConfig {
+    int width = 0;
+    int height = 0;
+    int windowWidth = 0;
+    int windowHeight = 0;
+    bool bloomEnabled = false;
+    int transparencyMode = -1;
+    // rg::TranslucentPass::usedLayers of the frame
+    unsigned int translucentLayers = 0;
+
+    bool operator==(const FrameGraphConfig &other) const {
+        return width == other.width && height == other.height && windowWidth == other.windowWidth
+               && windowHeight == other.windowHeight && bloomEnabled == other.bloomEnabled
+               && transparencyMode == other.transparencyMode && translucentLayers == other.translucentLayers;
+    }
+};
+
+// a clustered light circling the earth, start is perpendicular to axis
+struct LightOrbit {
+    glm::vec3 axis;
+    glm::vec3 start;
+    float speed;
+};
+
+enum DepthPrePassMode {
+    DepthPrePassOff = 0,
+    DepthPrePassOn,
+    // measures the opaque pass with and without the pre-pass every few seconds and keeps the cheaper one
+    DepthPrePassAuto,
+    DepthPrePassModeCount
+};
+
 struct ProgramState {
     glm::vec3 clearColor = glm::vec3(0);
     bool ImGuiEnabled = false;
@@ -61,12 +190,75 @@ struct ProgramState {
     glm::vec3 objPosition = glm::vec3(10.0f);
     float objScale = 5.0f;
     PointLight pointLight;
+    bool MultiDrawIndirectSupported = false;
+    bool MultiDrawIndirectEnabled = false;
+    // [0] one draw call per mesh, [1] multi-draw indirect; second index: without/with the depth pre-pass
+    OpaquePassStats opaquePassStats[2][2];
+    int depthPrePassMode = DepthPrePassOff;
+    // what the auto mode currently uses
+    bool depthPrePassActive = false;
+    bool frontToBackOrdering = true;
+    // per frame dynamic data of the renderer, see rg::StreamBuffer
+    rg::StreamBuffer *streamBuffer = NULL;
+    // rg::TransparencyMode of the translucent pass
+    int transparencyMode = rg::TransparencyWeightedBlended;
+    // extra overlapping volumes drawn next to the cosmic dust, for comparing the transparency modes
+    int translucentVolumeCount = 0;
+    double translucentGpuMs[rg::TransparencyModeCount] = {};
+    // resolution divisor (1, 2 or 4) of each translucent effect
+    int dustResolutionDivisor = 1;
+    int volumeResolutionDivisor = 1;
+    rg::TranslucentPass *translucentPass = NULL;
+    // small point lights on top of pointLight, shaded through rg::ClusteredLights
+    int clusteredLightCount = 0;
+    const rg::ClusteredLights *clusteredLights = NULL;
+    unsigned int jobThreads = 1;
+    // rg::ShadowMode of the point light
+    int shadowMode = rg::ShadowsCubeMap;
+    const rg::PointShadows *pointShadows = NULL;
+    // radius of the point light for the soft analytic eclipses
+    float eclipseLightRadius = 2.0f;
+    // occluders picked for the earth and the moon in the last frame
+    int eclipseOccluderCount[2] = {};
+    // HDR output: the sun is emissiveStrength times brighter than its texture, bloom starts above
+    // bloomThreshold and everything is tonemapped with exposure
+    float emissiveStrength = 4.0f;
+    bool bloomEnabled = true;
+    float bloomThreshold = 1.0f;
+    float bloomStrength = 0.5f;
+    float exposure = 1.0f;
+    const rg::Bloom *bloom = NULL;
+    double tonemapGpuMs = 0.0;
+    // the passes after the opaque scene
+    const rg::FrameGraph *frameGraph = NULL;
+    // render scale, effect quality and LOD bias of the 3D scene, ImGui always draws at full resolution
+    rg::ResolutionGovernor *governor = NULL;
+    const rg::GpuProfiler *gpuProfiler = NULL;
+    // cost of one CPU_ZONE, measured at startup
+    double cpuZoneOverheadNs = 0.0;
+    rg::FlightRecorder *flightRecorder = NULL;
+    // draws of the 3D scene in the last frame, without ImGui
+    rg::DrawStats sceneDraws;
+    int sceneWidth = 0;
+    int sceneHeight = 0;
+    // --record: gets the key events of the window; --play: live input is ignored
+    rg::InputRecorder *inputRecorder = NULL;
+    bool replayingInput = false;
+    // screenshots (F9) and recordings (F10) of the window
+    rg::FrameCapture *frameCapture = NULL;
+    // what the next frame has to be rendered for, see --on-demand
+    rg::RedrawTracker *redrawTracker = NULL;
+    // F6: the scene stands still, the camera can still move
+    bool animationPaused = false;
     ProgramState()
             : camera(glm::vec3(0.0f, 0.0f, 3.0f)) {}
 
     void SaveToFile(std::string filename);
 
     void LoadFromFile(std::string filename);
+
+    // everything that shapes a frame, for hitch reports
+    void WriteReport(std::ostream &out) const;
 };
 
 void ProgramState::SaveToFile(std::string filename) {
@@ -99,51 +291,352 @@ void ProgramState::LoadFromFile(std::string filename) {
     }
 }
 
+void ProgramState::WriteReport(std::ostream &out) const {
+    out << "camera_position " << camera.Position.x << ' ' << camera.Position.y << ' ' << camera.Position.z << '\n'
+        << "camera_front " << camera.Front.x << ' ' << camera.Front.y << ' ' << camera.Front.z << '\n'
+        << "camera_yaw_pitch_zoom " << camera.Yaw << ' ' << camera.Pitch << ' ' << camera.Zoom << '\n'
+        << "scene_size " << sceneWidth << 'x' << sceneHeight << '\n'
+        << "multi_draw_indirect " << MultiDrawIndirectEnabled << '\n'
+        << "depth_pre_pass_mode " << depthPrePassMode << " active " << depthPrePassActive << '\n'
+        << "front_to_back " << frontToBackOrdering << '\n'
+        << "transparency_mode " << rg::transparencyModeName(transparencyMode) << '\n'
+        << "translucent_volumes " << translucentVolumeCount << '\n'
+        << "resolution_divisors dust " << dustResolutionDivisor << " volumes " << volumeResolutionDivisor << '\n'
+        << "clustered_lights " << clusteredLightCount << '\n'
+        << "shadow_mode " << rg::shadowModeName(shadowMode) << '\n'
+        << "eclipse_light_radius " << eclipseLightRadius << '\n'
+        << "emissive_strength " << emissiveStrength << '\n'
+        << "bloom " << bloomEnabled << " threshold " << bloomThreshold << " strength " << bloomStrength << '\n'
+        << "exposure " << exposure << '\n'
+        << "imgui " << ImGuiEnabled << '\n';
+    if (governor != NULL) {
+        out << "dynamic_resolution " << governor->settings.enabled << " target_ms " << governor->settings.targetMs
+            << " scale " << governor->scale() << " quality " << governor->quality() << " lod_bias "
+            << governor->lodBias() << '\n';
+    }
+}
+
 ProgramState *programState;
 
 void DrawImGui(ProgramState *programState);
 
-int main() {
+// for the window callbacks, which are registered before the program state and its tracker exist
+void requestRedraw(rg::RedrawTracker::Reason reason);
+
+void SetLightUniforms(Shader &shader, const PointLight &pointLight, const glm::vec3 &viewPosition);
+
+// model matrices of the earth, the moon and the sun at a point of the simulation
+void PlaceBaseObjects(float time, glm::mat4 &earth, glm::mat4 &moon, glm::mat4 &sun);
+
+// --software: renders the scene on the CPU, without a window or a GL context
+int RenderSoftware(const std::string &output, const rg::Benchmark::Settings &settings,
+                   const rg::SceneGenerator::Settings &sceneSettings, const std::string &cameraPath);
+
+int main(int argc, char **argv) {
+    // --gl43 asks for a GL 4.3 context, which enables the multi-draw indirect path
+    // --check-eclipse compares the eclipse shader with its CPU reference and exits
+    // --governor-csv <file> writes the last decisions of the resolution governor on exit
+    // --gpu-profile-csv <file> writes the per-pass GPU times of the last frames on exit
+    // --cpu-trace <file> writes the recorded CPU zones as Chrome trace JSON on exit
+    // --hitch-budget <ms> frame time above which the flight recorder writes a report (default 50)
+    // --gl-debug asks for a debug context and reports every GL message from inside the failing call
+    // --measure-glcall prints what the old glGetError checks of GLCALL cost per call and exits
+    // --bench <file> renders a fixed benchmark run offscreen and writes a JSON report, see rg::Benchmark
+    // --bench-frames <n> and --bench-size <w>x<h> change the length and resolution of the run
+    // --record <file> writes the camera and key events of every frame to an input log, see rg::InputRecorder;
+    //   it starts from the default state like --play, without program_state.txt, and without ImGui (F1)
+    // --play <file> replays an input log on a fixed timestep; with --bench the run follows the log
+    // --scene <spec> adds a generated solar system to the scene, see rg::SceneGenerator
+    // --sweep <dir> benchmarks generated scenes of growing size and plots the results, see rg::SceneSweep
+    // --golden <dir> renders the views listed in dir/golden.txt and compares them with their goldens, see rg::GoldenSuite
+    // --golden-update writes the rendered views as the new goldens instead
+    // --software <file.png> renders the benchmark camera path on the CPU, see rg::SoftwareRenderer; --bench-frames and
+    //   --bench-size set the run, the last frame is written to the file and its depth next to it
+    // --camera-path <file> flies --bench, --software and --farm along the keys in the file instead of the scripted path
+    // --farm <dir> renders frames of the camera path to dir/frame_*.png with worker processes, see rg::RenderFarm;
+    //   --farm-frames <first>-<last> (default 0 to --bench-frames - 1), --farm-workers <n>, --bench-size for the images
+    // --farm-shard <first>-<last> is a worker of --farm, it renders these frames into the --farm directory
+    // --capture <dir> records the window from the first frame on as dir/capture_*.png, see rg::FrameCapture;
+    //   --capture-pipe <command> records raw frames into the command instead, F10 starts and stops either
+    // --on-demand renders a frame only when something changed and otherwise waits for events, see rg::RedrawTracker;
+    //   the scene animation starts paused, F6 runs it
+    auto programStart = std::chrono::steady_clock::now();
+    rg::CpuProfiler::setThreadName("render");
+    bool requestGL43 = false;
+    bool checkEclipse = false;
+    std::string governorCsv;
+    std::string gpuProfileCsv;
+    std::string cpuTrace;
+    float hitchBudgetMs = 50.0f;
+    bool glDebug = false;
+    bool measureGlCall = false;
+    std::string benchReport;
+    rg::Benchmark::Settings benchSettings;
+    std::string recordLog;
+    std::string playLog;
+    rg::SceneGenerator::Settings sceneSettings;
+    std::string sweepDirectory;
+    std::string goldenDirectory;
+    bool goldenUpdate = false;
+    std::string softwareOutput;
+    std::string cameraPath;
+    std::string farmDirectory;
+    std::string farmRange;
+    rg::RenderFarm::Settings farmSettings;
+    int shardFirst = 0, shardLast = -1;
+    rg::FrameCapture::Settings captureSettings;
+    bool captureFromStart = false;
+    bool onDemand = false;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--gl43") == 0)
+            requestGL43 = true;
+        if (std::strcmp(argv[i], "--check-eclipse") == 0)
+            checkEclipse = true;
+        if (std::strcmp(argv[i], "--governor-csv") == 0 && i + 1 < argc)
+            governorCsv = argv[++i];
+        if (std::strcmp(argv[i], "--gpu-profile-csv") == 0 && i + 1 < argc)
+            gpuProfileCsv = argv[++i];
+        if (std::strcmp(argv[i], "--cpu-trace") == 0 && i + 1 < argc)
+            cpuTrace = argv[++i];
+        if (std::strcmp(argv[i], "--hitch-budget") == 0 && i + 1 < argc)
+            hitchBudgetMs = std::atof(argv[++i]);
+        if (std::strcmp(argv[i], "--gl-debug") == 0)
+            glDebug = true;
+        if (std::strcmp(argv[i], "--measure-glcall") == 0)
+            measureGlCall = true;
+        if (std::strcmp(argv[i], "--bench") == 0 && i + 1 < argc)
+            benchReport = argv[++i];
+        if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+            recordLog = argv[++i];
+        if (std::strcmp(argv[i], "--play") == 0 && i + 1 < argc)
+            playLog = argv[++i];
+        if (std::strcmp(argv[i], "--scene") == 0 && i + 1 < argc
+            && !rg::SceneGenerator::Settings::parse(argv[++i], sceneSettings)) {
+            std::cout << "--scene expects seed=<n>,planets=<n>,moons=<n>,asteroids=<n>,lights=<n>,clouds=<n>\n";
+            return -1;
+        }
+        if (std::strcmp(argv[i], "--sweep") == 0 && i + 1 < argc)
+            sweepDirectory = argv[++i];
+        if (std::strcmp(argv[i], "--golden") == 0 && i + 1 < argc)
+            goldenDirectory = argv[++i];
+        if (std::strcmp(argv[i], "--golden-update") == 0)
+            goldenUpdate = true;
+        if (std::strcmp(argv[i], "--software") == 0 && i + 1 < argc)
+            softwareOutput = argv[++i];
+        if (std::strcmp(argv[i], "--camera-path") == 0 && i + 1 < argc)
+            cameraPath = argv[++i];
+        if (std::strcmp(argv[i], "--farm") == 0 && i + 1 < argc)
+            farmDirectory = argv[++i];
+        if (std::strcmp(argv[i], "--farm-frames") == 0 && i + 1 < argc)
+            farmRange = argv[++i];
+        if (std::strcmp(argv[i], "--farm-workers") == 0 && i + 1 < argc)
+            farmSettings.workers = std::max(std::atoi(argv[++i]), 1);
+        if (std::strcmp(argv[i], "--farm-shard") == 0 && i + 1 < argc
+            && !rg::RenderFarm::parseRange(argv[++i], shardFirst, shardLast)) {
+            std::cout << "--farm-shard expects <first>-<last>\n";
+            return -1;
+        }
+        if (std::strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+            captureSettings.directory = argv[++i];
+            captureFromStart = true;
+        }
+        if (std::strcmp(argv[i], "--capture-pipe") == 0 && i + 1 < argc) {
+            captureSettings.pipeCommand = argv[++i];
+            captureFromStart = true;
+        }
+        if (std::strcmp(argv[i], "--on-demand") == 0)
+            onDemand = true;
+        if (std::strcmp(argv[i], "--bench-frames") == 0 && i + 1 < argc)
+            benchSettings.frames = std::max(std::atoi(argv[++i]), 1);
+        if (std::strcmp(argv[i], "--bench-size") == 0 && i + 1 < argc
+            && std::sscanf(argv[++i], "%dx%d", &benchSettings.width, &benchSettings.height) != 2) {
+            std::cout << "--bench-size expects <width>x<height>\n";
+            return -1;
+        }
+    }
+    // every step of the sweep is a benchmark run of its own process, this one only starts them
+    if (!sweepDirectory.empty()) {
+        std::string arguments = "--bench-frames " + std::to_string(benchSettings.frames) + " --bench-size "
+                                + std::to_string(benchSettings.width) + "x" + std::to_string(benchSettings.height);
+        if (requestGL43)
+            arguments += " --gl43";
+        rg::SceneSweep sweep(argv[0], sweepDirectory, arguments);
+        return sweep.run() ? 0 : 1;
+    }
+    // the coordinator of the farm only starts the workers, each renders a shard of the frames headless
+    bool farmWorker = !farmDirectory.empty() && shardLast >= 0;
+    if (!farmDirectory.empty() && !farmWorker) {
+        farmSettings.lastFrame = benchSettings.frames - 1;
+        if (!farmRange.empty()
+            && !rg::RenderFarm::parseRange(farmRange, farmSettings.firstFrame, farmSettings.lastFrame)) {
+            std::cout << "--farm-frames expects <first>-<last>\n";
+            return -1;
+        }
+        rg::Benchmark path(benchSettings);
+        if (!cameraPath.empty() && !path.loadPath(cameraPath))
+            return -1;
+        // farm.txt is also the camera path of the workers, the settings are comments in it
+        std::string arguments = "--bench-size " + std::to_string(benchSettings.width) + "x"
+                                + std::to_string(benchSettings.height) + " --scene " + sceneSettings.toString();
+        if (requestGL43)
+            arguments += " --gl43";
+        std::ostringstream manifest;
+        manifest << "# frames of --farm, rendered with " << arguments << '\n';
+        path.writePath(manifest);
+        arguments += " --camera-path " + rg::RenderFarm::quote(farmDirectory + "/farm.txt");
+        rg::RenderFarm farm(argv[0], farmDirectory, arguments, manifest.str(), farmSettings);
+        return farm.run() ? 0 : 1;
+    }
+    if (!softwareOutput.empty())
+        return RenderSoftware(softwareOutput, benchSettings, sceneSettings, cameraPath);
+    bool bench = !benchReport.empty();
+    rg::InputPlayback playback;
+    bool playing = !playLog.empty();
+    rg::GoldenSuite goldenSuite;
+    bool golden = !goldenDirectory.empty();
+    if (golden && (bench || playing)) {
+        std::cout << "--golden can't be combined with --bench or --play\n";
+        return -1;
+    }
+    if (farmWorker && (bench || playing || golden)) {
+        std::cout << "--farm can't be combined with --bench, --play or --golden\n";
+        return -1;
+    }
+    if (captureFromStart && (bench || golden || farmWorker)) {
+        std::cout << "--capture records the window, it can't be combined with --bench, --golden or --farm\n";
+        return -1;
+    }
+    if (golden && !goldenSuite.load(goldenDirectory))
+        return -1;
+    // renders offscreen into a texture of a fixed size, never shows the window
+    bool headless = bench || golden || farmWorker;
+    if (playing) {
+        if (!playback.load(playLog) || playback.frameCount() == 0) {
+            std::cout << "Failed to load input log " << playLog << '\n';
+            return -1;
+        }
+        std::cout << "Replaying " << playback.frameCount() << " frames of " << playLog << ", recorded at "
+                  << playback.recordedMs() << " ms per frame\n";
+        // the log decides the length of the run, the warm-up comes out of it
+        benchSettings.warmupFrames = std::min(benchSettings.warmupFrames, (int) playback.frameCount() - 1);
+        benchSettings.frames = playback.frameCount() - benchSettings.warmupFrames;
+    }
+    rg::Benchmark benchmark(benchSettings);
+    if (!cameraPath.empty() && !benchmark.loadPath(cameraPath))
+        return -1;
+
+    // GL 3.3 stays as the fallback when a GL 4.3 context can't be created
+    const int contextVersions[2][2] = {{4, 3}, {3, 3}};
+
+    // the offscreen modes render into framebuffer objects only; built with HEADLESS_EGL they get a
+    // surfaceless EGL context and run without a display server, a GLFW window is the fallback
+    // -----------------------------------------------------------------------------------------------
+    rg::EglContext eglContext;
+    bool offscreen = headless || checkEclipse || measureGlCall;
+    for (int i = requestGL43 ? 0 : 1; offscreen && rg::EglContext::available() && i < 2 && !eglContext.valid(); i++)
+        eglContext.create(contextVersions[i][0], contextVersions[i][1], glDebug);
+    bool windowless = eglContext.valid();
+    if (offscreen && rg::EglContext::available() && !windowless)
+        std::cout << "No EGL context, falling back to a hidden GLFW window\n";
+
     // glfw: initialize and configure
     // ------------------------------
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-#ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-#endif
+    if (!windowless)
+        glfwInit();
 
     // glfw window creation
     // --------------------
-    GLFWwindow *window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
-    if (window == NULL) {
+    GLFWwindow *window = NULL;
+    for (int i = requestGL43 ? 0 : 1; !windowless && i < 2 && window == NULL; i++) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, contextVersions[i][0]);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, contextVersions[i][1]);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_VISIBLE, checkEclipse || measureGlCall || headless ? GLFW_FALSE : GLFW_TRUE);
+        glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, glDebug ? GLFW_TRUE : GLFW_FALSE);
+#ifdef __APPLE__
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+        // the benchmark and the golden images never show their window, they render into their own texture
+        window = headless ? glfwCreateWindow(64, 64, "LearnOpenGL", NULL, NULL)
+                       : glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+    }
+    if (window == NULL && !windowless) {
         std::cout << "Failed to create GLFW window" << std::endl;
         glfwTerminate();
         return -1;
     }
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetScrollCallback(window, scroll_callback);
-    glfwSetKeyCallback(window, key_callback);
-    // tell GLFW to capture our mouse
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+    if (window != NULL) {
+        glfwMakeContextCurrent(window);
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetScrollCallback(window, scroll_callback);
+        glfwSetKeyCallback(window, key_callback);
+        glfwSetMouseButtonCallback(window, mouse_button_callback);
+        glfwSetWindowRefreshCallback(window, window_refresh_callback);
+        // tell GLFW to capture our mouse
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+    }
 
     // glad: load all OpenGL function pointers
     // ---------------------------------------
-    if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) {
+    GLADloadproc loadProc = windowless ? (GLADloadproc) rg::EglContext::getProcAddress : (GLADloadproc) glfwGetProcAddress;
+    if (!gladLoadGLLoader(loadProc)) {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    rg::loadGLExt(loadProc);
+
+    // errors and warnings go through the debug callback; without --gl-debug only the ones a
+    // non-debug context reports anyway, asynchronously
+#ifdef NDEBUG
+    GLenum debugSeverity = GL_DEBUG_SEVERITY_HIGH;
+#else
+    GLenum debugSeverity = GL_DEBUG_SEVERITY_MEDIUM;
+#endif
+    if (glDebug)
+        debugSeverity = GL_DEBUG_SEVERITY_LOW;
+    if (!rg::GLDebug::enable(debugSeverity, glDebug))
+        std::cout << "No GL debug output, GLCALL falls back to glGetError\n";
+
+    if (measureGlCall) {
+        double plainNs = 0.0, checkedNs = 0.0;
+        rg::GLDebug::measureGetErrorOverhead(100000, plainNs, checkedNs);
+        std::cout << "glBindBuffer: " << plainNs << " ns, with glGetError checks " << checkedNs << " ns ("
+                  << checkedNs - plainNs << " ns per GLCALL removed)\n";
+        eglContext.release();
+        glfwTerminate();
+        return 0;
+    }
+
+    if (checkEclipse) {
+        bool passed = rg::checkEclipseShader();
+        eglContext.release();
+        glfwTerminate();
+        return passed ? 0 : 1;
+    }
 
     // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
     stbi_set_flip_vertically_on_load(true);
 
     programState = new ProgramState;
-    programState->LoadFromFile("resources/program_state.txt");
-    if (programState->ImGuiEnabled) {
+    // the benchmark, the golden images and input logs start from the defaults, not from where the last
+    // session left off; a replay starts from the defaults, so its recording has to as well
+    bool sessionState = !headless && !playing && recordLog.empty();
+    if (sessionState)
+        programState->LoadFromFile("resources/program_state.txt");
+    rg::InputRecorder inputRecorder;
+    if (!recordLog.empty()) {
+        if (inputRecorder.open(recordLog))
+            programState->inputRecorder = &inputRecorder;
+        else
+            std::cout << "Failed to create input log " << recordLog << '\n';
+    }
+    programState->replayingInput = playing;
+    programState->cpuZoneOverheadNs = rg::CpuProfiler::measureOverheadNs();
+    std::cout << "CPU profiler: " << programState->cpuZoneOverheadNs << " ns per zone\n";
+    programState->MultiDrawIndirectSupported = rg::glext().hasMultiDrawIndirect();
+    programState->MultiDrawIndirectEnabled = programState->MultiDrawIndirectSupported;
+    if (programState->ImGuiEnabled && window != NULL) {
         glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
     }
     // Init Imgui
@@ -154,7 +647,9 @@ int main() {
 
 
 
-    ImGui_ImplGlfw_InitForOpenGL(window, true);
+    // the offscreen modes never draw ImGui, without a window it has no input either
+    if (window != NULL)
+        ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init("#version 330 core");
 
     // DEPTH TESTING
@@ -170,7 +665,6 @@ int main() {
     Shader skyboxShader("resources/shaders/skybox.vs", "resources/shaders/skybox.fs");
     Shader shader("resources/shaders/shader.vs", "resources/shaders/shader.fs");
     Shader moonShader("resources/shaders/moon.vs", "resources/shaders/moon.fs");
-    Shader cdShader("resources/shaders/cd.vs","resources/shaders/cd.fs");
 
     // temena za skybox
     float skyboxVertices[] = {
@@ -229,17 +723,7 @@ int main() {
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 
 
-    vector<std::string> faces
-            {
-                    FileSystem::getPath("resources/textures/skybox/SkyBlue2_right1.png"),
-                    FileSystem::getPath("resources/textures/skybox/SkyBlue2_left2.png"),
-                    FileSystem::getPath("resources/textures/skybox/SkyBlue2_bottom4.png"),
-                    FileSystem::getPath("resources/textures/skybox/SkyBlue2_top3.png"),
-                    FileSystem::getPath("resources/textures/skybox/SkyBlue2_front5.png"),
-                    FileSystem::getPath("resources/textures/skybox/SkyBlue2_back6.png")
-            };
-
-    unsigned int cubemapTexture = loadSkybox(faces);
+    unsigned int cubemapTexture = loadSkybox(SkyboxFaces());
 
     skyboxShader.setInt("skybox", 0);
     skyboxShader.use();
@@ -253,9 +737,6 @@ int main() {
     shader.setInt("tex", 3);
     shader.use();
 
-    cdShader.setInt("cd",4);
-    cdShader.use();
-
 
 
     // load models
@@ -272,210 +753,790 @@ int main() {
     // pointlight settings
     // -------------------
     PointLight& pointLight = programState->pointLight;
-    pointLight.position = glm::vec3(-3.0f,14.5f,35.0f);
-    pointLight.ambient = glm::vec3(0.5, 0.5, 0.5);
-    pointLight.diffuse = glm::vec3(55.0, 55.0, 55.0);
-    pointLight.specular = glm::vec3(1.0, 1.0, 1.0);
-
-    pointLight.constant = 1.0f;
-    pointLight.linear = 0.09f;
-    pointLight.quadratic = 0.032f;
-
+    pointLight = SunLight;
+
+    // opaque objects, in the order they are drawn on the per-mesh path; the earth only spins
+    // around its center, which leaves its shadow unchanged, so it is a static caster
+    // ----------------------------------------------------------------------------------------
+    std::vector<OpaqueObject> opaqueObjects = {
+            {&earthModel, &earthShader, "model3", glm::mat4(1.0f), true, rg::boundingSphere(earthModel), true, false},
+            {&moonModel, &moonShader, "model2", glm::mat4(1.0f), true, rg::boundingSphere(moonModel), true, true},
+            {&sunModel, &shader, "model", glm::mat4(1.0f), false, rg::boundingSphere(sunModel), false, false}
+    };
+    // the generated bodies come after them; planets look like the earth, moons and asteroids like
+    // the moon, and only the asteroids don't cast shadows
+    rg::SceneGenerator sceneGenerator(sceneSettings, glm::vec3(-28.0f, 11.5f, 75.0f));
+    const unsigned int firstGeneratedObject = opaqueObjects.size();
+    const float cloudModelRadius = rg::boundingSphere(cdModel).radius;
+    for (const rg::SceneGenerator::Body &body : sceneGenerator.bodies()) {
+        if (body.kind == rg::SceneGenerator::Planet)
+            opaqueObjects.push_back({&earthModel, &earthShader, "model3", glm::mat4(1.0f), true, opaqueObjects[0].bounds,
+                                     true, true});
+        else
+            opaqueObjects.push_back({&moonModel, &moonShader, "model2", glm::mat4(1.0f), true, opaqueObjects[1].bounds,
+                                     body.kind == rg::SceneGenerator::Moon, true});
+    }
+    OpaqueObject &earthObject = opaqueObjects[0];
+    OpaqueObject &moonObject = opaqueObjects[1];
+    OpaqueObject &sunObject = opaqueObjects[2];
+
+    // multi-draw indirect: all opaque objects in one draw call
+    // --------------------------------------------------------
+    Shader *mdiShader = NULL;
+    rg::MultiDrawBatch opaqueBatch;
+    if (programState->MultiDrawIndirectSupported) {
+        mdiShader = new Shader("resources/shaders/mdi.vs", "resources/shaders/mdi.fs");
+        for (OpaqueObject &object : opaqueObjects)
+            opaqueBatch.addObject(*object.model, object.lit);
+        opaqueBatch.build();
+    }
+    rg::GpuTimer opaqueTimers[2][2];
+    rg::SampleCounter shadedCounters[2][2];
+    std::vector<unsigned int> opaqueOrder(opaqueObjects.size());
+    std::vector<float> opaqueDepth(opaqueObjects.size());
+
+    // depth pre-pass, position only
+    // -----------------------------
+    Shader depthShader("resources/shaders/depth.vs", "resources/shaders/depth.fs");
+    Shader *mdiDepthShader = NULL;
+    if (programState->MultiDrawIndirectSupported)
+        mdiDepthShader = new Shader("resources/shaders/mdi_depth.vs", "resources/shaders/depth.fs");
+    // auto mode: the first AutoProbeFrames frames of every period run without the pre-pass, the next
+    // AutoProbeFrames with it, and the rest of the period uses whichever had the lower GPU time
+    const int AutoPeriodFrames = 300;
+    const int AutoProbeFrames = 30;
+    int autoFrame = 0;
+    bool autoChoice = false;
+
+    // dynamic per frame data (multi-draw transforms) goes through one streaming ring buffer
+    rg::StreamBuffer streamBuffer(256 * 1024);
+    programState->streamBuffer = &streamBuffer;
+
+    // the scene is rendered offscreen in HDR and tonemapped into the window at the end of the frame
+    // ---------------------------------------------------------------------------------------------
+    if (window != NULL)
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+    rg::RenderTarget sceneTarget;
+    rg::Bloom bloom;
+    programState->bloom = &bloom;
+    Shader tonemapShader("resources/shaders/fullscreen.vs", "resources/shaders/tonemap.fs");
+    rg::GpuTimer tonemapTimer;
+    rg::TranslucentPass translucentPass;
+    translucentPass.setDepthRange(0.1f, 150.0f);
+    programState->translucentPass = &translucentPass;
+    rg::FrameGraph frameGraph;
+    FrameGraphConfig frameGraphConfig;
+    programState->frameGraph = &frameGraph;
+    // the governor sees the GPU time from the start of the frame to the end of the tonemapping
+    rg::ResolutionGovernor governor;
+    rg::GpuSpanTimer sceneTimer;
+    unsigned long long sceneTimerResults = 0;
+    programState->governor = &governor;
+    rg::GpuProfiler gpuProfiler;
+    programState->gpuProfiler = &gpuProfiler;
+    rg::FlightRecorder flightRecorder;
+    flightRecorder.settings.budgetMs = hitchBudgetMs;
+    // its dumps would land in the measured frames
+    flightRecorder.settings.enabled = !headless && !playing;
+    programState->flightRecorder = &flightRecorder;
+    unsigned long long frameNumber = 0;
+
+    // translucent objects: the cosmic dust and the overlapping volumes of the benchmark scene,
+    // placed around the earth with a fixed seed so every run sees the same overlap
+    // -----------------------------------------------------------------------------------------
+    const int MaxTranslucentVolumes = 256;
+    // the volumes pick one of three sphere tessellations by their size on screen
+    Model sphereModel(std::vector<Mesh>{rg::makeSphereMesh(24, 48)});
+    Model sphereModelMedium(std::vector<Mesh>{rg::makeSphereMesh(12, 24)});
+    Model sphereModelLow(std::vector<Mesh>{rg::makeSphereMesh(6, 12)});
+    Model *sphereLods[3] = {&sphereModel, &sphereModelMedium, &sphereModelLow};
+    std::vector<rg::TranslucentObject> translucentVolumes;
+    std::mt19937 volumeRandom(1234);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (int i = 0; i < MaxTranslucentVolumes; i++) {
+        glm::vec3 position = glm::vec3(0.5f, 15.5f, 3.0f) + glm::vec3(unit(volumeRandom) - 0.5f, unit(volumeRandom) - 0.5f,
+                                                                      unit(volumeRandom) - 0.5f) * 24.0f;
+        glm::mat4 transform = glm::translate(glm::mat4(1.0f), position);
+        transform = glm::scale(transform, glm::vec3(1.5f + 2.5f * unit(volumeRandom)));
+        glm::vec4 tint(unit(volumeRandom), unit(volumeRandom), unit(volumeRandom), 0.2f + 0.4f * unit(volumeRandom));
+        translucentVolumes.push_back({&sphereModel, transform, tint, 1});
+    }
+    std::vector<rg::TranslucentObject> translucentObjects;
+
+    // screenshots and recordings of the window, without ImGui; the offscreen modes read back their own frames
+    // ---------------------------------------------------------------------------------------------------------
+    rg::FrameCapture frameCapture;
+    frameCapture.settings = captureSettings;
+    programState->frameCapture = headless ? NULL : &frameCapture;
+    if (captureFromStart && !frameCapture.start())
+        return -1;
 
+    // on demand the window is only rendered again when something in it changes; the runs on a
+    // simulation clock render every frame
+    // ------------------------------------------------------------------------------------------
+    rg::RedrawTracker redrawTracker;
+    programState->redrawTracker = &redrawTracker;
+    const bool fixedStep = bench || playing || golden || farmWorker;
+    // a recording renders every frame and starts with the scene running, like its replay
+    redrawTracker.settings.enabled = onDemand && !fixedStep && window != NULL && !inputRecorder.recording();
+    if (window != NULL) {
+        const GLFWvidmode *videoMode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+        if (videoMode != NULL && videoMode->refreshRate > 0)
+            redrawTracker.settings.refreshRate = videoMode->refreshRate;
+    }
+    // the animated scene would need a frame every refresh, so on demand it starts paused (F6)
+    programState->animationPaused = redrawTracker.settings.enabled;
+    // seconds the scene clock is behind the frame clock, from the pauses
+    float animationOffset = 0.0f;
+
+    // clustered point lights in low orbits around the earth, also seeded
+    // -------------------------------------------------------------------
+    rg::JobSystem jobSystem;
+    rg::ClusteredLights clusteredLights(jobSystem);
+    programState->clusteredLights = &clusteredLights;
+    programState->jobThreads = jobSystem.threadCount();
+    const int MaxClusteredLights = 4096;
+    const glm::vec3 earthCenter(0.5f, 15.5f, 3.0f);
+    std::vector<LightOrbit> lightOrbits;
+    std::vector<rg::ClusterLight> sceneLights;
+    std::mt19937 lightRandom(4321);
+    for (int i = 0; i < MaxClusteredLights; i++) {
+        glm::vec3 axis, side;
+        do {
+            axis = glm::vec3(unit(lightRandom), unit(lightRandom), unit(lightRandom)) * 2.0f - 1.0f;
+            side = glm::cross(axis, glm::vec3(unit(lightRandom), unit(lightRandom), unit(lightRandom)) * 2.0f - 1.0f);
+        } while (glm::length(axis) < 0.01f || glm::length(side) < 0.01f);
+        float radius = 3.6f + 1.4f * unit(lightRandom);
+        float speed = (0.2f + 0.8f * unit(lightRandom)) * (unit(lightRandom) < 0.5f ? -1.0f : 1.0f);
+        lightOrbits.push_back({glm::normalize(axis), glm::normalize(side) * radius, speed});
+
+        glm::vec3 color(unit(lightRandom), unit(lightRandom), unit(lightRandom));
+        color /= std::max(color.r, std::max(color.g, color.b));
+        sceneLights.push_back({glm::vec3(0.0f), color, 1.0f, 2.0f, 20.0f});
+    }
+    std::vector<rg::ClusterLight> activeLights;
+
+    // shadows of the point light
+    // --------------------------
+    rg::PointShadows pointShadows(1024, 150.0f);
+    programState->pointShadows = &pointShadows;
+    std::vector<rg::PointShadows::Caster> shadowCasters;
+    // world bounds of the opaque objects, the shadow casting ones among them, and where each object
+    // is in shadowBodies (-1 for none)
+    std::vector<rg::BoundingSphere> opaqueBounds(opaqueObjects.size());
+    std::vector<rg::BoundingSphere> shadowBodies;
+    std::vector<int> shadowBodyIndex(opaqueObjects.size());
+
+    // benchmark, golden images and farm: no vsync, the tonemapped frames go into an offscreen texture
+    // of the run's size; the golden images and the farm read it back through a framebuffer of its own
+    // ------------------------------------------------------------------------------------------------
+    GLuint benchOutput = 0;
+    unsigned long long benchGpuResults = 0;
+    if (headless) {
+        if (window != NULL)
+            glfwSwapInterval(0);
+        framebufferWidth = golden ? goldenSuite.width : benchSettings.width;
+        framebufferHeight = golden ? goldenSuite.height : benchSettings.height;
+        benchOutput = rg::createTexture2D(framebufferWidth, framebufferHeight, GL_RGBA8);
+    }
+    GLuint readbackFramebuffer = 0;
+    rg::PixelReadback frameReadback;
+    // the tag is the frame number of the run
+    int farmFrames = shardLast - shardFirst + 1, farmWritten = 0;
+    rg::PixelReadback::Handler storeFrame = [&](unsigned long long tag, rg::Image &image) {
+        if (golden)
+            goldenSuite.setFrame(tag, image);
+        else if (rg::RenderFarm::writeFrame(farmDirectory, shardFirst + (int) tag, image))
+            farmWritten++;
+        else
+            std::cout << "Failed to write " << rg::RenderFarm::framePath(farmDirectory, shardFirst + (int) tag) << '\n';
+    };
+    if (golden || farmWorker) {
+        glGenFramebuffers(1, &readbackFramebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, readbackFramebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, benchOutput, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+    if (golden)
+        std::cout << "Golden images: " << goldenSuite.size() << " views at " << framebufferWidth << "x"
+                  << framebufferHeight << '\n';
+    if (farmWorker)
+        std::cout << "Farm: frames " << shardFirst << " to " << shardLast << " at " << framebufferWidth << "x"
+                  << framebufferHeight << " into " << farmDirectory << '\n';
+    if (bench) {
+        programState->clusteredLightCount = std::min(benchSettings.clusteredLights, MaxClusteredLights);
+        programState->translucentVolumeCount = std::min(benchSettings.translucentVolumes, MaxTranslucentVolumes);
+        benchmark.addInfo("gl_renderer", (const char *) glGetString(GL_RENDERER));
+        benchmark.addInfo("gl_version", (const char *) glGetString(GL_VERSION));
+        benchmark.addInfo("multi_draw_indirect", programState->MultiDrawIndirectEnabled ? "on" : "off");
+        benchmark.addInfo("transparency_mode", rg::transparencyModeName(programState->transparencyMode));
+        benchmark.addInfo("shadow_mode", rg::shadowModeName(programState->shadowMode));
+        benchmark.addInfo("job_threads", std::to_string(programState->jobThreads));
+        benchmark.addInfo("scene", sceneSettings.toString());
+        std::cout << "Benchmark: " << benchSettings.warmupFrames << " + " << benchSettings.frames << " frames at "
+                  << framebufferWidth << "x" << framebufferHeight << '\n';
+    }
+    double startupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - programStart).count();
 
     // render loop
     // -----------
-    while (!glfwWindowShouldClose(window)) {
-        // per-frame time logic
-        // --------------------
-        float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
+    // the offscreen runs end by themselves, the window also when it is closed
+    bool runFinished = false;
+    while (!runFinished && !(window != NULL && glfwWindowShouldClose(window))) {
+        if (!fixedStep && !programState->animationPaused)
+            redrawTracker.invalidate(rg::RedrawTracker::Animation);
+        if (frameCapture.busy())
+            redrawTracker.invalidate(rg::RedrawTracker::Capture);
+        if (!redrawTracker.needsFrame()) {
+            // nothing changed, the window keeps showing the last frame
+            CPU_ZONE("idle");
+            double timeout = programState->ImGuiEnabled ? redrawTracker.settings.interfaceRefreshSeconds
+                                                        : redrawTracker.settings.idleTimeoutSeconds;
+            glfwWaitEventsTimeout(timeout);
+            if (!redrawTracker.needsFrame()) {
+                redrawTracker.idleWakeup();
+                if (programState->ImGuiEnabled)
+                    redrawTracker.invalidate(rg::RedrawTracker::Interface);
+            }
+            // the wait neither moves the camera nor, with the animation paused, the scene
+            float now = (float) glfwGetTime();
+            animationOffset += now - lastFrame;
+            lastFrame = now;
+            continue;
+        }
+        CPU_ZONE("frame");
+        auto frameStart = std::chrono::steady_clock::now();
+        uint64_t frameStartTicks = rg::CpuProfiler::now();
+        rg::drawStats() = rg::DrawStats();
+        // per-frame time logic, the benchmark, replays, golden images and the farm run on a simulation clock
+        // ---------------------------------------------------------------------------------------------------
+        float currentFrame = golden ? goldenSuite.test(frameNumber).time
+                             : farmWorker ? (float) rg::Benchmark::frameTime(shardFirst + (long long) frameNumber)
+                             : fixedStep ? (float) benchmark.time() : (float) glfwGetTime();
+        deltaTime = fixedStep ? benchmark.deltaTime() : currentFrame - lastFrame;
         lastFrame = currentFrame;
+        if (programState->animationPaused)
+            animationOffset += deltaTime;
+        float sceneTime = currentFrame - animationOffset;
 
         // input
         // -----
-        processInput(window);
+        if (playing) {
+            const rg::InputFrame &input = playback.frame(frameNumber);
+            for (const rg::InputFrame::Key &key : input.keys)
+                handleKey(window, key.key, key.action);
+            rg::InputPlayback::applyCamera(input, programState->camera);
+            if (window != NULL && glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+                glfwSetWindowShouldClose(window, true);
+        } else if (bench) {
+            benchmark.placeCamera(programState->camera);
+        } else if (golden) {
+            goldenSuite.placeCamera(frameNumber, programState->camera);
+        } else if (farmWorker) {
+            benchmark.placeCamera(programState->camera, rg::Benchmark::frameTime(shardFirst + (long long) frameNumber));
+        } else {
+            CPU_ZONE("input");
+            processInput(window);
+        }
+        inputRecorder.recordFrame(deltaTime, programState->camera);
+
+        streamBuffer.beginFrame();
+
+        governor.update(sceneTimer.lastMs(), sceneTimer.results() != sceneTimerResults);
+        sceneTimerResults = sceneTimer.results();
+        int sceneWidth = std::max((int) std::lround(framebufferWidth * governor.scale()), 1);
+        int sceneHeight = std::max((int) std::lround(framebufferHeight * governor.scale()), 1);
+        // effect quality: translucent layers at no more than 1/2 and then 1/4 resolution, then no bloom
+        // on top of 1/4 at level 0
+        int minResolutionDivisor = 1 << std::min(rg::ResolutionGovernor::QualityLevels - 1 - governor.quality(), 2);
+
+        // a minimized window has a zero sized framebuffer, keep the old targets until it comes back
+        if ((sceneTarget.width != sceneWidth || sceneTarget.height != sceneHeight)
+            && framebufferWidth > 0 && framebufferHeight > 0) {
+            sceneTarget.create(sceneWidth, sceneHeight, {GL_RGBA16F});
+        }
+        programState->sceneWidth = sceneTarget.width;
+        programState->sceneHeight = sceneTarget.height;
+        sceneTimer.begin();
+        gpuProfiler.beginFrame();
+        int frameScope = gpuProfiler.begin("frame");
 
 
         // render
         // ------
+        sceneTarget.bind();
         glClearColor(programState->clearColor.r, programState->clearColor.g, programState->clearColor.b, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        {
+            rg::GpuProfiler::Scope scope(gpuProfiler, "clear");
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        }
 
 
-        // --------------- earthShader----------------------------------------------------
-        earthShader.use();
-        earthShader.setVec3("pointLight.position", pointLight.position);
-        earthShader.setVec3("pointLight.ambient", pointLight.ambient);
-        earthShader.setVec3("pointLight.diffuse", pointLight.diffuse);
-        earthShader.setVec3("pointLight.specular", pointLight.specular);
-        earthShader.setFloat("pointLight.constant", pointLight.constant);
-        earthShader.setFloat("pointLight.linear", pointLight.linear);
-        earthShader.setFloat("pointLight.quadratic", pointLight.quadratic);
-        earthShader.setVec3("viewPosition", programState->camera.Position);
-        earthShader.setFloat("material.shininess", 32.0f);
-
-        earthShader.setVec3("dirLight1.direction", -0.2f, -1.0f, -0.3f);
-        earthShader.setVec3("dirLight1.ambient", 0.005f, 0.005f, 0.005f);
-        earthShader.setVec3("dirLight1.diffuse", 0.005f, 0.005f, 0.005f);
-        earthShader.setVec3("dirLight1.specular", 0.005f, 0.005f, 0.005f);
-
-        earthShader.setVec3("dirLight2.direction", 0.2f, -1.0f, -0.3f);
-        earthShader.setVec3("dirLight2.ambient", 0.005f, 0.005f, 0.005f);
-        earthShader.setVec3("dirLight2.diffuse", 0.005f, 0.005f, 0.005f);
-        earthShader.setVec3("dirLight2.specular", 0.005f, 0.005f, 0.005f);
-
-        earthShader.setVec3("dirLight3.direction", -0.2f, 1.0f, -0.3f);
-        earthShader.setVec3("dirLight3.ambient", 0.005f, 0.005f, 0.005f);
-        earthShader.setVec3("dirLight3.diffuse", 0.005f, 0.005f, 0.005f);
-        earthShader.setVec3("dirLight3.specular", 0.005f, 0.005f, 0.005f);
-
-        earthShader.setVec3("dirLight4.direction", 0.2f, 1.0f, -0.3f);
-        earthShader.setVec3("dirLight4.ambient", 0.005f, 0.005f, 0.005f);
-        earthShader.setVec3("dirLight4.diffuse", 0.005f, 0.005f, 0.005f);
-        earthShader.setVec3("dirLight4.specular", 0.005f, 0.005f, 0.005f);
-
-
-        // -----------------moonShader --------------------------------------------
-        moonShader.use();
-        moonShader.setVec3("pointLight.position", pointLight.position);
-        moonShader.setVec3("pointLight.ambient", pointLight.ambient);
-        moonShader.setVec3("pointLight.diffuse", pointLight.diffuse);
-        moonShader.setVec3("pointLight.specular", pointLight.specular);
-        moonShader.setFloat("pointLight.constant", pointLight.constant);
-        moonShader.setFloat("pointLight.linear", pointLight.linear);
-        moonShader.setFloat("pointLight.quadratic", pointLight.quadratic);
-        moonShader.setVec3("viewPosition", programState->camera.Position);
-        moonShader.setFloat("material.shininess", 32.0f);
-
-        moonShader.setVec3("dirLight1.direction", -0.2f, -1.0f, -0.3f);
-        moonShader.setVec3("dirLight1.ambient", 0.005f, 0.005f, 0.005f);
-        moonShader.setVec3("dirLight1.diffuse", 0.005f, 0.005f, 0.005f);
-        moonShader.setVec3("dirLight1.specular", 0.005f, 0.005f, 0.005f);
-
-        moonShader.setVec3("dirLight2.direction", 0.2f, -1.0f, -0.3f);
-        moonShader.setVec3("dirLight2.ambient", 0.005f, 0.005f, 0.005f);
-        moonShader.setVec3("dirLight2.diffuse", 0.005f, 0.005f, 0.005f);
-        moonShader.setVec3("dirLight2.specular", 0.005f, 0.005f, 0.005f);
-
-        moonShader.setVec3("dirLight3.direction", -0.2f, 1.0f, -0.3f);
-        moonShader.setVec3("dirLight3.ambient", 0.005f, 0.005f, 0.005f);
-        moonShader.setVec3("dirLight3.diffuse", 0.005f, 0.005f, 0.005f);
-        moonShader.setVec3("dirLight3.specular", 0.005f, 0.005f, 0.005f);
-
-        moonShader.setVec3("dirLight4.direction", 0.2f, 1.0f, -0.3f);
-        moonShader.setVec3("dirLight4.ambient", 0.005f, 0.005f, 0.005f);
-        moonShader.setVec3("dirLight4.diffuse", 0.005f, 0.005f, 0.005f);
-        moonShader.setVec3("dirLight4.specular", 0.005f, 0.005f, 0.005f);
+        {
+            CPU_ZONE("uniform setup");
+            // --------------- earthShader----------------------------------------------------
+            earthShader.use();
+            SetLightUniforms(earthShader, pointLight, programState->camera.Position);
+
+            // -----------------moonShader --------------------------------------------
+            moonShader.use();
+            SetLightUniforms(moonShader, pointLight, programState->camera.Position);
+        }
 
         // view/projection transformations
         // -------------------------------
         glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom),
-                                                (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 150.0f);
+                                                (float) sceneTarget.width / (float) sceneTarget.height, 0.1f, 150.0f);
         glm::mat4 view = programState->camera.GetViewMatrix();
         
-        earthShader.use();
-        earthShader.setMat4("projection", projection);
-        earthShader.setMat4("view", view);
-
-        shader.use();
-        shader.setMat4("projection", projection);
-        shader.setMat4("view", view);
+        // move the clustered lights and bin them for this view; the generated ones come after them
+        sceneGenerator.update(sceneTime);
+        activeLights.resize(programState->clusteredLightCount);
+        jobSystem.parallelFor(activeLights.size(), 512, [&](unsigned int begin, unsigned int end) {
+            for (unsigned int i = begin; i < end; i++) {
+                const LightOrbit &orbit = lightOrbits[i];
+                float angle = orbit.speed * sceneTime;
+                activeLights[i] = sceneLights[i];
+                activeLights[i].position = earthCenter + orbit.start * std::cos(angle)
+                                           + glm::cross(orbit.axis, orbit.start) * std::sin(angle);
+            }
+        });
+        for (unsigned int i = 0; i < sceneGenerator.lights().size(); i++)
+            activeLights.push_back({sceneGenerator.lightPosition(i), sceneGenerator.lights()[i].color, 1.0f, 2.0f, 20.0f});
+        clusteredLights.update(activeLights, view, projection, 0.1f, 150.0f);
 
-        moonShader.use();
-        moonShader.setMat4("projection", projection);
-        moonShader.setMat4("view", view);
+        {
+            CPU_ZONE("uniform setup");
+            earthShader.use();
+            earthShader.setMat4("projection", projection);
+            earthShader.setMat4("view", view);
+            clusteredLights.bind(earthShader, sceneTarget.width, sceneTarget.height);
+
+            shader.use();
+            shader.setMat4("projection", projection);
+            shader.setMat4("view", view);
+            shader.setFloat("emissiveStrength", programState->emissiveStrength);
+
+            moonShader.use();
+            moonShader.setMat4("projection", projection);
+            moonShader.setMat4("view", view);
+            clusteredLights.bind(moonShader, sceneTarget.width, sceneTarget.height);
+        }
 
         // render the loaded model
         // -----------------------
-        earthShader.use();
-        glm::mat4 model3 = glm::mat4(1.0f);
-        model3 = glm::translate(model3,glm::vec3(0.5f ,15.5f,3.0f));
-        model3 = glm::scale(model3,glm::vec3(1.0f));
-        model3 = glm::rotate(model3,glm::radians(180.0f),glm::vec3(1.0f,0.0f,0.0f));
-        model3 = glm::rotate(model3,-(float)glfwGetTime()/2,glm::vec3(0.0f,1.0f,0.0f));
-        earthShader.setMat4("model3", model3);
-        earthModel.Draw(earthShader);
+        PlaceBaseObjects(sceneTime, earthObject.transform, moonObject.transform, sunObject.transform);
 
-        moonShader.use();
-        glm::mat4 model2 = glm::mat4(1.0f);
-        model2 = glm::translate(model2,glm::vec3(-2.0f * cos(currentFrame/8) * 4,14.5f ,-2.0f * sin(currentFrame/8) * 4));
-        model2 = glm::scale(model2,glm::vec3(1.0f));
-        moonShader.setMat4("model2", model2);
-        moonModel.Draw(moonShader);
+        for (unsigned int i = firstGeneratedObject; i < opaqueObjects.size(); i++)
+            opaqueObjects[i].transform = sceneGenerator.bodyTransform(i - firstGeneratedObject, opaqueObjects[i].bounds.radius);
 
-        shader.use();
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-28.0f,11.5f,75.0f));
-        model = glm::scale(model, glm::vec3(5.0f));
-        model = glm::rotate(model,(float)glfwGetTime()/8, glm::vec3(0.0f,1.0f,0.0f));
-        shader.setMat4("model", model);
-        sunModel.Draw(shader);
+        shadowCasters.clear();
+        for (const OpaqueObject &object : opaqueObjects) {
+            if (object.castsShadow)
+                shadowCasters.push_back({object.model, object.transform, rg::transformSphere(object.bounds, object.transform),
+                                         object.dynamicCaster});
+        }
+        {
+            CPU_ZONE("shadows");
+            rg::DebugGroup group("shadows");
+            rg::GpuProfiler::Scope scope(gpuProfiler, "shadows");
+            pointShadows.update(shadowCasters, pointLight.position, programState->shadowMode);
+        }
 
-        cdShader.use();
-        cdShader.setMat4("projection", projection);
-        cdShader.setMat4("view", view);
+        // eclipse occluders of every lit object among the shadow casting bodies, by where they are
+        // relative to it and the light; the multi-draw batch has a single program and gets all of them
+        shadowBodies.clear();
+        for (unsigned int i = 0; i < opaqueObjects.size(); i++) {
+            const OpaqueObject &object = opaqueObjects[i];
+            opaqueBounds[i] = rg::transformSphere(object.bounds, object.transform);
+            shadowBodyIndex[i] = object.castsShadow ? (int) shadowBodies.size() : -1;
+            if (object.castsShadow)
+                shadowBodies.push_back(opaqueBounds[i]);
+        }
+        rg::EclipseOccluders batchOccluders;
+        for (unsigned int i = 0; i < opaqueObjects.size(); i++) {
+            OpaqueObject &object = opaqueObjects[i];
+            if (!object.lit)
+                continue;
+            object.occluders = rg::selectOccluders(opaqueBounds[i], shadowBodies, shadowBodyIndex[i], pointLight.position,
+                                                   programState->eclipseLightRadius);
+            for (int j = 0; j < object.occluders.count; j++)
+                batchOccluders.add(object.occluders.spheres[j]);
+            if (i < 2)
+                programState->eclipseOccluderCount[i] = object.occluders.count;
+        }
+        sceneTarget.bind();
+        earthShader.use();
+        pointShadows.bind(earthShader);
+        moonShader.use();
+        pointShadows.bind(moonShader);
+
+        bool useMultiDraw = programState->MultiDrawIndirectEnabled && mdiShader != NULL;
+        bool usePrePass = programState->depthPrePassMode == DepthPrePassOn;
+        if (programState->depthPrePassMode == DepthPrePassAuto) {
+            int phase = autoFrame++ % AutoPeriodFrames;
+            if (phase == 2 * AutoProbeFrames) {
+                const OpaquePassStats *measured = programState->opaquePassStats[useMultiDraw];
+                autoChoice = measured[1].gpuMs < measured[0].gpuMs;
+            }
+            usePrePass = phase < AutoProbeFrames ? false : phase < 2 * AutoProbeFrames ? true : autoChoice;
+        }
+        programState->depthPrePassActive = usePrePass;
 
+        // front-to-back by view depth of the object origins, so early depth testing rejects as
+        // much as possible; the multi-draw batch keeps its command order
+        for (unsigned int i = 0; i < opaqueObjects.size(); i++) {
+            opaqueOrder[i] = i;
+            opaqueDepth[i] = -(view * opaqueObjects[i].transform[3]).z;
+        }
+        if (programState->frontToBackOrdering)
+            std::sort(opaqueOrder.begin(), opaqueOrder.end(),
+                      [&opaqueDepth](unsigned int a, unsigned int b) { return opaqueDepth[a] < opaqueDepth[b]; });
+        if (useMultiDraw) {
+            for (unsigned int i = 0; i < opaqueObjects.size(); i++)
+                opaqueBatch.setTransform(i, opaqueObjects[i].transform);
+        }
+
+        rg::GpuTimer &opaqueTimer = opaqueTimers[useMultiDraw][usePrePass];
+        rg::SampleCounter &shadedCounter = shadedCounters[useMultiDraw][usePrePass];
+        auto opaqueStart = std::chrono::steady_clock::now();
+        rg::GLDebug::pushGroup("opaque");
+        int opaqueScope = gpuProfiler.begin(usePrePass ? "opaque with pre-pass" : "opaque");
+        opaqueTimer.begin();
+        if (usePrePass) {
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            if (useMultiDraw) {
+                mdiDepthShader->use();
+                mdiDepthShader->setMat4("projection", projection);
+                mdiDepthShader->setMat4("view", view);
+                opaqueBatch.DrawDepth(streamBuffer);
+            } else {
+                depthShader.use();
+                depthShader.setMat4("projection", projection);
+                depthShader.setMat4("view", view);
+                for (unsigned int i : opaqueOrder) {
+                    depthShader.setMat4("model", opaqueObjects[i].transform);
+                    opaqueObjects[i].model->DrawDepth();
+                }
+            }
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            // only the nearest surface of every pixel is shaded
+            glDepthFunc(GL_EQUAL);
+            glDepthMask(GL_FALSE);
+        }
+        shadedCounter.begin();
+        if (useMultiDraw) {
+            mdiShader->use();
+            SetLightUniforms(*mdiShader, pointLight, programState->camera.Position);
+            mdiShader->setMat4("projection", projection);
+            mdiShader->setMat4("view", view);
+            mdiShader->setInt("materialMaps", 0);
+            clusteredLights.bind(*mdiShader, sceneTarget.width, sceneTarget.height);
+            pointShadows.bind(*mdiShader);
+            rg::setEclipseUniforms(*mdiShader, batchOccluders, programState->eclipseLightRadius);
+            mdiShader->setFloat("emissiveStrength", programState->emissiveStrength);
+            opaqueBatch.Draw(streamBuffer);
+        } else {
+            for (unsigned int i : opaqueOrder) {
+                OpaqueObject &object = opaqueObjects[i];
+                object.shader->use();
+                if (object.lit)
+                    rg::setEclipseUniforms(*object.shader, object.occluders, programState->eclipseLightRadius);
+                object.shader->setMat4(object.modelUniform, object.transform);
+                object.model->Draw(*object.shader);
+            }
+        }
+        shadedCounter.end();
+        if (usePrePass) {
+            glDepthFunc(GL_LESS);
+            glDepthMask(GL_TRUE);
+        }
+        opaqueTimer.end();
+        gpuProfiler.end(opaqueScope);
+        rg::GLDebug::popGroup();
+        OpaquePassStats &opaqueStats = programState->opaquePassStats[useMultiDraw][usePrePass];
+        double opaqueCpuMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - opaqueStart).count();
+        opaqueStats.cpuMs = opaqueStats.cpuMs == 0.0 ? opaqueCpuMs : opaqueStats.cpuMs * 0.9 + opaqueCpuMs * 0.1;
+        opaqueStats.gpuMs = opaqueTimer.averageMs();
+        opaqueStats.shadedFragments = shadedCounter.lastSamples();
 
         glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
 
         // skybox drawing
         // --------------
         skyboxShader.use();
-        view = glm::mat4(glm::mat3(programState->camera.GetViewMatrix())); // remove translation from the view matrix
-        skyboxShader.setMat4("view", view);
+        skyboxShader.setMat4("view", glm::mat4(glm::mat3(view))); // remove translation from the view matrix
         skyboxShader.setMat4("projection", projection);
 
         // skybox cube
         // -----------
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
+        {
+            rg::DebugGroup group("skybox");
+            int skyboxScope = gpuProfiler.begin("skybox");
+            glBindVertexArray(skyboxVAO);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+            glDrawArrays(GL_TRIANGLES, 0, 36);
+            rg::countDraw(12);
+            glBindVertexArray(0);
+            gpuProfiler.end(skyboxScope);
+        }
         glDepthFunc(GL_LESS); // set depth function back to default
 
         // BLENDING
         // iskljucujemo Face CULLING jer kada nam se kosmicka prasina providi, a ne iscrtava nam se skybox
         // zbog Face CULLINGA, kosmicka prasina nam bude zelena jer je onda sam skybox zelen jer se ustvari
-        // ne iscrtava
-        glDisable(GL_CULL_FACE);
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA,GL_ONE_MINUS_SRC_ALPHA);
+        // ne iscrtava (vidi rg::TranslucentPass)
 
         // cosmic dust drawing
         // -------------------
-        cdShader.use();
-        model = glm::mat4(1.0f);
+        glm::mat4 model = glm::mat4(1.0f);
         model = glm::translate(model,glm::vec3(16.0f,18.0f,-12.0f));
         model = glm::scale(model,glm::vec3(10.0f));
-        cdShader.setMat4("model", model);
-        cdModel.Draw(cdShader);
+        translucentObjects.clear();
+        translucentObjects.push_back({&cdModel, model, glm::vec4(0.5f, 0.5f, 0.5f, 0.5f),
+                                      std::max(programState->dustResolutionDivisor, minResolutionDivisor)});
+        for (int i = 0; i < programState->translucentVolumeCount; i++) {
+            translucentObjects.push_back(translucentVolumes[i]);
+            rg::TranslucentObject &volume = translucentObjects.back();
+            volume.resolutionDivisor = std::max(programState->volumeResolutionDivisor, minResolutionDivisor);
+            // radius over distance, about the fraction of the screen height the sphere covers
+            float size = glm::length(glm::vec3(volume.transform[0]))
+                         / std::max(glm::length(glm::vec3(volume.transform[3]) - programState->camera.Position), 0.1f);
+            int lod = (size > 0.15f ? 0 : size > 0.05f ? 1 : 2) + governor.lodBias();
+            volume.model = sphereLods[std::min(lod, 2)];
+        }
+        for (unsigned int i = 0; i < sceneGenerator.clouds().size(); i++) {
+            translucentObjects.push_back({&cdModel, sceneGenerator.cloudTransform(i, cloudModelRadius),
+                                          sceneGenerator.clouds()[i].tint,
+                                          std::max(programState->volumeResolutionDivisor, minResolutionDivisor)});
+        }
 
-        // turn off BLENDING and return settings for FACE CULLING
-        glDisable(GL_BLEND);
-        glEnable(GL_CULL_FACE);
+        int transparencyMode = programState->transparencyMode;
+        translucentPass.setFrame(translucentObjects, view, projection, programState->camera.Position, transparencyMode);
+        bloom.setThreshold(programState->bloomThreshold, 0.5f * programState->bloomThreshold);
+
+        // translucent layers, bloom and tonemapping run through the frame graph, which is only
+        // rebuilt when the resolution or the set of passes changes
+        FrameGraphConfig config;
+        config.width = sceneTarget.width;
+        config.height = sceneTarget.height;
+        config.windowWidth = framebufferWidth;
+        config.windowHeight = framebufferHeight;
+        config.bloomEnabled = programState->bloomEnabled && governor.quality() > 0;
+        config.transparencyMode = transparencyMode;
+        config.translucentLayers = rg::TranslucentPass::usedLayers(translucentObjects);
+        if (!(config == frameGraphConfig)) {
+            frameGraphConfig = config;
+            frameGraph.reset();
+            rg::FrameGraph::TextureDesc sceneDesc = {sceneTarget.width, sceneTarget.height, GL_RGBA16F};
+            rg::FrameGraph::Resource sceneColor = frameGraph.importTexture("scene color", sceneTarget.colorTextures[0], sceneDesc);
+            rg::FrameGraph::Resource sceneDepth = frameGraph.importTexture(
+                    "scene depth", sceneTarget.depthTexture, {sceneTarget.width, sceneTarget.height, GL_DEPTH24_STENCIL8});
+            rg::FrameGraph::Resource window = frameGraph.importTexture("window", benchOutput,
+                                                                       {framebufferWidth, framebufferHeight, GL_RGBA8});
+            translucentPass.addPasses(frameGraph, sceneColor, sceneDepth, transparencyMode, config.translucentLayers);
+            // always declared, without bloom nothing reads it and the graph drops the whole chain
+            rg::FrameGraph::Resource bloomResult = bloom.addPasses(frameGraph, sceneColor);
+
+            // tonemap the scene into the window, upscaling it when the governor lowered its resolution;
+            // ImGui is drawn directly on top of it
+            bool bloomEnabled = config.bloomEnabled;
+            auto tonemapPass = [&tonemapShader, &tonemapTimer, sceneColor, bloomResult,
+                                bloomEnabled](const rg::FrameGraph &graph) {
+                tonemapTimer.begin();
+                glDisable(GL_DEPTH_TEST);
+                tonemapShader.use();
+                tonemapShader.setInt("scene", 0);
+                tonemapShader.setInt("bloom", 1);
+                tonemapShader.setFloat("bloomStrength", bloomEnabled ? programState->bloomStrength : 0.0f);
+                tonemapShader.setFloat("exposure", programState->exposure);
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, graph.texture(sceneColor));
+                glActiveTexture(GL_TEXTURE1);
+                glBindTexture(GL_TEXTURE_2D, bloomEnabled ? graph.texture(bloomResult) : 0);
+                glActiveTexture(GL_TEXTURE0);
+                rg::drawFullscreenTriangle();
+                glEnable(GL_DEPTH_TEST);
+                tonemapTimer.end();
+            };
+            rg::FrameGraph::Pass &tonemap = frameGraph.addPass("tonemap", tonemapPass).read(sceneColor).write(window);
+            if (config.bloomEnabled)
+                tonemap.read(bloomResult);
+            frameGraph.compile();
+        }
+        {
+            CPU_ZONE("frame graph");
+            frameGraph.execute(&gpuProfiler);
+        }
+        sceneTimer.end();
+        programState->tonemapGpuMs = tonemapTimer.averageMs();
+        programState->sceneDraws = rg::drawStats();
+
+        // the layers are timed separately, GL timer queries can't nest
+        double translucentMs = 0.0;
+        for (int i = 0; i < rg::TranslucentPass::LayerCount; i++) {
+            if (config.translucentLayers & (1u << i))
+                translucentMs += translucentPass.layerStats(i).gpuMs;
+        }
+        programState->translucentGpuMs[transparencyMode] = translucentMs;
 
+        if (!headless) {
+            CPU_ZONE("capture");
+            frameCapture.capture(0, framebufferWidth, framebufferHeight);
+        }
 
-        if (programState->ImGuiEnabled)
+        if (programState->ImGuiEnabled) {
+            CPU_ZONE("ImGui");
+            rg::DebugGroup group("imgui");
+            rg::GpuProfiler::Scope scope(gpuProfiler, "imgui");
             DrawImGui(programState);
-
+        }
+        gpuProfiler.end(frameScope);
+        gpuProfiler.endFrame();
+
+        streamBuffer.endFrame();
+        // the CPU side of the frame up to the swap, which can wait for the GPU
+        double submitMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+        if (golden || farmWorker) {
+            frameReadback.request(readbackFramebuffer, framebufferWidth, framebufferHeight, frameNumber, storeFrame);
+            frameReadback.poll(storeFrame);
+        }
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        if (window != NULL) {
+            {
+                CPU_ZONE("swap");
+                glfwSwapBuffers(window);
+            }
+            {
+                CPU_ZONE("input");
+                glfwPollEvents();
+            }
+        } else {
+            // no swap to hand the frame to the driver
+            CPU_ZONE("swap");
+            glFlush();
+        }
+
+        rg::FlightRecorder::Frame frameRecord;
+        frameRecord.frame = frameNumber++;
+        frameRecord.cpuMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+        frameRecord.gpuMs = sceneTimer.lastMs();
+        frameRecord.drawCalls = programState->sceneDraws.drawCalls;
+        frameRecord.triangles = programState->sceneDraws.triangles;
+        frameRecord.renderScale = governor.scale();
+        frameRecord.startTicks = frameStartTicks;
+        redrawTracker.frameRendered(sceneTimer.lastMs());
+        flightRecorder.endFrame(frameRecord, gpuProfiler, [](std::ostream &out) { programState->WriteReport(out); });
+
+        if (bench || playing) {
+            benchmark.endFrame(frameRecord.cpuMs, submitMs, sceneTimer.lastMs(), sceneTimer.results() != benchGpuResults,
+                               frameRecord.drawCalls, frameRecord.triangles);
+            benchGpuResults = sceneTimer.results();
+            if (benchmark.finished() || (playing && frameNumber >= playback.frameCount()))
+                runFinished = true;
+        }
+        if ((golden && frameNumber >= goldenSuite.size()) || (farmWorker && frameNumber >= (unsigned long long) farmFrames))
+            runFinished = true;
     }
 
-    programState->SaveToFile("resources/program_state.txt");
+    if (playing && !bench) {
+        std::cout << "Replay: CPU frame p50 " << benchmark.cpuPercentile(50) << " ms, p99 " << benchmark.cpuPercentile(99)
+                  << " ms; GPU scene p50 " << benchmark.gpuPercentile(50) << " ms, p99 " << benchmark.gpuPercentile(99)
+                  << " ms\n";
+    }
+    if (!headless) {
+        rg::RedrawTracker::Stats redraw = redrawTracker.stats();
+        std::cout << (redrawTracker.settings.enabled ? "On-demand" : "Continuous") << " rendering: " << redraw.rendered
+                  << " frames rendered, " << redraw.presented << " presented at " << redrawTracker.settings.refreshRate
+                  << " Hz in " << redraw.wallSeconds << " s; CPU " << redraw.cpuSeconds << " s ("
+                  << 100.0 * redraw.cpuSeconds / std::max(redraw.wallSeconds, 1e-6) << "% of a core), GPU "
+                  << redraw.gpuMs / std::max(redraw.wallSeconds, 1e-6) << " ms per second\n";
+    }
+    if (inputRecorder.recording())
+        std::cout << "Recorded " << inputRecorder.frames() << " frames to " << recordLog << '\n';
+
+    if (bench) {
+        if (benchmark.writeReport(benchReport, startupMs))
+            std::cout << "Benchmark: CPU frame p50 " << benchmark.cpuPercentile(50) << " ms, p99 "
+                      << benchmark.cpuPercentile(99) << " ms; GPU scene p50 " << benchmark.gpuPercentile(50)
+                      << " ms, p99 " << benchmark.gpuPercentile(99) << " ms; report in " << benchReport << '\n';
+        else
+            std::cout << "Failed to write benchmark report " << benchReport << '\n';
+    }
+    int exitCode = 0;
+    if (golden || farmWorker) {
+        frameReadback.finish(storeFrame);
+        frameReadback.release();
+        glDeleteFramebuffers(1, &readbackFramebuffer);
+    }
+    if (golden)
+        exitCode = goldenSuite.check(jobSystem, goldenUpdate) == 0 ? 0 : 1;
+    if (farmWorker) {
+        std::cout << "Farm: wrote " << farmWritten << " of " << farmFrames << " frames\n";
+        exitCode = farmWritten == farmFrames ? 0 : 1;
+    }
+    if (headless)
+        glDeleteTextures(1, &benchOutput);
+    frameCapture.finish();
+    frameCapture.release();
+    rg::FrameCapture::Stats captureStats = frameCapture.stats();
+    if (captureStats.captured > 0)
+        std::cout << "Capture: " << captureStats.written << " of " << captureStats.captured << " frames written, "
+                  << captureStats.dropped << " dropped, " << captureStats.failed << " failed, "
+                  << captureStats.stalls << " readback stalls\n";
+
+    const char *opaquePaths[2] = {"per-mesh draws", "multi-draw indirect"};
+    for (int path = 0; path < 2; path++) {
+        for (int prePass = 0; prePass < 2; prePass++) {
+            const OpaquePassStats &stats = programState->opaquePassStats[path][prePass];
+            std::cout << "Opaque pass, " << opaquePaths[path] << (prePass ? " with" : " without") << " depth pre-pass: CPU "
+                      << stats.cpuMs << " ms, GPU " << stats.gpuMs << " ms, " << stats.shadedFragments << " shaded fragments\n";
+        }
+    }
+    for (int i = 0; i < rg::TransparencyModeCount; i++)
+        std::cout << "Translucent pass, " << rg::transparencyModeName(i) << ": GPU " << programState->translucentGpuMs[i] << " ms\n";
+    for (int i = 0; i < rg::TranslucentPass::LayerCount; i++) {
+        rg::TranslucentPass::LayerStats layer = translucentPass.layerStats(i);
+        std::cout << "Translucent layer 1/" << layer.divisor << ": GPU " << layer.gpuMs << " ms, "
+                  << layer.fragments << " fragments\n";
+    }
+    for (int i = 0; i < rg::Bloom::PassCount; i++) {
+        rg::Bloom::PassStats pass = bloom.passStats(i);
+        std::cout << "Bloom " << pass.name << " (" << pass.width << "x" << pass.height << "): GPU " << pass.gpuMs << " ms\n";
+    }
+    std::cout << "Tonemap: GPU " << programState->tonemapGpuMs << " ms\n";
+    const rg::PointShadows::Stats &shadowStats = pointShadows.stats();
+    std::cout << "Shadows, " << rg::shadowModeName(programState->shadowMode) << ": CPU " << shadowStats.cpuMs << " ms, GPU "
+              << shadowStats.gpuMs << " ms, " << shadowStats.staticRebuilds << " static rebuilds\n";
+
+    if (!governorCsv.empty()) {
+        std::ofstream csv(governorCsv);
+        governor.writeCsv(csv);
+    }
+    if (!gpuProfileCsv.empty()) {
+        std::ofstream csv(gpuProfileCsv);
+        gpuProfiler.writeCsv(csv);
+    }
+    if (!cpuTrace.empty() && !rg::CpuProfiler::writeChromeTrace(cpuTrace))
+        std::cout << "Failed to write CPU trace " << cpuTrace << '\n';
+    frameGraph.reset();
+    if (sessionState)
+        programState->SaveToFile("resources/program_state.txt");
     delete programState;
+    delete mdiShader;
+    delete mdiDepthShader;
     ImGui_ImplOpenGL3_Shutdown();
-    ImGui_ImplGlfw_Shutdown();
+    if (window != NULL)
+        ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
+    eglContext.release();
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
     glfwTerminate();
-    return 0;
+    return exitCode;
 }
 
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
@@ -492,6 +1553,11 @@ void processInput(GLFWwindow *window) {
         programState->camera.ProcessKeyboard(LEFT, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
         programState->camera.ProcessKeyboard(RIGHT, deltaTime);
+    // a held key keeps moving the camera without sending new events
+    for (int key : {GLFW_KEY_W, GLFW_KEY_S, GLFW_KEY_A, GLFW_KEY_D}) {
+        if (glfwGetKey(window, key) == GLFW_PRESS)
+            requestRedraw(rg::RedrawTracker::Input);
+    }
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -500,6 +1566,9 @@ void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
     // make sure the viewport matches the new window dimensions; note that width and
     // height will be significantly larger than specified on retina displays.
     glViewport(0, 0, width, height);
+    framebufferWidth = width;
+    framebufferHeight = height;
+    requestRedraw(rg::RedrawTracker::Window);
 }
 
 // glfw: whenever the mouse moves, this callback is called
@@ -519,12 +1588,32 @@ void mouse_callback(GLFWwindow *window, double xpos, double ypos) {
 
     if (programState->CameraMouseMovementUpdateEnabled)
         programState->camera.ProcessMouseMovement(xoffset, yoffset);
+    if (programState->CameraMouseMovementUpdateEnabled || programState->ImGuiEnabled)
+        requestRedraw(rg::RedrawTracker::Input);
 }
 
 // glfw: whenever the mouse scroll wheel scrolls, this callback is called
 // ----------------------------------------------------------------------
 void scroll_callback(GLFWwindow *window, double xoffset, double yoffset) {
     programState->camera.ProcessMouseScroll(yoffset);
+    requestRedraw(rg::RedrawTracker::Input);
+}
+
+// glfw: mouse buttons only matter to ImGui, which chains this callback
+// --------------------------------------------------------------------
+void mouse_button_callback(GLFWwindow *window, int button, int action, int mods) {
+    requestRedraw(rg::RedrawTracker::Input);
+}
+
+// glfw: the window needs its contents again, e.g. after it was covered
+// --------------------------------------------------------------------
+void window_refresh_callback(GLFWwindow *window) {
+    requestRedraw(rg::RedrawTracker::Window);
+}
+
+void requestRedraw(rg::RedrawTracker::Reason reason) {
+    if (programState != NULL && programState->redrawTracker != NULL)
+        programState->redrawTracker->invalidate(reason);
 }
 
 void DrawImGui(ProgramState *programState) {
@@ -558,12 +1647,237 @@ void DrawImGui(ProgramState *programState) {
         ImGui::End();
     }
 
+    {
+        ImGui::Begin("Renderer");
+        if (programState->MultiDrawIndirectSupported)
+            ImGui::Checkbox("Multi-draw indirect (F2)", &programState->MultiDrawIndirectEnabled);
+        else
+            ImGui::TextDisabled("Multi-draw indirect needs a GL 4.3 context");
+        const char *prePassModes[DepthPrePassModeCount] = {"Off", "On", "Auto"};
+        ImGui::Text("Depth pre-pass (F4):");
+        for (int i = 0; i < DepthPrePassModeCount; i++) {
+            ImGui::SameLine();
+            ImGui::RadioButton(prePassModes[i], &programState->depthPrePassMode, i);
+        }
+        if (programState->depthPrePassMode == DepthPrePassAuto)
+            ImGui::Text("Auto currently %s the pre-pass", programState->depthPrePassActive ? "uses" : "skips");
+        ImGui::Checkbox("Front-to-back ordering", &programState->frontToBackOrdering);
+        // the pre-pass pays off when the drop in shaded fragments saves more than the extra geometry pass costs
+        const char *paths[2] = {"Per-mesh draws", "Multi-draw indirect"};
+        for (int path = 0; path < 2; path++) {
+            for (int prePass = 0; prePass < 2; prePass++) {
+                const OpaquePassStats &stats = programState->opaquePassStats[path][prePass];
+                ImGui::Text("%s, %s pre-pass: CPU %.3f ms, GPU %.3f ms, %llu shaded", paths[path],
+                            prePass ? "with" : "no", stats.cpuMs, stats.gpuMs, stats.shadedFragments);
+            }
+        }
+
+        const rg::StreamBuffer::Stats &stream = programState->streamBuffer->stats();
+        unsigned long long imguiStalls = 0;
+        double imguiStallMs = 0.0;
+        ImGui_ImplOpenGL3_GetStreamStats(&imguiStalls, &imguiStallMs);
+        ImGui::Text("Stream buffers: %s", programState->streamBuffer->persistent() ? "persistent mapping" : "orphaning (GL 3.3)");
+        ImGui::Text("Renderer fence stalls: %llu (%.3f ms total)", stream.stalls, stream.stallMs);
+        ImGui::Text("ImGui fence stalls: %llu (%.3f ms total)", imguiStalls, imguiStallMs);
+
+        ImGui::Separator();
+        ImGui::Text("Transparency (F3)");
+        for (int i = 0; i < rg::TransparencyModeCount; i++) {
+            ImGui::RadioButton(rg::transparencyModeName(i), &programState->transparencyMode, i);
+            ImGui::SameLine();
+            ImGui::Text("GPU %.3f ms", programState->translucentGpuMs[i]);
+        }
+        ImGui::SliderInt("Translucent volumes", &programState->translucentVolumeCount, 0, 256);
+
+        // per effect resolution, the layer stats keep the last values of every resolution for comparison
+        const int divisors[3] = {1, 2, 4};
+        const char *divisorNames[3] = {"full", "half", "quarter"};
+        ImGui::Text("Cosmic dust resolution:");
+        for (int i = 0; i < 3; i++) {
+            ImGui::SameLine();
+            ImGui::PushID(i);
+            ImGui::RadioButton(divisorNames[i], &programState->dustResolutionDivisor, divisors[i]);
+            ImGui::PopID();
+        }
+        ImGui::Text("Volume resolution:     ");
+        for (int i = 0; i < 3; i++) {
+            ImGui::SameLine();
+            ImGui::PushID(3 + i);
+            ImGui::RadioButton(divisorNames[i], &programState->volumeResolutionDivisor, divisors[i]);
+            ImGui::PopID();
+        }
+        for (int i = 0; i < rg::TranslucentPass::LayerCount; i++) {
+            rg::TranslucentPass::LayerStats layer = programState->translucentPass->layerStats(i);
+            ImGui::Text("Layer 1/%d: GPU %.3f ms, %llu fragments", layer.divisor, layer.gpuMs,
+                        (unsigned long long) layer.fragments);
+        }
+        ImGui::Text("Frame: %.2f ms", 1000.0f / ImGui::GetIO().Framerate);
+
+        ImGui::Separator();
+        ImGui::SliderInt("Clustered lights", &programState->clusteredLightCount, 0, 4096);
+        const rg::ClusteredLights::Stats &clusters = programState->clusteredLights->stats();
+        ImGui::Text("Visible lights: %u, list entries: %u, max per cluster: %u%s", clusters.visibleLights,
+                    clusters.indices, clusters.maxLightsPerCluster, clusters.truncated ? " (truncated)" : "");
+        ImGui::Text("Cluster build: %.3f ms on %u threads", clusters.buildMs, programState->jobThreads);
+
+        ImGui::Separator();
+        ImGui::Text("Shadows (F5)");
+        for (int i = 0; i < rg::ShadowModeCount; i++) {
+            ImGui::SameLine();
+            ImGui::RadioButton(rg::shadowModeName(i), &programState->shadowMode, i);
+        }
+        // the shading side of the analytic mode shows up in the opaque pass times above
+        const rg::PointShadows::Stats &shadows = programState->pointShadows->stats();
+        ImGui::Text("Shadow update: CPU %.3f ms, GPU %.3f ms, %u faces drawn", shadows.cpuMs, shadows.gpuMs,
+                    shadows.facesUpdated);
+        ImGui::Text("Static layer rebuilds: %llu", shadows.staticRebuilds);
+        ImGui::SliderFloat("Light radius", &programState->eclipseLightRadius, 0.1f, 8.0f);
+        ImGui::Text("Eclipse occluders: earth %d, moon %d", programState->eclipseOccluderCount[0],
+                    programState->eclipseOccluderCount[1]);
+
+        ImGui::Separator();
+        ImGui::SliderFloat("Exposure", &programState->exposure, 0.1f, 4.0f);
+        ImGui::SliderFloat("Sun emissive", &programState->emissiveStrength, 1.0f, 16.0f);
+        ImGui::Checkbox("Bloom", &programState->bloomEnabled);
+        ImGui::SliderFloat("Bloom threshold", &programState->bloomThreshold, 0.5f, 4.0f);
+        ImGui::SliderFloat("Bloom strength", &programState->bloomStrength, 0.0f, 1.0f);
+        // the chain starts at a fixed height, so these stay the same when the window grows
+        double bloomMs = 0.0;
+        for (int i = 0; i < rg::Bloom::PassCount; i++) {
+            rg::Bloom::PassStats pass = programState->bloom->passStats(i);
+            ImGui::Text("Bloom %s %dx%d: GPU %.3f ms", pass.name.c_str(), pass.width, pass.height, pass.gpuMs);
+            bloomMs += pass.gpuMs;
+        }
+        ImGui::Text("Bloom total: GPU %.3f ms, tonemap: GPU %.3f ms", bloomMs, programState->tonemapGpuMs);
+
+        ImGui::Separator();
+        rg::ResolutionGovernor &governor = *programState->governor;
+        ImGui::Checkbox("Dynamic resolution", &governor.settings.enabled);
+        ImGui::SliderFloat("GPU frame target (ms)", &governor.settings.targetMs, 2.0f, 33.0f);
+        ImGui::SliderFloat("Minimum scale", &governor.settings.minScale, 0.25f, 1.0f);
+        ImGui::Text("Scene %dx%d (scale %.2f), effect quality %d/%d, LOD bias %d", programState->sceneWidth,
+                    programState->sceneHeight, governor.scale(), governor.quality(),
+                    rg::ResolutionGovernor::QualityLevels - 1, governor.lodBias());
+        auto gpuMs = [](void *data, int i) { return ((rg::ResolutionGovernor *) data)->history(i).gpuMs; };
+        auto scale = [](void *data, int i) { return ((rg::ResolutionGovernor *) data)->history(i).scale; };
+        ImGui::PlotLines("GPU ms", gpuMs, &governor, governor.historySize(), 0, NULL, 0.0f,
+                         2.0f * governor.settings.targetMs, ImVec2(0, 60));
+        ImGui::PlotLines("Scale", scale, &governor, governor.historySize(), 0, NULL, 0.0f, 1.0f, ImVec2(0, 60));
+
+        ImGui::Separator();
+        const rg::GpuProfiler &profiler = *programState->gpuProfiler;
+        if (!profiler.available()) {
+            ImGui::Text("GPU profiler: no GL_TIMESTAMP support");
+        } else if (ImGui::TreeNode("GPU profiler")) {
+            ImGui::Text("%llu frames profiled, %llu dropped (results not ready)", profiler.profiledFrames(),
+                        profiler.droppedFrames());
+            // one rolling chart per pass, nested scopes indented under the one they ran in
+            for (const rg::GpuProfiler::PassHistory &pass : profiler.passes()) {
+                char average[32];
+                std::snprintf(average, sizeof(average), "avg %.3f ms", profiler.averageMs(pass));
+                std::string label = std::string(2 * pass.depth, ' ') + pass.name;
+                ImGui::PlotLines(label.c_str(), pass.ms.data(), rg::GpuProfiler::HistorySize,
+                                 (profiler.latestSlot() + 1) % rg::GpuProfiler::HistorySize, average, 0.0f, FLT_MAX,
+                                 ImVec2(0, 30));
+            }
+            if (ImGui::Button("Export CSV")) {
+                std::ofstream csv("gpu_profile.csv");
+                profiler.writeCsv(csv);
+            }
+            ImGui::SameLine();
+            ImGui::Text("writes gpu_profile.csv");
+            ImGui::TreePop();
+        }
+
+        rg::FlightRecorder &recorder = *programState->flightRecorder;
+        ImGui::Text("Scene draws: %u calls, %llu triangles", programState->sceneDraws.drawCalls,
+                    programState->sceneDraws.triangles);
+        ImGui::Checkbox("Flight recorder", &recorder.settings.enabled);
+        ImGui::SliderFloat("Hitch budget (ms)", &recorder.settings.budgetMs, 5.0f, 200.0f);
+        ImGui::Text("Hitches: %llu%s%s", recorder.hitches(), recorder.lastDump().empty() ? "" : ", last ",
+                    recorder.lastDump().c_str());
+        ImGui::Text("CPU profiler: %.1f ns per zone%s", programState->cpuZoneOverheadNs,
+                    RG_CPU_PROFILER ? "" : " (compiled out)");
+        rg::GLDebug::Stats glMessages = rg::GLDebug::stats();
+        if (rg::GLDebug::active())
+            ImGui::Text("GL debug output (%s): %llu messages, %llu errors, %llu suppressed",
+                        rg::GLDebug::synchronous() ? "synchronous" : "asynchronous", glMessages.messages,
+                        glMessages.errors, glMessages.suppressed);
+        else
+            ImGui::Text("GL debug output: not supported, GLCALL polls glGetError");
+        if (ImGui::Button("Write CPU trace"))
+            rg::CpuProfiler::writeChromeTrace("cpu_trace.json");
+        ImGui::SameLine();
+        ImGui::Text("cpu_trace.json, open in chrome://tracing or Perfetto");
+
+        if (programState->frameCapture != NULL) {
+            ImGui::Separator();
+            rg::FrameCapture &capture = *programState->frameCapture;
+            if (ImGui::Button("Screenshot"))
+                capture.screenshot();
+            ImGui::SameLine();
+            if (ImGui::Button(capture.recording() ? "Stop recording" : "Start recording"))
+                capture.recording() ? capture.stop() : (void) capture.start();
+            ImGui::SameLine();
+            ImGui::Text("F9, F10; %s", capture.settings.pipeCommand.empty() ? capture.settings.directory.c_str()
+                                                                            : capture.settings.pipeCommand.c_str());
+            rg::FrameCapture::Stats captureStats = capture.stats();
+            ImGui::Text("Capture: %llu frames, %llu written, %llu dropped, %llu failed, %u queued, %llu readback stalls",
+                        captureStats.captured, captureStats.written, captureStats.dropped, captureStats.failed,
+                        captureStats.queued, captureStats.stalls);
+        }
+
+        ImGui::Separator();
+        rg::RedrawTracker &redraw = *programState->redrawTracker;
+        if (ImGui::Checkbox("On-demand rendering", &redraw.settings.enabled))
+            redraw.reset();
+        ImGui::SameLine();
+        ImGui::Checkbox("Pause animation (F6)", &programState->animationPaused);
+        rg::RedrawTracker::Stats redrawStats = redraw.stats();
+        double seconds = std::max(redrawStats.wallSeconds, 1e-6);
+        ImGui::Text("%llu frames rendered, %llu presented at %.0f Hz, %llu idle wakeups", redrawStats.rendered,
+                    redrawStats.presented, redraw.settings.refreshRate, redrawStats.idleWakeups);
+        ImGui::Text("CPU %.1f%% of a core, GPU %.1f ms per second", 100.0 * redrawStats.cpuSeconds / seconds,
+                    redrawStats.gpuMs / seconds);
+        std::string reasons = "Rendered for:";
+        for (int i = 0; i < rg::RedrawTracker::ReasonCount; i++)
+            reasons += std::string(" ") + rg::RedrawTracker::reasonName(i) + " " + std::to_string(redrawStats.reasons[i]);
+        ImGui::Text("%s", reasons.c_str());
+
+        ImGui::Separator();
+        const rg::FrameGraph::Stats &graph = programState->frameGraph->stats();
+        ImGui::Text("Frame graph: %u passes, %u culled", graph.passes, graph.culledPasses);
+        ImGui::Text("Transient textures: %u in %u (%.1f MB aliased from %.1f MB)", graph.transientTextures,
+                    graph.physicalTextures, graph.aliasedBytes / (1024.0 * 1024.0), graph.transientBytes / (1024.0 * 1024.0));
+        if (ImGui::TreeNode("Passes")) {
+            for (unsigned int i = 0; i < programState->frameGraph->passCount(); i++) {
+                ImGui::Text("%s%s", programState->frameGraph->passName(i).c_str(),
+                            programState->frameGraph->passCulled(i) ? " (culled)" : "");
+            }
+            ImGui::TreePop();
+        }
+        ImGui::End();
+    }
+
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
 
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
-    if (key == GLFW_KEY_F1 && action == GLFW_PRESS) {
+    if (programState->replayingInput)
+        return;
+    if (programState->inputRecorder != NULL)
+        programState->inputRecorder->addKey(key, action, mods);
+    requestRedraw(rg::RedrawTracker::Input);
+    handleKey(window, key, action);
+}
+
+// the key bindings, for live and replayed key events
+void handleKey(GLFWwindow *window, int key, int action) {
+    // the ImGui window shows live timings, so a replay never opens it; the modes it changes aren't in
+    // the input log, so a recording doesn't open it either
+    if (key == GLFW_KEY_F1 && action == GLFW_PRESS && !programState->replayingInput
+        && programState->inputRecorder == NULL) {
         programState->ImGuiEnabled = !programState->ImGuiEnabled;
         if (programState->ImGuiEnabled) {
             programState->CameraMouseMovementUpdateEnabled = false;
@@ -572,10 +1886,154 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
             glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
         }
     }
+    if (key == GLFW_KEY_F2 && action == GLFW_PRESS && programState->MultiDrawIndirectSupported)
+        programState->MultiDrawIndirectEnabled = !programState->MultiDrawIndirectEnabled;
+    if (key == GLFW_KEY_F3 && action == GLFW_PRESS)
+        programState->transparencyMode = (programState->transparencyMode + 1) % rg::TransparencyModeCount;
+    if (key == GLFW_KEY_F4 && action == GLFW_PRESS)
+        programState->depthPrePassMode = (programState->depthPrePassMode + 1) % DepthPrePassModeCount;
+    if (key == GLFW_KEY_F5 && action == GLFW_PRESS)
+        programState->shadowMode = (programState->shadowMode + 1) % rg::ShadowModeCount;
+    if (key == GLFW_KEY_F6 && action == GLFW_PRESS)
+        programState->animationPaused = !programState->animationPaused;
+    // a replay doesn't capture by itself, --capture records it from the start
+    rg::FrameCapture *capture = programState->frameCapture;
+    if (key == GLFW_KEY_F9 && action == GLFW_PRESS && capture != NULL && !programState->replayingInput)
+        capture->screenshot();
+    if (key == GLFW_KEY_F10 && action == GLFW_PRESS && capture != NULL && !programState->replayingInput) {
+        if (capture->recording())
+            capture->stop();
+        else
+            capture->start();
+    }
+}
+
+void SetLightUniforms(Shader &shader, const PointLight &pointLight, const glm::vec3 &viewPosition) {
+    shader.setVec3("pointLight.position", pointLight.position);
+    shader.setVec3("pointLight.ambient", pointLight.ambient);
+    shader.setVec3("pointLight.diffuse", pointLight.diffuse);
+    shader.setVec3("pointLight.specular", pointLight.specular);
+    shader.setFloat("pointLight.constant", pointLight.constant);
+    shader.setFloat("pointLight.linear", pointLight.linear);
+    shader.setFloat("pointLight.quadratic", pointLight.quadratic);
+    shader.setVec3("viewPosition", viewPosition);
+    shader.setFloat("material.shininess", 32.0f);
+
+    for (int i = 0; i < 4; i++) {
+        std::string name = "dirLight" + std::to_string(i + 1);
+        shader.setVec3(name + ".direction", FillLights[i].direction);
+        shader.setVec3(name + ".ambient", FillLights[i].ambient);
+        shader.setVec3(name + ".diffuse", FillLights[i].diffuse);
+        shader.setVec3(name + ".specular", FillLights[i].specular);
+    }
+}
+
+void PlaceBaseObjects(float time, glm::mat4 &earth, glm::mat4 &moon, glm::mat4 &sun) {
+    earth = glm::mat4(1.0f);
+    earth = glm::translate(earth, glm::vec3(0.5f, 15.5f, 3.0f));
+    earth = glm::rotate(earth, glm::radians(180.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+    earth = glm::rotate(earth, -time / 2, glm::vec3(0.0f, 1.0f, 0.0f));
+
+    moon = glm::translate(glm::mat4(1.0f), glm::vec3(-2.0f * cos(time / 8) * 4, 14.5f, -2.0f * sin(time / 8) * 4));
+
+    sun = glm::mat4(1.0f);
+    sun = glm::translate(sun, glm::vec3(-28.0f, 11.5f, 75.0f));
+    sun = glm::scale(sun, glm::vec3(5.0f));
+    sun = glm::rotate(sun, time / 8, glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+int RenderSoftware(const std::string &output, const rg::Benchmark::Settings &settings,
+                   const rg::SceneGenerator::Settings &sceneSettings, const std::string &cameraPath) {
+    // the same vertical flip as the GL path, so the textures line up with their coordinates the same way
+    stbi_set_flip_vertically_on_load(true);
+    Model sunModel("resources/objects/sun/Earth_2K.obj", false, false);
+    Model moonModel("resources/objects/moon/moon.obj", false, false);
+    Model earthModel("resources/objects/Earth/Earth_2K.obj", false, false);
+    rg::SceneGenerator sceneGenerator(sceneSettings, glm::vec3(-28.0f, 11.5f, 75.0f));
+    float earthRadius = rg::boundingSphere(earthModel).radius, moonRadius = rg::boundingSphere(moonModel).radius;
+
+    rg::JobSystem jobSystem;
+    rg::SoftwareRenderer renderer(jobSystem);
+    renderer.resize(settings.width, settings.height);
+    renderer.loadSkybox(SkyboxFaces());
+    rg::SoftwareRenderer::Lights lights;
+    lights.point = {SunLight.position, SunLight.ambient, SunLight.diffuse, SunLight.specular, SunLight.constant,
+                    SunLight.linear, SunLight.quadratic};
+    for (const DirLight &light : FillLights)
+        lights.directional.push_back({light.direction, light.ambient, light.diffuse, light.specular});
+    ProgramState defaults;
+    Camera camera;
+    rg::Benchmark benchmark(settings);
+    if (!cameraPath.empty() && !benchmark.loadPath(cameraPath))
+        return -1;
+    std::cout << "Software renderer: " << settings.warmupFrames << " + " << settings.frames << " frames at "
+              << renderer.width() << "x" << renderer.height() << ", " << jobSystem.threadCount() << " threads, "
+              << (renderer.avx2() ? "AVX2" : "scalar") << " rasterizer\n";
+
+    double measuredMs = 0.0, geometryMs = 0.0, tileMs = 0.0;
+    unsigned long long triangles = 0, pixels = 0;
+    while (!benchmark.finished()) {
+        auto frameStart = std::chrono::steady_clock::now();
+        float time = (float) benchmark.time();
+        benchmark.placeCamera(camera);
+        sceneGenerator.update(time);
+        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom),
+                                                (float) renderer.width() / (float) renderer.height(), 0.1f, 150.0f);
+        renderer.beginFrame(camera.GetViewMatrix(), projection, camera.Position, lights);
+        glm::mat4 earth, moon, sun;
+        PlaceBaseObjects(time, earth, moon, sun);
+        renderer.draw(earthModel, earth, true);
+        renderer.draw(moonModel, moon, true);
+        renderer.draw(sunModel, sun, false, defaults.emissiveStrength);
+        for (unsigned int i = 0; i < sceneGenerator.bodies().size(); i++) {
+            bool planet = sceneGenerator.bodies()[i].kind == rg::SceneGenerator::Planet;
+            renderer.draw(planet ? earthModel : moonModel,
+                          sceneGenerator.bodyTransform(i, planet ? earthRadius : moonRadius), true);
+        }
+        renderer.endFrame(defaults.exposure);
+
+        double frameMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+        const rg::SoftwareRenderer::Stats &stats = renderer.stats();
+        if (benchmark.measuring()) {
+            measuredMs += frameMs;
+            geometryMs += stats.geometryMs;
+            tileMs += stats.tileMs;
+            triangles += stats.triangles;
+            pixels += (unsigned long long) renderer.width() * renderer.height();
+        }
+        benchmark.endFrame(frameMs, frameMs, 0.0, false, stats.drawCalls, stats.triangles);
+    }
+
+    int frames = std::max(settings.frames, 1);
+    std::cout << "Software renderer: " << measuredMs / frames << " ms per frame (geometry " << geometryMs / frames
+              << " ms, tiles " << tileMs / frames << " ms), " << triangles / (measuredMs * 1e3) << " Mtris/s, "
+              << pixels / (measuredMs * 1e3) << " Mpix/s\n";
+    std::string depthOutput = output.substr(0, output.rfind('.')) + ".depth.png";
+    if (!renderer.writeColorPng(output) || !renderer.writeDepthPng(depthOutput)) {
+        std::cout << "Failed to write " << output << '\n';
+        return 1;
+    }
+    std::cout << "Last frame in " << output << ", its depth in " << depthOutput << '\n';
+    return 0;
+}
+
+vector<std::string> SkyboxFaces()
+{
+    // in the order of GL_TEXTURE_CUBE_MAP_POSITIVE_X + i
+    return {
+            FileSystem::getPath("resources/textures/skybox/SkyBlue2_right1.png"),
+            FileSystem::getPath("resources/textures/skybox/SkyBlue2_left2.png"),
+            FileSystem::getPath("resources/textures/skybox/SkyBlue2_bottom4.png"),
+            FileSystem::getPath("resources/textures/skybox/SkyBlue2_top3.png"),
+            FileSystem::getPath("resources/textures/skybox/SkyBlue2_front5.png"),
+            FileSystem::getPath("resources/textures/skybox/SkyBlue2_back6.png")
+    };
 }
 
 unsigned int loadSkybox(vector<std::string> faces)
 {
+    CPU_ZONE("loadSkybox");
+    rg::AssetLoadScope asset("skybox", faces[0]);
     unsigned int textureID;
     glGenTextures(1, &textureID);
     glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);